@@ -25,9 +25,9 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
-#include <future> 
 #include <chrono>
 #include <thread>
+#include "thread_pool.hpp"
 
 
 /**********************************************
@@ -192,76 +192,32 @@ READ_FILE_END:
 /***********************************************************
 * Զawaiter
 *
+* ʹ std::async(std::launch::async, ...)Ϊÿζļᴴһ̣߳
+* Ͷݵ̶Сִ̳߳У֮Э̻صԭִϻָ
 *
 ************************************************************/
-struct await_read_file
+auto await_read_file(thread_pool& pool, const char* filename, char* buffer, size_t buf_len, size_t* read_len)
 {
-    await_read_file(const char* filename, char* buffer, size_t buf_len, size_t* read_len)
-    {
-        filename_ = filename;
-        buffer_ = buffer;
-        buf_len_ = buf_len;
-        read_len_ = read_len;
-    };
-
-    ~await_read_file() = default;
-
-    //Ƿ׼ãreturn false͵await_suspend
-    bool await_ready()
-    {
-        return false;
-    }
-
-    //Ĳ첽ļȻȴ
-    //awaitingЭ̾
-    void await_suspend(std::coroutine_handle<> awaiting)
-    {
-        fur_ = std::async(std::launch::async,
-            &read_file,
-            filename_,
-            buffer_,
-            buf_len_,
-            read_len_,
-            awaiting);
-
-        //result_ = fur_.get();   //ȴ
-        //awaiting.resume();      //ʵû첽ͬ
-    }
-
-    //Эָ̹ʱõĽӿ
-    //ͬʱ䷵ؽΪco_awaitķֵ
-    int await_resume()
-    {
-        result_ = fur_.get();   //Эָ̻֮get
-        return result_;
-    }
-
-    //ļĲֵ
-    int result_ = -1;
-    const char* filename_ = nullptr;
-    char* buffer_ = nullptr;
-    size_t buf_len_ = 0;
-    size_t* read_len_ = nullptr;
-    std::future<int> fur_;
-
-    //Э̵ľ
-    std::coroutine_handle<> awaiting_;
-};
+    return offload(pool, [=] {
+        return read_file(filename, buffer, buf_len, read_len, nullptr);
+    });
+}
 
 
 /******************************************************
 * Э̺
 * 
+* pool:ִļ̳߳
 * filename:Ҫȡļ
 * buffer:Ŀbuffer
 * buf_len:Ŀbuffer
 * read_len:ʵʶȡĳ
 * 
 *******************************************************/
-coro_ret<int> coroutine_await(const char* filename, char* buffer, size_t buf_len, size_t* read_len)
+coro_ret<int> coroutine_await(thread_pool& pool, const char* filename, char* buffer, size_t buf_len, size_t* read_len)
 {
     //co_awaitԶawaiter
-    int ret = co_await await_read_file(filename, buffer, buf_len, read_len);
+    int ret = co_await await_read_file(pool, filename, buffer, buf_len, read_len);
 
     std::cout << "await_read_file ret= " << ret << std::endl;
 
@@ -275,19 +231,27 @@ coro_ret<int> coroutine_await(const char* filename, char* buffer, size_t buf_len
 
 int main(int argc, char* argv[])
 {
-    using namespace std::chrono_literals;
+    //2̣߳Ŷ64
+    thread_pool pool(2, 64);
+
+    //߳ΪЭִָ̻
+    resume_queue main_queue;
 
     //Э
     char buffer[1024];
     size_t read_len = 0;
     std::cout << "Start coroutine_await coroutine\n";
 
-    auto c_r = coroutine_await("D:/test/aio_test_001.txt", buffer, 1024, &read_len);
+    auto c_r = coroutine_await(pool, "D:/test/aio_test_001.txt", buffer, 1024, &read_len);
 
-    std::this_thread::sleep_for(std::chrono::seconds(2));   //ʱµȴЭеĶļ
+    //ȴļɣЭ߳ϻָһֱִеfinal_suspend
+    while (!c_r.coro_handle_.done())
+        main_queue.run_one();
 
-    //ָЭ
-    c_r.move_next();
+    auto stats = pool.get_stats();
+    std::cout << "thread_pool submitted=" << stats.submitted
+        << " rejected=" << stats.rejected
+        << " completed=" << stats.completed << std::endl;
 
     std::cout << "End coroutine_await coroutine\n";
 
@@ -0,0 +1,140 @@
+/****************************************************************************
+*
+* C++20 Э3
+*
+* generator<T> range-for  std::ranges ͼ co_yield ֵ
+*
+* Ա coroutine_demo1.cpp  coro_retֶ move_next()/get()
+*
+*****************************************************************************/
+
+#include <array>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <ranges>
+#include <string>
+#include "generator.hpp"
+
+
+/******************************************************
+* 쳲У
+*
+*******************************************************/
+generator<long long> fibonacci()
+{
+    long long a = 0, b = 1;
+    for (;;)
+    {
+        co_yield a;      //ֵ´һݷ awaiter 
+        a = std::exchange(b, a + b);
+    }
+}
+
+
+/******************************************************
+* ݹ co_yield elements_of
+*
+* ÿԪضֱӻָЭ̣޹
+*
+*******************************************************/
+struct tree_node
+{
+    int value;
+    tree_node* left = nullptr;
+    tree_node* right = nullptr;
+};
+
+generator<int> inorder(const tree_node* node)
+{
+    if (node == nullptr)
+        co_return;
+    co_yield elements_of(inorder(node->left));
+    co_yield node->value;
+    co_yield elements_of(inorder(node->right));
+}
+
+
+/******************************************************
+* ״̬ķЭ֡һ̶ĻϷ
+* arena_allocator<T>ͬһarenaͣrebindָ֮Ļͬһ黺
+*
+*******************************************************/
+struct arena
+{
+    alignas(std::max_align_t) std::byte buffer_[4096];
+    std::size_t used_ = 0;
+};
+
+template <class T>
+struct arena_allocator
+{
+    using value_type = T;
+
+    arena* arena_;
+
+    explicit arena_allocator(arena& a) noexcept : arena_(&a) {}
+
+    template <class U>
+    arena_allocator(const arena_allocator<U>& other) noexcept : arena_(other.arena_) {}
+
+    T* allocate(std::size_t n)
+    {
+        std::size_t bytes = n * sizeof(T);
+        std::size_t offset = (arena_->used_ + alignof(T) - 1) & ~(alignof(T) - 1);
+        if (offset + bytes > sizeof(arena_->buffer_))
+            throw std::bad_alloc{};
+        arena_->used_ = offset + bytes;
+        return reinterpret_cast<T*>(arena_->buffer_ + offset);
+    }
+
+    void deallocate(T*, std::size_t) noexcept {}   //黺һͷ
+
+    friend bool operator==(const arena_allocator& a, const arena_allocator& b) noexcept
+    {
+        return a.arena_ == b.arena_;
+    }
+};
+
+using arena_alloc = arena_allocator<std::byte>;
+
+generator<std::string, arena_alloc> words(std::allocator_arg_t, const arena_alloc&, int n)
+{
+    for (int i = 0; i < n; ++i)
+        co_yield "word" + std::to_string(i);    //ֵֻ¼ַ
+}
+
+int main(int argc, char* argv[])
+{
+    //range-for + ͼ
+    std::cout << "fibonacci:";
+    for (long long v : fibonacci() | std::views::take(10))
+        std::cout << ' ' << v;
+    std::cout << std::endl;
+
+    //ݹ
+    std::array<tree_node, 7> nodes{ { {4}, {2}, {6}, {1}, {3}, {5}, {7} } };
+    nodes[0].left = &nodes[1];
+    nodes[0].right = &nodes[2];
+    nodes[1].left = &nodes[3];
+    nodes[1].right = &nodes[4];
+    nodes[2].left = &nodes[5];
+    nodes[2].right = &nodes[6];
+
+    std::cout << "inorder:";
+    for (int v : inorder(&nodes[0]) | std::views::filter([](int v) { return v % 2 == 1; }))
+        std::cout << ' ' << v;
+    std::cout << std::endl;
+
+    //Զõõ std::string&&ֱ move 
+    arena buffer;
+    std::cout << "words:";
+    for (std::string&& w : words(std::allocator_arg, arena_alloc{ buffer }, 3))
+    {
+        std::string s = std::move(w);
+        std::cout << ' ' << s;
+    }
+    std::cout << " (arena used " << buffer.used_ << " bytes)" << std::endl;
+
+    return 0;
+}
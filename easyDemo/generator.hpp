@@ -0,0 +1,388 @@
+/****************************************************************************
+*
+* generator<T>range-forstd::rangesͼ
+*
+*  coroutine_demo1.cpp  coro_ret ȣ
+* 1ֶ move_next()generator һ input_range + view
+* 2co_yield ֵ promisepromise ֻ汻 yield ĵַ
+*       yield ĶЭ̹ڼһֱЭ֡ֱõã
+* 3co_yield elements_of(generator) ݹزgeneratorԪأ
+*      ĵֱӻָЭ̣һһ resumeÿԪصĿǶ޹أ
+* 4ڶģǷЭ֡䣺
+*      generator<int, Alloc> f(std::allocator_arg_t, const Alloc& alloc, ...)
+*
+*****************************************************************************/
+
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+
+
+template <class T, class Alloc = std::allocator<std::byte>>
+class generator;
+
+
+/**********************************************
+* co_yield elements_of(r) r Ԫ
+*
+***********************************************/
+template <class R>
+struct elements_of
+{
+    R range;
+};
+
+template <class R>
+elements_of(R&&) -> elements_of<R&&>;
+
+
+namespace detail {
+
+/**********************************************
+*  generator  promise ͬĲֻ֣йأͷ޹أ
+* Բͬ generator ֮Ҳܵݹ yield
+*
+* root_ promise yield ֵĵַͳһ¼ root_ 
+* leaf_ֻ root_ 壬ǰִеЭ
+* parent_һ promiseЭ֮̽ص
+*
+***********************************************/
+template <class Ref>
+struct generator_promise_base
+{
+    using value_type = std::remove_cvref_t<Ref>;
+
+    std::add_pointer_t<Ref> value_ = nullptr;
+    generator_promise_base* root_ = this;
+    generator_promise_base* parent_ = nullptr;
+    std::coroutine_handle<> self_;
+    std::coroutine_handle<> leaf_;
+    std::exception_ptr exception_;
+
+    std::suspend_always initial_suspend() noexcept
+    {
+        return {};
+    }
+
+    //ʱصһЭ̣Э̽ʱص
+    struct final_awaiter
+    {
+        bool await_ready() noexcept
+        {
+            return false;
+        }
+
+        template <class Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+        {
+            auto& promise = h.promise();
+            if (promise.parent_)
+            {
+                promise.root_->leaf_ = promise.parent_->self_;
+                return promise.parent_->self_;
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    final_awaiter final_suspend() noexcept
+    {
+        return {};
+    }
+
+    //co_yield ֵ Ref ֵʱֵֻ¼ַ
+    std::suspend_always yield_value(Ref value) noexcept
+    {
+        root_->value_ = std::addressof(value);
+        return {};
+    }
+
+    //Ref ֵʱ co_yield ֵһݷ awaiter awaiter ڹڼһֱ
+    struct copy_awaiter
+    {
+        value_type copy_;
+        generator_promise_base* root_;
+
+        bool await_ready() noexcept
+        {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<>) noexcept
+        {
+            root_->value_ = std::addressof(copy_);
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    auto yield_value(const value_type& value)
+        requires std::is_rvalue_reference_v<Ref> && std::is_constructible_v<value_type, const value_type&>
+    {
+        return copy_awaiter{ value, root_ };
+    }
+
+    //co_yield elements_of(generator)Э̹ҵЭϣֱлȥ
+    template <class Gen>
+    struct nested_awaiter
+    {
+        Gen gen_;
+
+        bool await_ready() noexcept
+        {
+            return !gen_.coro_;
+        }
+
+        template <class Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+        {
+            auto& parent = h.promise();
+            auto& child = gen_.coro_.promise();
+            child.root_ = parent.root_;
+            child.parent_ = &parent;
+            parent.root_->leaf_ = gen_.coro_;
+            return gen_.coro_;
+        }
+
+        void await_resume()
+        {
+            if (gen_.coro_.promise().exception_)
+                std::rethrow_exception(gen_.coro_.promise().exception_);
+        }
+    };
+
+    template <class T2, class A2>
+        requires std::same_as<typename generator<T2, A2>::reference, Ref>
+    auto yield_value(elements_of<generator<T2, A2>&&> g) noexcept
+    {
+        return nested_awaiter<generator<T2, A2>>{ std::move(g.range) };
+    }
+
+    // rangeһ generator 
+    template <std::ranges::input_range R>
+        requires std::convertible_to<std::ranges::range_reference_t<R>, Ref>
+    auto yield_value(elements_of<R> r)
+    {
+        auto nested = [](std::ranges::iterator_t<R> it, std::ranges::sentinel_t<R> end) -> generator<Ref>
+        {
+            for (; it != end; ++it)
+                co_yield static_cast<Ref>(*it);
+        };
+        return nested_awaiter<generator<Ref>>{ nested(std::ranges::begin(r.range), std::ranges::end(r.range)) };
+    }
+
+    void await_transform() = delete;
+
+    void return_void() noexcept {}
+
+    //ֱӰ쳣׸ĵ÷ȴص elements_of ׳
+    void unhandled_exception()
+    {
+        if (parent_ == nullptr)
+            throw;
+        exception_ = std::current_exception();
+    }
+};
+
+
+/**********************************************
+* ѷЭ֡ĩβͷʱȡ
+*
+***********************************************/
+template <class Alloc>
+struct frame_allocator
+{
+    struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) block
+    {
+        std::byte data_[__STDCPP_DEFAULT_NEW_ALIGNMENT__];
+    };
+
+    using block_alloc = typename std::allocator_traits<Alloc>::template rebind_alloc<block>;
+    using traits = std::allocator_traits<block_alloc>;
+
+    //״̬ķҪõʱĬϹһ
+    static constexpr bool stateless = std::default_initializable<block_alloc> && traits::is_always_equal::value;
+
+    static std::size_t alloc_offset(std::size_t size)
+    {
+        return (size + alignof(block_alloc) - 1) & ~(alignof(block_alloc) - 1);
+    }
+
+    static std::size_t block_count(std::size_t size)
+    {
+        std::size_t total = stateless ? size : alloc_offset(size) + sizeof(block_alloc);
+        return (total + sizeof(block) - 1) / sizeof(block);
+    }
+
+    static void* allocate(const Alloc& alloc, std::size_t size)
+    {
+        block_alloc ba(alloc);
+        void* p = traits::allocate(ba, block_count(size));
+        if constexpr (!stateless)
+            ::new (static_cast<std::byte*>(p) + alloc_offset(size)) block_alloc(std::move(ba));
+        return p;
+    }
+
+    static void deallocate(void* p, std::size_t size) noexcept
+    {
+        if constexpr (stateless)
+        {
+            block_alloc ba;
+            traits::deallocate(ba, static_cast<block*>(p), block_count(size));
+        }
+        else
+        {
+            auto* stored = std::launder(reinterpret_cast<block_alloc*>(static_cast<std::byte*>(p) + alloc_offset(size)));
+            block_alloc ba(std::move(*stored));
+            stored->~block_alloc();
+            traits::deallocate(ba, static_cast<block*>(p), block_count(size));
+        }
+    }
+};
+
+} // namespace detail
+
+
+/**********************************************
+* generator<T, Alloc>
+*
+* T ʱõõ T&&ֱ move ߣ
+* T ʱõõ T 
+*
+***********************************************/
+template <class T, class Alloc>
+class generator : public std::ranges::view_base
+{
+public:
+    using reference = std::conditional_t<std::is_reference_v<T>, T, T&&>;
+    using value_type = std::remove_cvref_t<T>;
+
+    struct promise_type : detail::generator_promise_base<reference>
+    {
+        using frame = detail::frame_allocator<Alloc>;
+
+        generator get_return_object() noexcept
+        {
+            auto h = std::coroutine_handle<promise_type>::from_promise(*this);
+            this->self_ = h;
+            this->leaf_ = h;
+            return generator{ h };
+        }
+
+        static void* operator new(std::size_t size)
+            requires std::default_initializable<Alloc>
+        {
+            return frame::allocate(Alloc{}, size);
+        }
+
+        //ɺgenerator<T, Alloc> f(std::allocator_arg_t, const Alloc&, ...)
+        template <class... Args>
+        static void* operator new(std::size_t size, std::allocator_arg_t, const Alloc& alloc, const Args&...)
+        {
+            return frame::allocate(alloc, size);
+        }
+
+        //Աһ *this
+        template <class This, class... Args>
+        static void* operator new(std::size_t size, const This&, std::allocator_arg_t, const Alloc& alloc, const Args&...)
+        {
+            return frame::allocate(alloc, size);
+        }
+
+        static void operator delete(void* p, std::size_t size) noexcept
+        {
+            frame::deallocate(p, size);
+        }
+    };
+
+    class iterator
+    {
+    public:
+        using value_type = generator::value_type;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+
+        explicit iterator(std::coroutine_handle<promise_type> coro) noexcept
+            : coro_(coro)
+        {
+        }
+
+        //ֱӻָЭ
+        iterator& operator++()
+        {
+            coro_.promise().leaf_.resume();
+            return *this;
+        }
+
+        void operator++(int)
+        {
+            ++*this;
+        }
+
+        reference operator*() const noexcept
+        {
+            return static_cast<reference>(*coro_.promise().value_);
+        }
+
+        friend bool operator==(const iterator& it, std::default_sentinel_t) noexcept
+        {
+            return it.coro_.done();
+        }
+
+    private:
+        std::coroutine_handle<promise_type> coro_;
+    };
+
+    generator() noexcept = default;
+
+    generator(generator&& other) noexcept
+        : coro_(std::exchange(other.coro_, nullptr))
+    {
+    }
+
+    generator& operator=(generator other) noexcept
+    {
+        std::swap(coro_, other.coro_);
+        return *this;
+    }
+
+    ~generator()
+    {
+        if (coro_)
+            coro_.destroy();
+    }
+
+    //ֻܵһΣʼִЭֱһ co_yield
+    iterator begin()
+    {
+        coro_.resume();
+        return iterator{ coro_ };
+    }
+
+    std::default_sentinel_t end() const noexcept
+    {
+        return {};
+    }
+
+private:
+    template <class Ref>
+    friend struct detail::generator_promise_base;
+
+    explicit generator(std::coroutine_handle<promise_type> coro) noexcept
+        : coro_(coro)
+    {
+    }
+
+    std::coroutine_handle<promise_type> coro_ = nullptr;
+};
@@ -0,0 +1,189 @@
+/****************************************************************************
+*
+* generator<T> ܲ
+*
+* дĵѭԱȣ
+* 1˳ 0..N-1 ͣ
+* 2std::views ܵfilter + transform
+* 3ȫݹ elements_of vs дʽջ
+*
+*  -DCMAKE_BUILD_TYPE=Release 룬δŻʱû
+*
+*****************************************************************************/
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <ranges>
+#include <vector>
+#include "generator.hpp"
+
+
+//ֹѭŻ
+template <class T>
+void do_not_optimize(T const& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+template <class Fn>
+void bench(const char* name, std::size_t n, Fn&& fn)
+{
+    fn();   //Ԥ
+    auto start = std::chrono::steady_clock::now();
+    std::uint64_t result = fn();
+    auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    std::cout << name << ": " << ns / n << " ns/element (result " << result << ")" << std::endl;
+}
+
+
+/******************************************************
+* ˳
+*
+*******************************************************/
+generator<std::uint64_t> counting(std::uint64_t n)
+{
+    for (std::uint64_t i = 0; i < n; ++i)
+        co_yield std::uint64_t(i);
+}
+
+//дĵ
+struct counting_iterator
+{
+    using value_type = std::uint64_t;
+    using difference_type = std::ptrdiff_t;
+
+    std::uint64_t i_ = 0;
+
+    std::uint64_t operator*() const noexcept { return i_; }
+    counting_iterator& operator++() noexcept { ++i_; return *this; }
+    counting_iterator operator++(int) noexcept { auto t = *this; ++i_; return t; }
+    bool operator==(const counting_iterator&) const = default;
+};
+
+
+/******************************************************
+* ȫڵ㰴ţ
+*
+*******************************************************/
+struct tree
+{
+    struct node
+    {
+        std::uint64_t value;
+        int left;
+        int right;
+    };
+
+    std::vector<node> nodes_;
+
+    int build(std::uint64_t& next, int depth)
+    {
+        if (depth == 0)
+            return -1;
+        int index = static_cast<int>(nodes_.size());
+        nodes_.push_back({ 0, -1, -1 });
+        int left = build(next, depth - 1);
+        nodes_[index].value = next++;
+        int right = build(next, depth - 1);
+        nodes_[index].left = left;
+        nodes_[index].right = right;
+        return index;
+    }
+};
+
+generator<std::uint64_t> inorder(const tree& t, int index)
+{
+    if (index < 0)
+        co_return;
+    co_yield elements_of(inorder(t, t.nodes_[index].left));
+    co_yield std::uint64_t(t.nodes_[index].value);
+    co_yield elements_of(inorder(t, t.nodes_[index].right));
+}
+
+//дʽջ
+std::uint64_t inorder_by_hand(const tree& t, int root)
+{
+    std::uint64_t sum = 0;
+    std::vector<int> stack;
+    int cur = root;
+    while (cur >= 0 || !stack.empty())
+    {
+        while (cur >= 0)
+        {
+            stack.push_back(cur);
+            cur = t.nodes_[cur].left;
+        }
+        cur = stack.back();
+        stack.pop_back();
+        sum += t.nodes_[cur].value;
+        cur = t.nodes_[cur].right;
+    }
+    return sum;
+}
+
+int main(int argc, char* argv[])
+{
+#if !defined(__OPTIMIZE__)
+    std::cout << "warning: built without optimization" << std::endl;
+#endif
+    std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+
+    std::cout << "== sequential, n=" << n << std::endl;
+    bench("generator range-for", n, [n] {
+        std::uint64_t sum = 0;
+        for (std::uint64_t v : counting(n))
+            sum += v;
+        do_not_optimize(sum);
+        return sum;
+    });
+    bench("hand-written iterator", n, [n] {
+        std::uint64_t sum = 0;
+        for (counting_iterator it{ 0 }, end{ n }; it != end; ++it)
+            sum += *it;
+        do_not_optimize(sum);
+        return sum;
+    });
+
+    std::cout << "== views::filter | views::transform, n=" << n << std::endl;
+    auto odd = [](std::uint64_t v) { return v % 2 == 1; };
+    auto square = [](std::uint64_t v) { return v * v; };
+    bench("generator | views", n, [&] {
+        std::uint64_t sum = 0;
+        for (std::uint64_t v : counting(n) | std::views::filter(odd) | std::views::transform(square))
+            sum += v;
+        do_not_optimize(sum);
+        return sum;
+    });
+    bench("iota | views", n, [&] {
+        std::uint64_t sum = 0;
+        for (std::uint64_t v : std::views::iota(std::uint64_t(0), std::uint64_t(n)) | std::views::filter(odd) | std::views::transform(square))
+            sum += v;
+        do_not_optimize(sum);
+        return sum;
+    });
+
+    for (int depth : { 10, 20 })
+    {
+        tree t;
+        std::uint64_t next = 0;
+        int root = t.build(next, depth);
+        std::cout << "== inorder traversal, depth=" << depth << " nodes=" << next << std::endl;
+        bench("generator elements_of", next, [&] {
+            std::uint64_t sum = 0;
+            for (std::uint64_t v : inorder(t, root))
+                sum += v;
+            do_not_optimize(sum);
+            return sum;
+        });
+        bench("hand-written stack", next, [&] {
+            std::uint64_t sum = inorder_by_hand(t, root);
+            do_not_optimize(sum);
+            return sum;
+        });
+    }
+
+    return 0;
+}
@@ -0,0 +1,320 @@
+/****************************************************************************
+*
+* ̶С̳߳ + offload awaiter
+*
+* co_await offload(pool, fn)
+* 1fn Ͷݵ̳߳еĳִ߳У std::async ÿζ̣߳
+* 2fn ִ֮Эԭִexecutorϻָ̳߳߳ϻָ
+* 3̳߳صнģ֮Ͷݻᱻֱܾܾڵ÷ִ߳Уcaller-runs
+*      ͬʱܾᱻͳ
+*
+* ڵ㣨pool_jobʽģֱǶ awaiter awaiter λЭ֡УͶҪڴ档
+*
+*****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+/**********************************************
+* ִĳ߳ϻָЭ
+*
+* current() ¼ǰ߳ʹõִ
+* offload ڹʱȡɺЭִ̽
+*
+***********************************************/
+struct executor
+{
+    //Эִִָ̻̾߳
+    virtual void post(std::coroutine_handle<> h) = 0;
+
+    //ǰ̵ִ߳ΪգΪʱЭֱ̳߳߳ϻָ
+    static executor*& current()
+    {
+        thread_local executor* current_ = nullptr;
+        return current_;
+    }
+
+protected:
+    ~executor() = default;
+};
+
+
+/**********************************************
+* 򵥵ִһľ
+*
+* ʱԼעΪǰ̵ִ߳
+* ǰ̵߳ run_one() ȡһЭִָ̲
+*
+***********************************************/
+struct resume_queue : executor
+{
+    resume_queue()
+    {
+        previous_ = std::exchange(executor::current(), this);
+    }
+
+    resume_queue(const resume_queue&) = delete;
+    resume_queue& operator=(const resume_queue&) = delete;
+
+    ~resume_queue()
+    {
+        executor::current() = previous_;
+    }
+
+    //ָ֪ͨЭ֮̽resume_queue Ͼͱ
+    void post(std::coroutine_handle<> h) override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ready_.push_back(h);
+        cond_.notify_one();
+    }
+
+    //ȴһЭ̣ڵǰ߳ϻָ
+    void run_one()
+    {
+        std::coroutine_handle<> h;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this] { return !ready_.empty(); });
+            h = ready_.front();
+            ready_.pop_front();
+        }
+        h.resume();
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<std::coroutine_handle<>> ready_;
+    executor* previous_ = nullptr;
+};
+
+
+/**********************************************
+* ̳߳еڵ㣨ʽ
+*
+***********************************************/
+struct pool_job
+{
+    pool_job* next_ = nullptr;
+    void (*run_)(pool_job*) = nullptr;
+};
+
+
+/**********************************************
+* ̶߳не̳߳
+*
+* threads: ߳
+* max_queue: Ŷӵ֮ try_submit  false
+*
+***********************************************/
+class thread_pool
+{
+public:
+    struct stats
+    {
+        std::uint64_t submitted = 0;   //ɹͶݵ
+        std::uint64_t rejected = 0;    //Ϊܾ
+        std::uint64_t completed = 0;   //ִϵ
+        std::size_t queued = 0;        //ǰŶе
+    };
+
+    thread_pool(std::size_t threads, std::size_t max_queue)
+        : max_queue_(max_queue)
+    {
+        workers_.reserve(threads);
+        for (std::size_t i = 0; i < threads; ++i)
+            workers_.emplace_back([this] { worker_loop(); });
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    //ʱȴеִ꣬ٻ߳
+    ~thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cond_.notify_all();
+        for (auto& t : workers_)
+            t.join();
+    }
+
+    //Ͷ񣬶̳߳ڹرʱ false
+    bool try_submit(pool_job* job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_ || queued_ >= max_queue_)
+            {
+                rejected_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            job->next_ = nullptr;
+            if (tail_)
+                tail_->next_ = job;
+            else
+                head_ = job;
+            tail_ = job;
+            ++queued_;
+        }
+        submitted_.fetch_add(1, std::memory_order_relaxed);
+        cond_.notify_one();
+        return true;
+    }
+
+    stats get_stats() const
+    {
+        stats s;
+        s.submitted = submitted_.load(std::memory_order_relaxed);
+        s.rejected = rejected_.load(std::memory_order_relaxed);
+        s.completed = completed_.load(std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            s.queued = queued_;
+        }
+        return s;
+    }
+
+private:
+    void worker_loop()
+    {
+        for (;;)
+        {
+            pool_job* job = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait(lock, [this] { return stopping_ || head_ != nullptr; });
+                if (head_ == nullptr)
+                    return;   //stopping_ ҶѾ
+                job = head_;
+                head_ = job->next_;
+                if (head_ == nullptr)
+                    tail_ = nullptr;
+                --queued_;
+            }
+            //run_ ֮ job ѾЭ֡һˣٷ
+            job->run_(job);
+            completed_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;
+    pool_job* head_ = nullptr;
+    pool_job* tail_ = nullptr;
+    std::size_t queued_ = 0;
+    const std::size_t max_queue_;
+    bool stopping_ = false;
+
+    std::atomic<std::uint64_t> submitted_{ 0 };
+    std::atomic<std::uint64_t> rejected_{ 0 };
+    std::atomic<std::uint64_t> completed_{ 0 };
+
+    std::vector<std::thread> workers_;
+};
+
+
+/**********************************************
+* offload ʹõ awaiter
+*
+* awaiter ̳߳صڵ㣬
+* ִ̳߳߳ fn ֮Э̽ʱ¼ִ
+*
+***********************************************/
+template <class Fn>
+struct offload_awaiter : pool_job
+{
+    using result_type = std::invoke_result_t<Fn&>;
+
+    offload_awaiter(thread_pool& pool, Fn fn)
+        : pool_(pool), fn_(std::move(fn))
+    {
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    //Ͷݳɹ𣻶ܾʱֱڵǰִ߳ fn
+    bool await_suspend(std::coroutine_handle<> awaiting)
+    {
+        awaiting_ = awaiting;
+        exec_ = executor::current();
+        run_ = &offload_awaiter::run_job;
+        if (pool_.try_submit(this))
+            return true;
+        invoke();
+        return false;
+    }
+
+    result_type await_resume()
+    {
+        if (exception_)
+            std::rethrow_exception(exception_);
+        if constexpr (!std::is_void_v<result_type>)
+            return std::move(*result_);
+    }
+
+private:
+    void invoke() noexcept
+    {
+        try
+        {
+            if constexpr (std::is_void_v<result_type>)
+                fn_();
+            else
+                result_.emplace(fn_());
+        }
+        catch (...)
+        {
+            exception_ = std::current_exception();
+        }
+    }
+
+    //ִ̳߳߳
+    static void run_job(pool_job* job)
+    {
+        auto* self = static_cast<offload_awaiter*>(job);
+        self->invoke();
+        executor* exec = self->exec_;
+        std::coroutine_handle<> awaiting = self->awaiting_;
+        if (exec)
+            exec->post(awaiting);     //صԭִϻָ
+        else
+            awaiting.resume();        //ûֱִֻ̳߳߳ӻָ
+    }
+
+    struct no_value {};
+
+    thread_pool& pool_;
+    Fn fn_;
+    executor* exec_ = nullptr;
+    std::coroutine_handle<> awaiting_;
+    std::conditional_t<std::is_void_v<result_type>, no_value, std::optional<result_type>> result_;
+    std::exception_ptr exception_;
+};
+
+//co_await offload(pool, fn)fn ִ̳߳У fn ķֵ
+template <class Fn>
+auto offload(thread_pool& pool, Fn&& fn)
+{
+    return offload_awaiter<std::decay_t<Fn>>(pool, std::forward<Fn>(fn));
+}
@@ -0,0 +1,565 @@
+/****************************************************************************
+*
+* ʱĻ׼ԣsleep_forЭ̣ȽϲͬĶʱ
+*
+* ˣ
+* 1priority_queuestep5ȡܴӶɾֻܴϱǣʱٶ
+* 2RbTreestep7ʽ
+* 3DaryHeapʽ4ѣnetworkCoroutineDemoIoContextã
+* 4TimingWheel1msһĹϣʱ֣ȡO(1)ǵʱ䱻ȡϣ
+*
+* أnЭ̣ÿһʱseconds룩
+* 1uniformÿsleep_for [1ms, 1s) ֮ľʱ
+* 2burstyжʱ뵽100msı߽磨һ㶶ʱѣ
+* 3cancelledÿsleep_for 1sһЭÿȡn/500ʱ󲿷ֶʱڵ֮ǰͱȡˣ
+* 4resetгʱÿsleep_for 1sһЭÿѡn/500"ݵ"ѶʱƳٵ1s֮󣨲ָЭ̣
+*
+* insert/cancel/expireÿٰΣֻĲܳһʱ
+*       ÿʱռõڴ棨ʱڵ + ķֵ / nʱӳ٣ʵʻָʱ - ʱ䣩
+*
+* ÷bench_timers [n] [seconds]Ĭ 1000000 2
+*  -DCMAKE_BUILD_TYPE=Release 
+*
+*****************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "dary_heap.hpp"
+#include "rbtree.hpp"
+
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+/*
+* к˵Ķʱڵ㶼еĲ
+*
+*/
+struct TimerBase {
+    Clock::time_point mExpireTime{};
+    std::coroutine_handle<> mCoroutine{};
+    bool mArmed = false;        //
+    bool mCancelled = false;    //һsleepǱȡ
+    std::uint32_t mPending = 0; //ڴ±+10ʾڣbool
+};
+
+/*
+* step5std::priority_queueȡʱֻżһɵĿڶʱŶԲϾͶ
+*
+*/
+struct PriorityQueueTimers {
+    static constexpr const char* kName = "priority_queue";
+
+    struct Timer : TimerBase {
+        std::uint64_t mSeq = 0;
+    };
+
+    struct Entry {
+        Clock::time_point expireTime;
+        Timer* timer;
+        std::uint64_t seq;
+
+        bool operator<(Entry const& that) const noexcept {
+            return expireTime > that.expireTime;
+        }
+    };
+
+    //Ϊõײvector
+    struct Queue : std::priority_queue<Entry> {
+        std::size_t capacity() const { return c.capacity(); }
+    };
+
+    Queue mQueue;
+
+    void add(Timer& timer) {
+        mQueue.push(Entry{ timer.mExpireTime, &timer, timer.mSeq });
+    }
+
+    void cancel(Timer& timer) {
+        ++timer.mSeq;
+    }
+
+    template <class Fire>
+    void expire(Clock::time_point now, Fire&& fire) {
+        while (!mQueue.empty() && mQueue.top().expireTime <= now) {
+            Entry entry = mQueue.top();
+            mQueue.pop();
+            if (entry.seq == entry.timer->mSeq)
+                fire(*entry.timer);
+        }
+    }
+
+    std::optional<Clock::time_point> next() const {
+        if (mQueue.empty())
+            return std::nullopt;
+        return mQueue.top().expireTime;   //ѾȡĿһζ
+    }
+
+    std::size_t overheadBytes() const {
+        return mQueue.capacity() * sizeof(Entry);
+    }
+};
+
+/*
+* step7ʽ
+*
+*/
+struct RbTreeTimers {
+    static constexpr const char* kName = "RbTree";
+
+    struct Timer : TimerBase, RbTree<Timer>::RbNode {
+        friend bool operator<(Timer const& lhs, Timer const& rhs) noexcept {
+            return lhs.mExpireTime < rhs.mExpireTime;
+        }
+    };
+
+    RbTree<Timer> mTree;
+
+    void add(Timer& timer) {
+        mTree.insert(timer);
+    }
+
+    void cancel(Timer& timer) {
+        mTree.erase(timer);
+    }
+
+    template <class Fire>
+    void expire(Clock::time_point now, Fire&& fire) {
+        while (!mTree.empty() && mTree.front().mExpireTime <= now) {
+            auto& timer = mTree.front();
+            mTree.erase(timer);
+            fire(timer);
+        }
+    }
+
+    std::optional<Clock::time_point> next() const {
+        if (mTree.empty())
+            return std::nullopt;
+        return mTree.front().mExpireTime;
+    }
+
+    std::size_t overheadBytes() const {
+        return 0;   //ڵȫ
+    }
+};
+
+/*
+* ʽ4
+*
+*/
+struct DaryHeapTimers {
+    static constexpr const char* kName = "DaryHeap<4>";
+
+    struct Timer : TimerBase, DaryHeap<Timer>::HeapNode {
+        friend bool operator<(Timer const& lhs, Timer const& rhs) noexcept {
+            return lhs.mExpireTime < rhs.mExpireTime;
+        }
+    };
+
+    DaryHeap<Timer> mHeap;
+    std::size_t mPeak = 0;
+
+    void add(Timer& timer) {
+        mHeap.insert(timer);
+        mPeak = std::max(mPeak, mHeap.size());
+    }
+
+    void cancel(Timer& timer) {
+        mHeap.erase(timer);
+    }
+
+    template <class Fire>
+    void expire(Clock::time_point now, Fire&& fire) {
+        while (!mHeap.empty() && mHeap.front().mExpireTime <= now) {
+            auto& timer = mHeap.front();
+            mHeap.erase(timer);
+            fire(timer);
+        }
+    }
+
+    std::optional<Clock::time_point> next() const {
+        if (mHeap.empty())
+            return std::nullopt;
+        return mHeap.front().mExpireTime;
+    }
+
+    std::size_t overheadBytes() const {
+        return mPeak * sizeof(void*);   //ÿڵһָ
+    }
+};
+
+/*
+* ϣʱ֣kSlotsӣÿkTickʱȡ
+* һȦĶʱ͵ǰһȦķͬһתʱȽmTickû
+*
+*/
+struct TimingWheelTimers {
+    static constexpr const char* kName = "TimingWheel";
+    static constexpr Clock::duration kTick = 1ms;
+    static constexpr std::size_t kSlots = 4096;
+
+    struct Timer : TimerBase {
+        Timer* mPrev = nullptr;
+        Timer* mNext = nullptr;
+        std::uint64_t mTick = 0;
+    };
+
+    Clock::time_point mStart = Clock::now();
+    std::uint64_t mCurrentTick = 0;   //һҪĸ
+    std::size_t mCount = 0;
+    std::vector<Timer*> mSlots = std::vector<Timer*>(kSlots, nullptr);
+
+    void add(Timer& timer) {
+        auto ticks = (timer.mExpireTime - mStart + kTick - Clock::duration(1)) / kTick;
+        timer.mTick = std::max<std::uint64_t>(ticks < 0 ? 0 : std::uint64_t(ticks), mCurrentTick);
+        Timer*& head = mSlots[timer.mTick % kSlots];
+        timer.mPrev = nullptr;
+        timer.mNext = head;
+        if (head)
+            head->mPrev = &timer;
+        head = &timer;
+        ++mCount;
+    }
+
+    void cancel(Timer& timer) {
+        if (timer.mPrev)
+            timer.mPrev->mNext = timer.mNext;
+        else
+            mSlots[timer.mTick % kSlots] = timer.mNext;
+        if (timer.mNext)
+            timer.mNext->mPrev = timer.mPrev;
+        --mCount;
+    }
+
+    template <class Fire>
+    void expire(Clock::time_point now, Fire&& fire) {
+        std::uint64_t nowTick = std::uint64_t((now - mStart) / kTick);
+        for (; mCurrentTick <= nowTick && mCount > 0; ++mCurrentTick) {
+            Timer* timer = mSlots[mCurrentTick % kSlots];
+            while (timer) {
+                Timer* next = timer->mNext;
+                if (timer->mTick <= mCurrentTick) {
+                    cancel(*timer);
+                    fire(*timer);
+                }
+                timer = next;
+            }
+        }
+        if (mCount == 0)
+            mCurrentTick = std::max(mCurrentTick, nowTick + 1);
+    }
+
+    std::optional<Clock::time_point> next() const {
+        if (mCount == 0)
+            return std::nullopt;
+        return mStart + kTick * mCurrentTick;   //жʱÿһ
+    }
+
+    std::size_t overheadBytes() const {
+        return kSlots * sizeof(Timer*);
+    }
+};
+
+/*
+* ͳ
+*
+*/
+struct Stats {
+    std::uint64_t inserts = 0;
+    std::uint64_t cancels = 0;
+    std::uint64_t expires = 0;
+    Clock::duration insertTime{};
+    Clock::duration cancelTime{};
+    Clock::duration expireTime{};
+    std::vector<Clock::duration> late;   //ÿδӳ
+};
+
+/*
+* ̵߳¼ѭ + һʱˣûжʱʱsleep_untilĵʱ
+*
+* һξĲֻмʮ룬һClock::now()࣬ʱĻ
+* Բȡ֮ܿ󡢼鵽֮ǰÿֻһʱ
+* ֻʱ򱻶ƳٶԽûӰ
+*
+*/
+template <class Timers>
+struct Loop {
+    using Timer = typename Timers::Timer;
+
+    Timers mTimers;
+    std::deque<std::coroutine_handle<>> mReady;
+    std::size_t mLive = 0;   //ûнЭ̸
+    Stats mStats;
+    std::vector<std::pair<Timer*, Clock::time_point>> mInserts;   //룬ʱڲʱдڵ
+    std::vector<Timer*> mRemoves;                                 //ɾ
+
+    void add(Timer& timer, Clock::time_point expireTime) {
+        mInserts.emplace_back(&timer, expireTime);
+        timer.mPending = std::uint32_t(mInserts.size());
+        timer.mArmed = true;
+    }
+
+    //ȡõЭͨлָ
+    void cancel(Timer& timer) {
+        if (!timer.mArmed)
+            return;
+        remove(timer);
+        timer.mCancelled = true;
+        mReady.push_back(timer.mCoroutine);
+    }
+
+    //ãƳٵʱ䣬Э̼ȴ
+    void reset(Timer& timer, Clock::time_point expireTime) {
+        if (!timer.mArmed)
+            return;
+        if (timer.mPending) {
+            mInserts[timer.mPending - 1].second = expireTime;
+            return;
+        }
+        remove(timer);
+        add(timer, expireTime);
+    }
+
+    void run() {
+        while (mLive > 0) {
+            while (!mReady.empty()) {
+                auto coroutine = mReady.front();
+                mReady.pop_front();
+                coroutine.resume();
+            }
+            if (mLive == 0)
+                break;
+
+            flush();
+            auto now = Clock::now();
+            mTimers.expire(now, [&](Timer& timer) {
+                timer.mArmed = false;
+                mStats.late.push_back(now - timer.mExpireTime);
+                mReady.push_back(timer.mCoroutine);
+                ++mStats.expires;
+            });
+            mStats.expireTime += Clock::now() - now;
+
+            if (mReady.empty()) {
+                if (auto next = mTimers.next())
+                    std::this_thread::sleep_until(*next);
+            }
+        }
+    }
+
+private:
+    //ֱϣѾĵflushʱɾ
+    void remove(Timer& timer) {
+        if (timer.mPending)
+            timer.mPending = 0;
+        else
+            mRemoves.push_back(&timer);
+        timer.mArmed = false;
+    }
+
+    //ɾ壺ͬһﱻɾĶʱsleep
+    void flush() {
+        if (!mRemoves.empty()) {
+            auto start = Clock::now();
+            for (Timer* timer : mRemoves)
+                mTimers.cancel(*timer);
+            mStats.cancelTime += Clock::now() - start;
+            mStats.cancels += mRemoves.size();
+            mRemoves.clear();
+        }
+        if (!mInserts.empty()) {
+            std::uint64_t count = 0;
+            auto start = Clock::now();
+            for (std::size_t i = 0; i < mInserts.size(); ++i) {
+                auto [timer, expireTime] = mInserts[i];
+                if (timer->mPending != i + 1)
+                    continue;   //Ѿȡȡּ֮ӽһ
+                timer->mPending = 0;
+                timer->mExpireTime = expireTime;
+                mTimers.add(*timer);
+                ++count;
+            }
+            mStats.insertTime += Clock::now() - start;
+            mStats.inserts += count;
+            mInserts.clear();
+        }
+    }
+};
+
+template <class Timers>
+struct SleepAwaiter {
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> coroutine) {
+        mTimer.mCoroutine = coroutine;
+        mTimer.mCancelled = false;
+        mLoop.add(mTimer, mExpireTime);
+    }
+
+    //ڷtrueȡfalse
+    bool await_resume() const noexcept {
+        return !mTimer.mCancelled;
+    }
+
+    Loop<Timers>& mLoop;
+    typename Timers::Timer& mTimer;
+    Clock::time_point mExpireTime;
+};
+
+/*
+* ֮ùܵЭ̣ʱԼЭ֡
+*
+*/
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+enum class Pattern {
+    Uniform,
+    Bursty,
+    Cancelled,
+    Reset,
+};
+
+const char* patternName(Pattern pattern) {
+    switch (pattern) {
+    case Pattern::Uniform: return "uniform";
+    case Pattern::Bursty: return "bursty";
+    case Pattern::Cancelled: return "cancelled";
+    case Pattern::Reset: return "reset";
+    }
+    return "?";
+}
+
+//һӣͣsleepֱԽ
+template <class Timers>
+Detached connection(Loop<Timers>& loop, typename Timers::Timer& timer, Pattern pattern,
+    std::uint64_t seed, Clock::time_point begin, Clock::time_point end) {
+    ++loop.mLive;
+    std::mt19937_64 rng{ seed };
+    std::uniform_int_distribution<int> uniformUs{ 1000, 999999 };
+    std::uniform_int_distribution<int> jitterUs{ 0, 99 };
+    for (auto now = Clock::now(); now < end; now = Clock::now()) {
+        Clock::time_point expireTime;
+        switch (pattern) {
+        case Pattern::Uniform:
+            expireTime = now + std::chrono::microseconds(uniformUs(rng));
+            break;
+        case Pattern::Bursty:
+            expireTime = begin + ((now - begin) / 100ms + 1) * 100ms + std::chrono::microseconds(jitterUs(rng));
+            break;
+        case Pattern::Cancelled:
+        case Pattern::Reset:
+            expireTime = now + 1s;
+            break;
+        }
+        co_await SleepAwaiter<Timers>{ loop, timer, expireTime };
+    }
+    --loop.mLive;
+}
+
+//ģϵĻÿn/500ӣȡƳǵĶʱ
+template <class Timers>
+Detached activity(Loop<Timers>& loop, typename Timers::Timer* timers, std::size_t n, Pattern pattern,
+    Clock::time_point end) {
+    ++loop.mLive;
+    typename Timers::Timer self;
+    std::mt19937_64 rng{ 7 };
+    std::size_t perTick = std::max<std::size_t>(1, n / 500);
+    for (auto now = Clock::now(); now < end; now = Clock::now()) {
+        co_await SleepAwaiter<Timers>{ loop, self, now + 1ms };
+        now = Clock::now();
+        for (std::size_t i = 0; i < perTick; ++i) {
+            auto& timer = timers[rng() % n];
+            if (pattern == Pattern::Cancelled)
+                loop.cancel(timer);
+            else
+                loop.reset(timer, now + 1s);
+        }
+    }
+    --loop.mLive;
+}
+
+double mops(std::uint64_t ops, Clock::duration time) {
+    double ns = std::chrono::duration<double, std::nano>(time).count();
+    if (ops == 0 || ns <= 0)
+        return 0;
+    return double(ops) / ns * 1000.0;
+}
+
+double us(Clock::duration d) {
+    return std::chrono::duration<double, std::micro>(d).count();
+}
+
+template <class Timers>
+void bench(Pattern pattern, std::size_t n, Clock::duration duration) {
+    std::unique_ptr<typename Timers::Timer[]> timers(new typename Timers::Timer[n]);
+    Loop<Timers> loop;
+    auto begin = Clock::now();
+    auto end = begin + duration;
+    for (std::size_t i = 0; i < n; ++i)
+        connection(loop, timers[i], pattern, i, begin, end);
+    if (pattern == Pattern::Cancelled || pattern == Pattern::Reset)
+        activity(loop, timers.get(), n, pattern, end);
+    loop.run();
+
+    auto& stats = loop.mStats;
+    auto& late = stats.late;
+    Clock::duration mean{}, p99{}, max{};
+    if (!late.empty()) {
+        Clock::duration total{};
+        for (auto d : late)
+            total += d;
+        mean = total / std::int64_t(late.size());
+        auto nth = late.begin() + late.size() * 99 / 100;
+        std::nth_element(late.begin(), nth, late.end());
+        p99 = *nth;
+        max = *std::max_element(late.begin(), late.end());
+    }
+
+    std::cout << std::fixed << std::setprecision(1)
+        << std::left << std::setw(10) << patternName(pattern)
+        << std::setw(15) << Timers::kName << std::right
+        << " insert=" << std::setw(6) << mops(stats.inserts, stats.insertTime) << "M/s"
+        << " cancel=" << std::setw(6) << mops(stats.cancels, stats.cancelTime) << "M/s"
+        << " expire=" << std::setw(6) << mops(stats.expires, stats.expireTime) << "M/s"
+        << " mem=" << std::setw(5) << sizeof(typename Timers::Timer) + double(loop.mTimers.overheadBytes()) / double(n) << "B"
+        << " late(us) mean=" << std::setw(7) << us(mean) << " p99=" << std::setw(7) << us(p99)
+        << " max=" << std::setw(8) << us(max)
+        << " fired=" << stats.expires << " cancels=" << stats.cancels << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    double seconds = argc > 2 ? std::atof(argv[2]) : 2.0;
+    auto duration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    std::cout << "timers=" << n << " seconds=" << seconds << std::endl;
+
+    for (Pattern pattern : { Pattern::Uniform, Pattern::Bursty, Pattern::Cancelled, Pattern::Reset }) {
+        bench<PriorityQueueTimers>(pattern, n, duration);
+        bench<RbTreeTimers>(pattern, n, duration);
+        bench<DaryHeapTimers>(pattern, n, duration);
+        bench<TimingWheelTimers>(pattern, n, duration);
+    }
+}
@@ -0,0 +1,444 @@
+#pragma once
+
+/*
+* Эͳƺʱpromise㣬ֻжCORO_PROFILEʱŻᱻصʱpromiseûκζĴ
+*
+* 1Э;Э̺promise캯Ĭϲstd::source_location֣inside_loophello1
+* 2ÿιͻָTSCһʱx86ƽ̨steady_clockδ֮ʱ䣺
+*      - ЭУ͵ʱ䣬Ƕ׵ЭеʱЭԼģ㸸Э̵ģ
+*      - Э̱ʱֱͼֱͼ2ݷͰ
+* 3co_awaitpromiseawait_transformװProfiledAwaiterinitial_suspendҲһfinal_suspendֱӴ㣻
+* 4Э֡ĴСpromiseoperator newõֲͨ߳̾Źpromise
+* 5ͳÿһݵԭӼЭ̿߳Уsnapshot()ʱȡһݿգ
+* 6ͬʱCORO_TRACEʱͬĴ㻹дʱߣcoro_trace.hpp
+* 7ͬʱCORO_SAMPLEʱÿЭ֡Լ߼SIGPROFʱԭ첽ջcoro_sampler.hpp
+*
+*   for (auto const& s : coro_profile::snapshot()) ...
+*   coro_profile::print(std::cerr);
+*
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <source_location>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace coro_profile {
+
+inline std::uint64_t now() noexcept {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+//iͰ¼ʱ[2^(i-1), 2^i)tickĴ
+constexpr std::size_t kBuckets = 48;
+
+struct Site {
+    std::string name;
+    std::string file;
+    std::uint_least32_t line = 0;
+    std::atomic<std::size_t> frameSize{ 0 };
+    std::atomic<std::uint64_t> created{ 0 };
+    std::atomic<std::uint64_t> destroyed{ 0 };
+    std::atomic<std::uint64_t> resumes{ 0 };
+    std::atomic<std::uint64_t> runTicks{ 0 };
+    std::atomic<std::uint64_t> suspendedTicks{ 0 };
+    std::atomic<std::uint64_t> histogram[kBuckets]{};
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::map<std::string, std::unique_ptr<Site>> sites;
+    std::uint64_t startTicks = now();
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    static Registry& instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    //ͬһЭ̺function_name()ͬһַָ뻺棬ÿζ
+    Site& find(std::source_location const& loc) {
+        thread_local std::unordered_map<char const*, Site*> cache;
+        if (auto it = cache.find(loc.function_name()); it != cache.end()) [[likely]] {
+            return *it->second;
+        }
+        std::lock_guard lock(mutex);
+        auto& site = sites[loc.function_name()];
+        if (!site) {
+            site = std::make_unique<Site>();
+            site->name = loc.function_name();
+            site->file = loc.file_name();
+            site->line = loc.line();
+        }
+        cache.emplace(loc.function_name(), site.get());
+        return *site;
+    }
+
+    //ósteady_clockУ׼TSCƵʣ̫ʱȵһ
+    double nsPerTick() {
+        auto ticks = now() - startTicks;
+        auto elapsed = std::chrono::steady_clock::now() - startTime;
+        if (elapsed < std::chrono::milliseconds(10)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10) - elapsed);
+            return nsPerTick();
+        }
+        return std::chrono::duration<double, std::nano>(elapsed).count() / double(ticks ? ticks : 1);
+    }
+};
+
+} // namespace coro_profile
+
+#if CORO_TRACE
+#include "coro_trace.hpp"
+#endif
+
+namespace coro_profile {
+
+inline thread_local std::size_t tFrameSize = 0;
+
+#if CORO_SAMPLE
+#define CORO_PROFILE_RESUME_INLINE [[gnu::always_inline]] inline
+#else
+#define CORO_PROFILE_RESUME_INLINE
+#endif
+
+struct FrameProfile;
+
+//߳һιЭ̣жһλָǲcontinuationֱл
+inline thread_local FrameProfile* tLastSuspended = nullptr;
+
+//߳еЭ̣źŴҲԱǳʼ
+inline constinit thread_local FrameProfile* tRunning = nullptr;
+
+#if CORO_SAMPLE
+/*
+* ߼ϵһڵ㣺ĸЭ̺ϵЭ̴
+*
+* co_awaitЭʱ߾continuation_/mPreviousָĸЭ̣
+* async_scope::spawn()ЭcontinuationscopeİװЭ̣߲Э̣accept
+* ڵ㰴Э̺ڵ㣩ȥأһͲͷţЭ֡ԺµָȻЧ
+*
+*/
+struct ChainNode {
+    Site const* site;
+    ChainNode const* parent;
+    std::size_t depth;
+};
+
+struct ChainRegistry {
+    //ݹ鴴Э̣ÿspawnһԼʱޱ䳤ȾͲ½
+    static constexpr std::size_t kMaxDepth = 64;
+
+    std::mutex mutex;
+    std::map<std::pair<Site const*, ChainNode const*>, std::unique_ptr<ChainNode>> nodes;
+
+    static ChainRegistry& instance() {
+        static ChainRegistry registry;
+        return registry;
+    }
+
+    ChainNode const* intern(Site const* site, ChainNode const* parent) {
+        if (parent && parent->depth >= kMaxDepth) {
+            return parent;
+        }
+        thread_local std::map<std::pair<Site const*, ChainNode const*>, ChainNode const*> cache;
+        auto key = std::make_pair(site, parent);
+        if (auto it = cache.find(key); it != cache.end()) [[likely]] {
+            return it->second;
+        }
+        std::lock_guard lock(mutex);
+        auto& node = nodes[key];
+        if (!node) {
+            node = std::make_unique<ChainNode>(ChainNode{ site, parent, parent ? parent->depth + 1 : 1 });
+        }
+        cache.emplace(key, node.get());
+        return node.get();
+    }
+};
+#endif
+
+/*
+* ÿЭ֡һݣpromise
+*
+*/
+struct FrameProfile {
+    Site* site;
+    std::uint64_t last;
+    std::coroutine_handle<> const* continuation;   // promisecontinuation_/mPrevious
+    void* frame = nullptr;                         // һιinitial_suspendʱ֪
+    FrameProfile* outer = tRunning;                // ָЭʱеЭ̣ʱ
+#if CORO_SAMPLE
+    ChainNode const* chain;                        // ʱеЭ̵ĵٽԼ
+    void const* stack = nullptr;                   // һλָʱЭַ֡ʱзԭջ
+#endif
+
+    FrameProfile(std::source_location const& loc, std::coroutine_handle<> const* continuation)
+        : site(&Registry::instance().find(loc)),
+        last(now()),
+        continuation(continuation)
+#if CORO_SAMPLE
+        , chain(ChainRegistry::instance().intern(site, tRunning ? tRunning->chain : nullptr))
+#endif
+    {
+        site->created.fetch_add(1, std::memory_order_relaxed);
+        if (tFrameSize) {
+            site->frameSize.store(tFrameSize, std::memory_order_relaxed);
+            tFrameSize = 0;
+        }
+    }
+
+    FrameProfile(FrameProfile&&) = delete;
+
+    ~FrameProfile() {
+        site->destroyed.fetch_add(1, std::memory_order_relaxed);
+        if (tLastSuspended == this) {
+            tLastSuspended = nullptr;
+        }
+        if (tRunning == this) {
+            tRunning = outer;
+        }
+#if CORO_TRACE
+        coro_trace::instant(site->name.c_str(), "destroy", now(), frame);
+#endif
+    }
+
+    void onSuspend(void* address) noexcept {
+        auto t = now();
+        site->runTicks.fetch_add(t - last, std::memory_order_relaxed);
+#if CORO_TRACE
+        if (!frame) {
+            coro_trace::instant(site->name.c_str(), "create", last, address);
+        }
+        else {
+            coro_trace::complete(site->name.c_str(), "run", last, t, address);
+        }
+#endif
+        frame = address;
+        tLastSuspended = this;
+        tRunning = outer;
+        last = t;
+    }
+
+    //await_suspendfalseawait_readyΪtrueʱЭûʱ仹ʱ
+    //CORO_SAMPLEʱЭ壬µĲЭԼַ֡
+    CORO_PROFILE_RESUME_INLINE void onResume(bool suspended) noexcept {
+        auto t = now();
+#if CORO_SAMPLE
+        stack = __builtin_frame_address(0);
+#endif
+#if CORO_TRACE
+        //Эco_awaitЭ̣Э̽صЭ
+        if (auto from = std::exchange(tLastSuspended, nullptr); from && from != this &&
+            ((*from->continuation).address() == frame || (*continuation).address() == from->frame)) {
+            coro_trace::flow(from->last, t);
+        }
+#endif
+        if (suspended) {
+            site->resumes.fetch_add(1, std::memory_order_relaxed);
+            site->suspendedTicks.fetch_add(t - last, std::memory_order_relaxed);
+            std::size_t bucket = std::min<std::size_t>(std::bit_width(t - last), kBuckets - 1);
+            site->histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+        }
+        else {
+            site->runTicks.fetch_add(t - last, std::memory_order_relaxed);
+        }
+        last = t;
+        outer = std::exchange(tRunning, this);
+    }
+
+    void onFinal() noexcept {
+        onSuspend(frame);
+    }
+};
+
+//promiseoperator new
+inline void noteFrameSize(std::size_t size) noexcept {
+    tFrameSize = size;
+}
+
+/*
+* ȡco_awaitʽӦawaiteroperator co_await͵ʽawaiter
+* ʽʱһֱco_awaitڵʽֻ
+*
+*/
+template <class T>
+decltype(auto) getAwaiter(T&& expr) {
+    if constexpr (requires { std::forward<T>(expr).operator co_await(); }) {
+        return std::forward<T>(expr).operator co_await();
+    }
+    else if constexpr (requires { operator co_await(std::forward<T>(expr)); }) {
+        return operator co_await(std::forward<T>(expr));
+    }
+    else {
+        return std::forward<T>(expr);
+    }
+}
+
+/*
+* װһawaiterڹǰͻָ
+*
+* ڲawait_suspend֮Э̿Ѿڱ߳ϻָѾˣ
+* ֻfalseûй𣩵ʱthis
+*
+*/
+template <class A>
+struct ProfiledAwaiter {
+    A mInner;
+    FrameProfile& mProfile;
+    bool mSuspended = false;
+
+    bool await_ready() {
+        return mInner.await_ready();
+    }
+
+    /*
+    * ڲawait_suspend﷢ϵͳãsendepoll_ctlЭ̵ģ
+    * ȰtRunningڲ㷵ԺٻָЭ̣һֻþֲthis
+    *
+    */
+    template <class Promise>
+    auto await_suspend(std::coroutine_handle<Promise> coroutine) {
+        mSuspended = true;
+        FrameProfile* outer = mProfile.outer;
+        mProfile.onSuspend(coroutine.address());
+        tRunning = &mProfile;
+        if constexpr (std::is_same_v<decltype(mInner.await_suspend(coroutine)), bool>) {
+            bool suspend = mInner.await_suspend(coroutine);
+            tRunning = outer;
+            if (!suspend) {
+                mSuspended = false;
+            }
+            return suspend;
+        }
+        else if constexpr (std::is_void_v<decltype(mInner.await_suspend(coroutine))>) {
+            mInner.await_suspend(coroutine);
+            tRunning = outer;
+        }
+        else {
+            auto next = mInner.await_suspend(coroutine);
+            tRunning = outer;
+            return next;
+        }
+    }
+
+    CORO_PROFILE_RESUME_INLINE decltype(auto) await_resume() {
+        mProfile.onResume(mSuspended);
+        return mInner.await_resume();
+    }
+};
+
+template <class T>
+ProfiledAwaiter<decltype(getAwaiter(std::declval<T>()))> profileAwait(T&& expr, FrameProfile& profile) {
+    return { getAwaiter(std::forward<T>(expr)), profile };
+}
+
+struct TypeStats {
+    std::string name;
+    std::string file;
+    std::uint_least32_t line = 0;
+    std::size_t frameSize = 0;
+    std::uint64_t created = 0;
+    std::uint64_t destroyed = 0;
+    std::uint64_t resumes = 0;
+    double runNs = 0;
+    double suspendedNs = 0;
+    std::vector<std::pair<double, std::uint64_t>> suspensions;   //ͰϽnsֻзǿյͰ
+};
+
+//ʱӶൽ
+inline std::vector<TypeStats> snapshot() {
+    auto& registry = Registry::instance();
+    double nsPerTick = registry.nsPerTick();
+    std::vector<TypeStats> result;
+    std::lock_guard lock(registry.mutex);
+    for (auto const& [name, site] : registry.sites) {
+        TypeStats s;
+        s.name = site->name;
+        s.file = site->file;
+        s.line = site->line;
+        s.frameSize = site->frameSize.load(std::memory_order_relaxed);
+        s.created = site->created.load(std::memory_order_relaxed);
+        s.destroyed = site->destroyed.load(std::memory_order_relaxed);
+        s.resumes = site->resumes.load(std::memory_order_relaxed);
+        s.runNs = double(site->runTicks.load(std::memory_order_relaxed)) * nsPerTick;
+        s.suspendedNs = double(site->suspendedTicks.load(std::memory_order_relaxed)) * nsPerTick;
+        for (std::size_t i = 0; i < kBuckets; ++i) {
+            if (auto n = site->histogram[i].load(std::memory_order_relaxed)) {
+                s.suspensions.emplace_back(double(std::uint64_t(1) << i) * nsPerTick, n);
+            }
+        }
+        result.push_back(std::move(s));
+    }
+    std::sort(result.begin(), result.end(), [](TypeStats const& a, TypeStats const& b) {
+        return a.runNs > b.runNs;
+    });
+    return result;
+}
+
+inline void printDuration(std::ostream& out, double ns) {
+    if (ns < 1e3) {
+        out << ns << "ns";
+    }
+    else if (ns < 1e6) {
+        out << ns / 1e3 << "us";
+    }
+    else if (ns < 1e9) {
+        out << ns / 1e6 << "ms";
+    }
+    else {
+        out << ns / 1e9 << "s";
+    }
+}
+
+inline void print(std::ostream& out) {
+    auto flags = out.flags();
+    out << std::fixed << std::setprecision(1);
+    for (auto const& s : snapshot()) {
+        out << s.name << " (" << s.file << ':' << s.line << ")\n"
+            << "  frame=" << s.frameSize << "B created=" << s.created
+            << " live=" << s.created - s.destroyed << " resumes=" << s.resumes << " run=";
+        printDuration(out, s.runNs);
+        out << " suspended=";
+        printDuration(out, s.suspendedNs);
+        out << "\n  suspensions:";
+        for (auto const& [upper, count] : s.suspensions) {
+            out << " <";
+            printDuration(out, upper);
+            out << ':' << count;
+        }
+        out << '\n';
+    }
+    out.flags(flags);
+}
+
+} // namespace coro_profile
+
+#if CORO_SAMPLE
+#include "coro_sampler.hpp"
+#endif
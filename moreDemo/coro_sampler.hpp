@@ -0,0 +1,304 @@
+#pragma once
+
+/*
+* 첽ջCORO_SAMPLEʱcoro_profile.hppֻ֧Linux/glibc
+* ûжCORO_SAMPLEʱҲԵcapture()/fold()ֻץԭջCORO_PROFILEʱټеЭ̣
+* networkCoroutineDemo¼ѭŹץס߳
+*
+* perf֮Ĳõԭջͣ IoContext::run -> Socket::ResumeRecv -> coroutine_handle::resume
+* Э̵CPUsetitimer(ITIMER_PROF)CPUʱ䶨ʱSIGPROFÿβ
+* 1_Unwind_Backtrace()ԭջÿһ֡ķصַջ
+* 2ӱ߳еЭ̣coro_profile::tRunningŴĵߣÿһЭ̺
+*      co_awaitЭʱcontinuation_/mPreviousһ£
+*      async_scope::spawn()Э̽ڷspawnЭ棬ܿ accept -> echo_socket -> inside_loop
+* 3ʱƴflamegraph.plõfoldedʽָЭ֮ǰԭջ + 첽 + Эõԭջ
+*      Э壨GCC.actorǾֲţdladdr()Ҳ֣԰ջַз֣
+*      ЭÿλָʱЭַ֡ջߵ֡Э棬ջ͵һ֡Э壬Эõĺ
+*
+* źŴֻԭӲָջݣڴ棺start()һηãдԺµĲ
+* ڵһͲͷţԵʱЭ֡Ҳûϵ
+*
+*   coro_sampler::start();
+*   ...
+*   coro_sampler::stop();
+*   std::ofstream out("coro.folded");
+*   coro_sampler::writeFolded(out);     // flamegraph.pl coro.folded > coro.svg
+*
+* ִļҪ-rdynamicӣdladdr()ҵԼĺ
+*
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <sys/time.h>
+#include <unwind.h>
+
+#if CORO_PROFILE
+#include "coro_profile.hpp"
+#endif
+
+namespace coro_sampler {
+
+constexpr int kNativeDepth = 64;
+constexpr int kAsyncDepth = 32;
+
+struct Sample {
+    std::atomic<bool> ready{ false };
+    int nativeDepth = 0;
+    int asyncDepth = 0;
+    std::uintptr_t stack = 0;                               // еЭַ֡ûʱ0
+    std::uintptr_t native[kNativeDepth];                    // 
+    std::uintptr_t sp[kNativeDepth];
+#if CORO_PROFILE
+    coro_profile::Site const* async[kAsyncDepth];           // еЭ
+#endif
+};
+
+struct Sampler {
+    std::unique_ptr<Sample[]> samples;
+    std::size_t capacity = 0;
+    std::atomic<std::size_t> next{ 0 };
+
+    static Sampler& instance() {
+        static Sampler sampler;
+        return sampler;
+    }
+
+    std::size_t collected() const {
+        return std::min(next.load(std::memory_order_acquire), capacity);
+    }
+
+    std::size_t dropped() const {
+        auto n = next.load(std::memory_order_acquire);
+        return n > capacity ? n - capacity : 0;
+    }
+};
+
+inline _Unwind_Reason_Code unwindFrame(_Unwind_Context* context, void* arg) {
+    auto& s = *static_cast<Sample*>(arg);
+    if (s.nativeDepth == kNativeDepth) {
+        return _URC_END_OF_STACK;
+    }
+    //źŴϵһ֡IPһҪִеָ֮ǰµĶźŴԼ
+    int interrupted = 0;
+    auto ip = _Unwind_GetIPInfo(context, &interrupted);
+    if (interrupted) {
+        s.nativeDepth = 0;
+    }
+    //libgccûصʱCFAǱߵģҲһ֡callȥʱջ
+    s.native[s.nativeDepth] = ip;
+    s.sp[s.nativeDepth] = _Unwind_GetCFA(context);
+    ++s.nativeDepth;
+    return _URC_NO_REASON;
+}
+
+/*
+* źŴץǰ̵߳ĵջڴ棬
+* һεûlibgcc_sҪͨһwarmUp()
+*
+*/
+inline void capture(Sample& s) {
+    s.nativeDepth = 0;
+    _Unwind_Backtrace(unwindFrame, &s);
+    int depth = 0;
+    s.stack = 0;
+#if CORO_SAMPLE
+    if (auto* running = coro_profile::tRunning) {
+        s.stack = std::uintptr_t(running->stack);
+        for (auto* node = running->chain; node && depth < kAsyncDepth; node = node->parent) {
+            s.async[depth++] = node->site;
+        }
+    }
+#elif CORO_PROFILE
+    if (auto* running = coro_profile::tRunning) {
+        s.async[depth++] = running->site;
+    }
+#endif
+    s.asyncDepth = depth;
+}
+
+inline void warmUp() {
+    Sample s;
+    capture(s);
+}
+
+inline void onSignal(int) {
+    int savedErrno = errno;
+    auto& sampler = Sampler::instance();
+    std::size_t i = sampler.next.fetch_add(1, std::memory_order_relaxed);
+    if (i < sampler.capacity) {
+        Sample& s = sampler.samples[i];
+        capture(s);
+        s.ready.store(true, std::memory_order_release);
+    }
+    errno = savedErrno;
+}
+
+/*
+* ʼhzÿCPUʱĲ0maxSamples֮Ķ
+* ÿ1KB࣬Ĭϵ8192Լ10MB997Hz8CPUʱ䣬õĳԼmaxSamples
+* ͬһʱֻһظû֮ǰĲ
+*
+*/
+inline void start(int hz = 997, std::size_t maxSamples = 1 << 13) {
+    if (hz <= 0)
+        throw std::invalid_argument("coro_sampler::start: hz must be positive");
+    auto& sampler = Sampler::instance();
+    //ֻreadyҪʼջźŴд
+    sampler.samples = std::make_unique_for_overwrite<Sample[]>(maxSamples);
+    sampler.capacity = maxSamples;
+    sampler.next.store(0, std::memory_order_release);
+
+    //һջݻlibgcc_sע.eh_frameһܷźŴ
+    warmUp();
+
+    struct sigaction action {};
+    action.sa_handler = onSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, nullptr);
+
+    //tv_usecС1000000hzΪ1ʱ1룻00صʱ
+    long interval = std::max(1000000L / hz, 1L);
+    itimerval timer{};
+    timer.it_interval.tv_sec = interval / 1000000;
+    timer.it_interval.tv_usec = interval % 1000000;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+//ֹͣʱѾ·ϵSIGPROFȻᱻʱֻдĲ
+inline void stop() {
+    itimerval timer{};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+//foldedʽ';'Ƿָ
+inline std::string frameName(std::string name) {
+    for (auto& c : name) {
+        if (c == ';') {
+            c = ':';
+        }
+    }
+    return name;
+}
+
+//Ҳŵĵֲַȥ˷űĿ⣩д"ģ+ƫ"ַԺͬһλûͬһ
+inline std::string symbolize(std::uintptr_t address) {
+    Dl_info info;
+    if (!dladdr(reinterpret_cast<void*>(address), &info)) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "0x%zx", std::size_t(address));
+        return buffer;
+    }
+    if (!info.dli_sname) {
+        std::string_view file = info.dli_fname ? info.dli_fname : "?";
+        file = file.substr(file.find_last_of('/') + 1);
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "+0x%zx", std::size_t(address - std::uintptr_t(info.dli_fbase)));
+        return frameName(std::string(file) + buffer);
+    }
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    std::string name = frameName(demangled ? demangled : info.dli_sname);
+    std::free(demangled);
+    return name;
+}
+
+//ַĻ棬ܶʱͬһַֻһ
+using Symbols = std::map<std::uintptr_t, std::string>;
+
+/*
+* һƴfoldedʽһУ⵽';'
+*
+*/
+inline std::string fold(Sample const& s, Symbols& symbols) {
+    //һ֡Ƿصַ1callָϣ0ǻݵյ
+    //bodyЭһ֡ջЭַ֡ߵĶ
+    std::vector<std::string const*> frames;
+    std::size_t body = 0;
+    for (int j = s.nativeDepth - 1; j >= 0; --j) {
+        if (s.native[j] == 0) {
+            continue;
+        }
+        std::uintptr_t address = s.native[j] - (j > 0 ? 1 : 0);
+        auto it = symbols.find(address);
+        if (it == symbols.end()) {
+            it = symbols.emplace(address, symbolize(address)).first;
+        }
+        if (s.stack && s.sp[j] > s.stack) {
+            body = frames.size() + 1;
+        }
+        frames.push_back(&it->second);
+    }
+
+    std::string stack;
+    auto append = [&](std::string const& name) {
+        if (!stack.empty()) {
+            stack += ';';
+        }
+        stack += name;
+    };
+    //ûеЭʱԭջеĻЭһ֡첽
+    //Э̻ûָinitial_suspendֻ֪Э̺ûCORO_SAMPLEʱ֪Эģ첽
+    if (s.asyncDepth == 0 || s.stack == 0) {
+        body = frames.size();
+    }
+    for (std::size_t j = 0; j < body && j < frames.size(); ++j) {
+        append(*frames[j]);
+    }
+#if CORO_PROFILE
+    for (int j = s.asyncDepth - 1; j >= 0; --j) {
+        append(frameName(s.async[j]->name));
+    }
+#endif
+    for (std::size_t j = body + 1; j < frames.size(); ++j) {
+        append(*frames[j]);
+    }
+    return stack;
+}
+
+/*
+* foldedʽÿǴ⵽';'ĵջǲ
+* дĲ
+*
+*/
+inline std::size_t writeFolded(std::ostream& out) {
+    auto& sampler = Sampler::instance();
+    Symbols symbols;
+    std::map<std::string, std::size_t> stacks;
+    std::size_t total = 0;
+
+    std::size_t n = sampler.collected();
+    for (std::size_t i = 0; i < n; ++i) {
+        Sample const& s = sampler.samples[i];
+        if (!s.ready.load(std::memory_order_acquire)) {
+            continue;
+        }
+        ++stacks[fold(s, symbols)];
+        ++total;
+    }
+
+    for (auto const& [stack, count] : stacks) {
+        out << stack << ' ' << count << '\n';
+    }
+    return total;
+}
+
+} // namespace coro_sampler
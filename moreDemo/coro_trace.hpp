@@ -0,0 +1,185 @@
+#pragma once
+
+/*
+* ЭʱߣCORO_TRACEʱcoro_profile.hppͰͳƹpromiseĴ
+*
+* 1ÿ߳һ¼дԺ󸲸ɵ¼൱ڷм¼ǣһʱ䣻
+* 2¼¼
+*      - ЭÿһеʱһsliceЭ̺˲ʱ¼
+*      - continuation_/mPreviousлһflowͷЭco_awaitЭ̡Э̽صЭ̣
+*      - IoContextepoll_waitĽһsliceÿڵĶʱһ˲ʱ¼
+* 3ʱͰͳһTSCwriteJson()coro_profile::RegistryУ׼Ƶʻ΢룬Chrome traceJSONʽchrome://tracingui.perfetto.devֱӴ򿪣
+* 4д¼ʱҪ̻߳˵ʱûо̡߳ʱ̽
+*
+*   std::ofstream out("trace.json");
+*   coro_trace::writeJson(out);
+*
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace coro_trace {
+
+enum class Phase : std::uint8_t {
+    Complete,    // slicetsʼdurʱ
+    Instant,
+    FlowStart,
+    FlowEnd,
+};
+
+struct Event {
+    std::uint64_t ts;
+    std::uint64_t dur;
+    char const* name;
+    char const* category;
+    std::uint64_t id;      // slice˲ʱ¼Э֡ĵַflowͷı
+    std::uint64_t arg;
+    Phase phase;
+};
+
+struct Buffer {
+    static constexpr std::size_t kCapacity = std::size_t(1) << 18;
+
+    std::mutex mutex;
+    std::vector<Event> events;
+    std::size_t next = 0;      // дԺһҪǵλ
+    std::uint32_t tid = 0;
+    std::string threadName;
+    std::uint64_t flows = 0;
+
+    void push(Event const& event) {
+        std::lock_guard lock(mutex);
+        if (events.size() < kCapacity) {
+            events.push_back(event);
+            return;
+        }
+        events[next] = event;
+        next = (next + 1) % kCapacity;
+    }
+};
+
+struct Tracer {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<Buffer>> buffers;
+
+    static Tracer& instance() {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    //߳˳Ժ󻺳Tracerʱܿ
+    static Buffer& local() {
+        thread_local std::shared_ptr<Buffer> buffer = [] {
+            auto& tracer = instance();
+            auto buffer = std::make_shared<Buffer>();
+            std::lock_guard lock(tracer.mutex);
+            buffer->tid = std::uint32_t(tracer.buffers.size() + 1);
+            buffer->threadName = "thread " + std::to_string(buffer->tid);
+            tracer.buffers.push_back(buffer);
+            return buffer;
+        }();
+        return *buffer;
+    }
+};
+
+inline void setThreadName(std::string name) {
+    auto& buffer = Tracer::local();
+    std::lock_guard lock(buffer.mutex);
+    buffer.threadName = std::move(name);
+}
+
+inline void complete(char const* name, char const* category, std::uint64_t start, std::uint64_t end,
+    void const* id = nullptr, std::uint64_t arg = 0) {
+    Tracer::local().push({ start, end - start, name, category, std::uint64_t(id), arg, Phase::Complete });
+}
+
+inline void instant(char const* name, char const* category, std::uint64_t ts,
+    void const* id = nullptr, std::uint64_t arg = 0) {
+    Tracer::local().push({ ts, 0, name, category, std::uint64_t(id), arg, Phase::Instant });
+}
+
+//fromǼͷsliceĽʱ䣬ǰŲһtickslice棻toյsliceĿʼʱ
+inline void flow(std::uint64_t from, std::uint64_t to) {
+    auto& buffer = Tracer::local();
+    std::uint64_t id = (std::uint64_t(buffer.tid) << 40) | ++buffer.flows;
+    buffer.push({ from - 1, 0, "continuation", "flow", id, 0, Phase::FlowStart });
+    buffer.push({ to, 0, "continuation", "flow", id, 0, Phase::FlowEnd });
+}
+
+inline void writeString(std::ostream& out, char const* s) {
+    out << '"';
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') {
+            out << '\\';
+        }
+        out << *s;
+    }
+    out << '"';
+}
+
+/*
+* Chrome traceJSONʱ䵥λ΢룬0ǳһõcoro_profileʱ
+*
+*/
+inline void writeJson(std::ostream& out) {
+    auto& registry = coro_profile::Registry::instance();
+    std::uint64_t startTicks = registry.startTicks;
+    double nsPerTick = registry.nsPerTick();
+    auto us = [&](std::uint64_t ticks) {
+        return double(ticks) * nsPerTick / 1000.0;
+    };
+
+    std::vector<std::shared_ptr<Buffer>> buffers;
+    {
+        auto& tracer = Tracer::instance();
+        std::lock_guard lock(tracer.mutex);
+        buffers = tracer.buffers;
+    }
+
+    auto flags = out.flags();
+    out << std::fixed;
+    out.precision(3);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    bool first = true;
+    for (auto const& buffer : buffers) {
+        std::lock_guard lock(buffer->mutex);
+        out << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->tid
+            << ",\"args\":{\"name\":";
+        writeString(out, buffer->threadName.c_str());
+        out << "}}";
+        first = false;
+        for (auto const& e : buffer->events) {
+            double ts = e.ts > startTicks ? us(e.ts - startTicks) : 0.0;
+            out << ",\n{\"pid\":1,\"tid\":" << buffer->tid << ",\"ts\":" << ts << ",\"name\":";
+            writeString(out, e.name);
+            out << ",\"cat\":";
+            writeString(out, e.category);
+            switch (e.phase) {
+            case Phase::Complete:
+                out << ",\"ph\":\"X\",\"dur\":" << us(e.dur) << ",\"args\":{\"frame\":\"0x" << std::hex << e.id
+                    << std::dec << "\",\"arg\":" << e.arg << "}}";
+                break;
+            case Phase::Instant:
+                out << ",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"frame\":\"0x" << std::hex << e.id
+                    << std::dec << "\",\"arg\":" << e.arg << "}}";
+                break;
+            case Phase::FlowStart:
+                out << ",\"ph\":\"s\",\"id\":" << e.id << "}";
+                break;
+            case Phase::FlowEnd:
+                out << ",\"ph\":\"f\",\"bp\":\"e\",\"id\":" << e.id << "}";
+                break;
+            }
+        }
+    }
+    out << "\n]}\n";
+    out.flags(flags);
+}
+
+} // namespace coro_trace
@@ -0,0 +1,151 @@
+#pragma once
+
+/*
+* ʽdѣĬ4棩ӿںRbTreeһinsert/erase/front/emptyֱ滻ʱõRbTree
+*
+* 1ڵ̳HeapNodeֻڵָ룬ڵ¼Լе±꣬eraseO(log n)
+* 2front()O(1)4ѱȶѰһ룬һڵ4ڣ³ʱȽϵĶڴ棻
+* 3RbNodeһڵʱڶԶӶժ
+* 4ȽȵĽڵ֮ûȺ˳RbTreeȲǰ
+*
+*/
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+template <class Value, class Compare = std::less<Value>, std::size_t Arity = 4>
+struct DaryHeap {
+    static_assert(Arity >= 2);
+
+    struct HeapNode {
+        HeapNode() noexcept
+            : heap(nullptr),
+            index(0) {}
+
+        HeapNode(HeapNode&&) = delete;
+
+        ~HeapNode() noexcept {
+            if (heap) {
+                heap->doErase(this);
+            }
+        }
+
+        friend struct DaryHeap;
+
+    private:
+        DaryHeap* heap;
+        std::size_t index;
+    };
+
+private:
+    std::vector<HeapNode*> nodes;
+    Compare comp;
+
+    bool compare(HeapNode* left, HeapNode* right) const noexcept {
+        return comp(static_cast<Value&>(*left), static_cast<Value&>(*right));
+    }
+
+    void place(HeapNode* node, std::size_t index) noexcept {
+        nodes[index] = node;
+        node->index = index;
+    }
+
+    void siftUp(HeapNode* node, std::size_t index) noexcept {
+        while (index > 0) {
+            std::size_t parent = (index - 1) / Arity;
+            if (!compare(node, nodes[parent])) {
+                break;
+            }
+            place(nodes[parent], index);
+            index = parent;
+        }
+        place(node, index);
+    }
+
+    void siftDown(HeapNode* node, std::size_t index) noexcept {
+        std::size_t size = nodes.size();
+        for (;;) {
+            std::size_t first = index * Arity + 1;
+            if (first >= size) {
+                break;
+            }
+            std::size_t last = first + Arity < size ? first + Arity : size;
+            std::size_t best = first;
+            for (std::size_t child = first + 1; child < last; ++child) {
+                if (compare(nodes[child], nodes[best])) {
+                    best = child;
+                }
+            }
+            if (!compare(nodes[best], node)) {
+                break;
+            }
+            place(nodes[best], index);
+            index = best;
+        }
+        place(node, index);
+    }
+
+    void doInsert(HeapNode* node) {
+        node->heap = this;
+        nodes.push_back(node);
+        siftUp(node, nodes.size() - 1);
+    }
+
+    void doErase(HeapNode* node) noexcept {
+        std::size_t index = node->index;
+        HeapNode* last = nodes.back();
+        nodes.pop_back();
+        node->heap = nullptr;
+        if (last == node) {
+            return;
+        }
+        //һڵλܱȸڵСҲܱȺӴ
+        if (index > 0 && compare(last, nodes[(index - 1) / Arity])) {
+            siftUp(last, index);
+        }
+        else {
+            siftDown(last, index);
+        }
+    }
+
+public:
+    DaryHeap() noexcept {}
+
+    explicit DaryHeap(Compare comp) noexcept(noexcept(Compare(comp)))
+        : comp(comp) {}
+
+    DaryHeap(DaryHeap&&) = delete;
+
+    ~DaryHeap() noexcept {
+        for (HeapNode* node : nodes) {
+            node->heap = nullptr;
+        }
+    }
+
+    //ʱ׳std::bad_allocreserve()
+    void insert(Value& value) {
+        doInsert(&static_cast<HeapNode&>(value));
+    }
+
+    void erase(Value& value) noexcept {
+        doErase(&static_cast<HeapNode&>(value));
+    }
+
+    bool empty() const noexcept {
+        return nodes.empty();
+    }
+
+    std::size_t size() const noexcept {
+        return nodes.size();
+    }
+
+    void reserve(std::size_t n) {
+        nodes.reserve(n);
+    }
+
+    Value& front() const noexcept {
+        return static_cast<Value&>(*nodes.front());
+    }
+};
@@ -1,6 +1,13 @@
 #pragma once
 
-#ifndef NDEBUG
+// DEBUG_BINARY_LOG: debug() only memcpys its arguments and call site into a
+// per-thread lock-free ring buffer; a background thread formats them to
+// stderr and sleeps while the rings are empty. Meant to stay on in release
+// builds, so it ignores NDEBUG.
+// Records from one thread keep their order, records from different threads
+// may interleave. A full ring drops records and reports how many were lost.
+
+#if !defined(NDEBUG) || DEBUG_BINARY_LOG
 
 #include <cstdint>
 #include <iomanip>
@@ -17,10 +24,33 @@
 #if defined(__unix__) && __has_include(<cxxabi.h>)
 #include <cxxabi.h>
 #endif
+#if DEBUG_BINARY_LOG
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#endif
 
 struct debug {
 private:
+#if DEBUG_BINARY_LOG
+    static constexpr std::uint32_t record_capacity = 512;
+
+    std::optional<std::ostringstream> text;   // only for check()/fail(), whose message is thrown
+    alignas(8) unsigned char record[record_capacity];
+    std::uint32_t record_size;
+    bool truncated = false;
+#else
     std::ostringstream oss;
+#endif
 
     enum {
         silent = 0,
@@ -210,14 +240,15 @@ private:
         }
     }
 
-    debug& add_location_marks() {
-        char const* fn = loc.file_name();
+    static void uni_location(std::ostream& oss, char const* file,
+        std::uint_least32_t line_no, char const* line) {
+        char const* fn = file;
         for (char const* fp = fn; *fp; ++fp) {
             if (*fp == '/') {
                 fn = fp + 1;
             }
         }
-        oss << fn << ':' << loc.line() << ':' << '\t';
+        oss << fn << ':' << line_no << ':' << '\t';
         if (line) {
             oss << '[' << line << ']' << '\t';
         }
@@ -225,16 +256,16 @@ private:
 #if DEBUG_SHOW_SOURCE
             static thread_local std::unordered_map<std::string, std::string>
                 fileCache;
-            auto key = std::to_string(loc.line()) + loc.file_name();
+            auto key = std::to_string(line_no) + file;
             if (auto it = fileCache.find(key);
                 it != fileCache.end() && !it->second.empty()) [[likely]] {
                     oss << '[' << it->second << ']';
                 }
-            else if (auto file = std::ifstream(loc.file_name());
-                file.is_open()) [[likely]] {
+            else if (auto source = std::ifstream(file);
+                source.is_open()) [[likely]] {
                     std::string line;
-                    for (int i = 0; i < loc.line(); ++i) {
-                        if (!std::getline(file, line)) [[unlikely]] {
+                    for (std::uint_least32_t i = 0; i < line_no; ++i) {
+                        if (!std::getline(source, line)) [[unlikely]] {
                             line.clear();
                             break;
                             }
@@ -258,8 +289,369 @@ private:
 #endif
         }
         oss << ' ';
+    }
+
+#if DEBUG_BINARY_LOG
+    // the log thread formats into a plain string: an ostream per record
+    // costs more than everything the producer does
+    using arg_formatter = void (*)(std::string&, void const*, std::uint32_t);
+
+    // a record is a record_header followed by arg_header + payload pairs,
+    // everything padded to 8 bytes so records can be copied around as-is
+    struct record_header {
+        std::uint32_t size;   // 0 in the ring: skip to the ring's start
+        std::uint_least32_t line_no;
+        char const* file;
+        char const* line;
+        bool truncated;
+    };
+
+    struct arg_header {
+        arg_formatter format;
+        std::uint32_t size;
+    };
+
+    static constexpr std::uint32_t align8(std::size_t n) noexcept {
+        return static_cast<std::uint32_t>((n + 7) & ~std::size_t(7));
+    }
+
+    // integral types uni_format prints as numbers, not as bools or characters
+    template <class T>
+    static constexpr bool is_number = std::is_integral_v<T> &&
+        !std::is_same_v<T, bool> && !std::is_same_v<T, char> &&
+        !std::is_same_v<T, signed char> && !std::is_same_v<T, wchar_t> &&
+        !std::is_same_v<T, char8_t> && !std::is_same_v<T, char16_t> &&
+        !std::is_same_v<T, char32_t>;
+
+    // integers (fds, sizes, counters) are the common case and get the same
+    // text as uni_format without a stream; everything else goes through it
+    template <class T>
+    static void format_value(std::string& out, void const* p, std::uint32_t) {
+        T t;
+        std::memcpy(&t, p, sizeof(T));
+        if constexpr (is_number<T>) {
+            char buf[24];
+            if constexpr (std::is_signed_v<T>) {
+                out.append(buf, std::to_chars(buf, buf + sizeof(buf), t).ptr);
+            }
+            else {
+                char* end = std::to_chars(buf, buf + sizeof(buf), t, 16).ptr;
+                out += "0x";
+                out.append(sizeof(T) * 2 - static_cast<std::size_t>(end - buf), '0');
+                for (char* c = buf; c != end; ++c) {
+                    out += *c >= 'a' ? static_cast<char>(*c - 'a' + 'A') : *c;
+                }
+            }
+        }
+        else {
+            std::ostringstream tmp;
+            uni_format(tmp, t);
+            out += std::move(tmp).str();
+        }
+    }
+
+    template <bool quoted>
+    static void format_text(std::string& out, void const* p, std::uint32_t size) {
+        std::string_view sv(static_cast<char const*>(p), size);
+        if constexpr (quoted) {
+            for (char c : sv) {
+                if (static_cast<unsigned char>(c) < 0x20 || c == 0x7F ||
+                    c == '\\' || c == '"') {
+                    std::ostringstream tmp;
+                    uni_quotes(tmp, sv, '"');
+                    out += std::move(tmp).str();
+                    return;
+                }
+            }
+            out += '"';
+            out += sv;
+            out += '"';
+        }
+        else {
+            out += sv;
+        }
+    }
+
+    // prefix(out, header) appends the call site, the log thread caches it
+    template <class Prefix>
+    static void format_record(std::string& out, unsigned char const* p,
+        Prefix&& prefix) {
+        record_header h;
+        std::memcpy(&h, p, sizeof(h));
+        prefix(out, h);
+        for (std::uint32_t off = align8(sizeof(h)); off < h.size;) {
+            arg_header a;
+            std::memcpy(&a, p + off, sizeof(a));
+            if (off != align8(sizeof(h))) {
+                out += ' ';
+            }
+            a.format(out, p + off + align8(sizeof(a)), a.size);
+            off += align8(sizeof(a)) + align8(a.size);
+        }
+        if (h.truncated) {
+            out += " ...";
+        }
+    }
+
+    static void format_record(std::ostream& oss, unsigned char const* p) {
+        std::string out;
+        format_record(out, p, [](std::string& out, record_header const& h) {
+            std::ostringstream tmp;
+            uni_location(tmp, h.file, h.line_no, h.line);
+            out += std::move(tmp).str();
+        });
+        oss << out;
+    }
+
+    // single producer (the owning thread), single consumer (the log thread)
+    struct ring {
+        static constexpr std::size_t capacity = std::size_t(1) << 20;
+
+        std::unique_ptr<unsigned char[]> data{ new unsigned char[capacity] };
+        alignas(64) std::atomic<std::size_t> head{ 0 };
+        std::atomic<std::size_t> dropped{ 0 };
+        alignas(64) std::atomic<std::size_t> tail{ 0 };
+        std::atomic<bool> orphaned{ false };
+        std::size_t reported = 0;
+
+        void push(unsigned char const* rec, std::uint32_t size) noexcept {
+            std::size_t h = head.load(std::memory_order_relaxed);
+            std::size_t offset = h & (capacity - 1);
+            std::size_t contiguous = capacity - offset;
+            std::size_t need = contiguous < size ? contiguous + size : size;
+            if (h + need - tail.load(std::memory_order_acquire) > capacity) [[unlikely]] {
+                dropped.store(dropped.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+                return;
+            }
+            if (contiguous < size) {
+                std::uint32_t wrap = 0;
+                std::memcpy(data.get() + offset, &wrap, sizeof(wrap));
+                h += contiguous;
+                offset = 0;
+            }
+            std::memcpy(data.get() + offset, rec, size);
+            head.store(h + size, std::memory_order_release);
+        }
+
+        // returns whether there was anything to consume
+        template <class Format>
+        bool drain(std::string& out, Format&& format) {
+            std::size_t t = tail.load(std::memory_order_relaxed);
+            std::size_t h = head.load(std::memory_order_acquire);
+            bool any = t != h;
+            while (t != h) {
+                std::size_t offset = t & (capacity - 1);
+                std::uint32_t size;
+                std::memcpy(&size, data.get() + offset, sizeof(size));
+                if (size == 0) {
+                    t += capacity - offset;
+                    continue;
+                }
+                format(out, data.get() + offset);
+                out += '\n';
+                t += size;
+            }
+            tail.store(t, std::memory_order_release);
+            std::size_t d = dropped.load(std::memory_order_relaxed);
+            if (d != reported) [[unlikely]] {
+                out += "debug: ";
+                out += std::to_string(d - reported);
+                out += " records dropped\n";
+                reported = d;
+            }
+            return any;
+        }
+    };
+
+    struct binary_log {
+        std::mutex mutex;
+        std::vector<std::shared_ptr<ring>> rings;
+        std::atomic<bool> stopping{ false };
+        alignas(64) std::atomic<bool> idle{ false };   // read by every producer, written rarely
+        std::mutex wake_mutex;
+        std::condition_variable wake_cv;
+
+        // a call site is its file, line and source text pointers; its
+        // formatted location is built once, guarded by mutex like rings
+        struct site {
+            char const* file;
+            char const* line;
+            std::uint_least32_t line_no;
+
+            bool operator==(site const&) const = default;
+        };
+
+        struct site_hash {
+            std::size_t operator()(site const& s) const noexcept {
+                std::size_t h = std::hash<void const*>{}(s.file);
+                h = h * 31 + std::hash<void const*>{}(s.line);
+                return h * 31 + s.line_no;
+            }
+        };
+
+        std::unordered_map<site, std::string, site_hash> sites;
+        std::string output;   // drain()'s text, kept to reuse its capacity
+        std::thread worker{ [this] { run(); } };
+
+        ~binary_log() {
+            {
+                std::lock_guard lock(wake_mutex);
+                stopping.store(true, std::memory_order_relaxed);
+            }
+            wake_cv.notify_one();
+            worker.join();
+            drain();
+        }
+
+        static binary_log& instance() {
+            static binary_log log;
+            return log;
+        }
+
+        // registered by the thread's first debug(), drained one last time
+        // and released after the thread exits
+        struct ring_owner {
+            std::shared_ptr<ring> r = std::make_shared<ring>();
+
+            ring_owner() {
+                auto& log = instance();
+                std::lock_guard lock(log.mutex);
+                log.rings.push_back(r);
+            }
+
+            ~ring_owner() {
+                r->orphaned.store(true, std::memory_order_release);
+            }
+        };
+
+        static ring& local() {
+            thread_local ring_owner owner;
+            return *owner.r;
+        }
+
+        // called by producers after each push; a relaxed load unless the
+        // worker is asleep
+        static void notify() {
+            auto& log = instance();
+            if (log.idle.load(std::memory_order_relaxed) &&
+                log.idle.exchange(false, std::memory_order_relaxed)) [[unlikely]] {
+                std::lock_guard lock(log.wake_mutex);
+                log.wake_cv.notify_one();
+            }
+        }
+
+        void append_location(std::string& out, record_header const& h) {
+            auto [it, inserted] = sites.try_emplace(site{ h.file, h.line, h.line_no });
+            if (inserted) {
+                std::ostringstream tmp;
+                uni_location(tmp, h.file, h.line_no, h.line);
+                it->second = std::move(tmp).str();
+            }
+            out += it->second;
+        }
+
+        // only the worker drains, and the destructor after joining it
+        bool drain() {
+            std::string& out = output;
+            bool any = false;
+            {
+                std::lock_guard lock(mutex);
+                auto format = [this](std::string& out, unsigned char const* p) {
+                    format_record(out, p, [this](std::string& out, record_header const& h) {
+                        append_location(out, h);
+                    });
+                };
+                for (auto it = rings.begin(); it != rings.end();) {
+                    bool orphaned = (*it)->orphaned.load(std::memory_order_acquire);
+                    any |= (*it)->drain(out, format);
+                    it = orphaned ? rings.erase(it) : it + 1;
+                }
+            }
+            if (!out.empty()) {
+                std::cerr.write(out.data(), static_cast<std::streamsize>(out.size()));
+                std::cerr.flush();
+                out.clear();
+            }
+            return any;
+        }
+
+        // while records keep coming, drain once per millisecond so stderr
+        // sees batches; once a drain finds nothing, sleep until notify().
+        // A producer can miss idle being set, so the wait also times out
+        // and a record pushed in that window waits for the next round
+        void run() {
+            while (!stopping.load(std::memory_order_relaxed)) {
+                if (drain()) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    continue;
+                }
+                idle.store(true, std::memory_order_seq_cst);
+                if (!drain()) {
+                    std::unique_lock lock(wake_mutex);
+                    wake_cv.wait_for(lock, std::chrono::seconds(1), [this] {
+                        return !idle.load(std::memory_order_relaxed) ||
+                            stopping.load(std::memory_order_relaxed);
+                    });
+                }
+                idle.store(false, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    // strings are copied, arithmetic values memcpy'd; anything else may point
+    // into memory the caller owns, so it is formatted right away
+    void push_arg(arg_formatter format, void const* data, std::size_t size,
+        bool can_cut) noexcept {
+        if (truncated) [[unlikely]] {
+            return;
+        }
+        std::size_t room = record_capacity - record_size;
+        if (room < align8(sizeof(arg_header)) ||
+            (size > room - align8(sizeof(arg_header)) && !can_cut)) [[unlikely]] {
+            truncated = true;
+            return;
+        }
+        room -= align8(sizeof(arg_header));
+        if (size > room) [[unlikely]] {
+            size = room;
+            truncated = true;
+        }
+        arg_header a{ format, static_cast<std::uint32_t>(size) };
+        std::memcpy(record + record_size, &a, sizeof(a));
+        std::memcpy(record + record_size + align8(sizeof(a)), data, size);
+        record_size += align8(sizeof(a)) + align8(size);
+    }
+
+    template <class T0>
+    void push(T0&& t) {
+        using T = std::decay_t<T0>;
+        if constexpr (std::is_convertible_v<T, std::string_view>) {
+            std::string_view sv = t;
+            push_arg(std::is_same_v<T, char const*> ? &format_text<false>
+                : &format_text<true>, sv.data(), sv.size(), true);
+        }
+        else if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T>) {
+            push_arg(&format_value<T>, std::addressof(t), sizeof(T), false);
+        }
+        else {
+            std::ostringstream tmp;
+            uni_format(tmp, std::forward<T0>(t));
+            auto s = std::move(tmp).str();
+            push_arg(&format_text<false>, s.data(), s.size(), true);
+        }
+    }
+
+    void finish_record() noexcept {
+        record_header h{ record_size, loc.line(), loc.file_name(), line, truncated };
+        std::memcpy(record, &h, sizeof(h));
+    }
+#else
+    debug& add_location_marks() {
+        uni_location(oss, loc.file_name(), loc.line(), line);
         return *this;
     }
+#endif
 
     template <class T>
     struct debug_condition {
@@ -309,6 +701,44 @@ private:
         }
     };
 
+#if DEBUG_BINARY_LOG
+    debug& on_error(char const* msg) {
+        if (state == supress) {
+            return *this;
+        }
+        if (state == panic) {
+            *text << ' ';
+        }
+        else {
+            text.emplace();
+            if (state == print) {
+                finish_record();
+                format_record(*text, record);
+                *text << ' ';
+            }
+            else {
+                uni_location(*text, loc.file_name(), loc.line(), line);
+            }
+            state = panic;
+        }
+        *text << msg;
+        return *this;
+    }
+
+    template <class T>
+    debug& on_print(T&& t) {
+        if (state == supress)
+            return *this;
+        if (state == panic) [[unlikely]] {
+            *text << ' ';
+            uni_format(*text, std::forward<T>(t));
+            return *this;
+        }
+        state = print;
+        push(std::forward<T>(t));
+        return *this;
+    }
+#else
     debug& on_error(char const* msg) {
         if (state != supress) {
             state = panic;
@@ -335,12 +765,17 @@ private:
         uni_format(oss, std::forward<T>(t));
         return *this;
     }
+#endif
 
 public:
     debug(bool enable = true, char const* line = nullptr,
         std::source_location const& loc =
         std::source_location::current()) noexcept
-        : state(enable ? silent : supress),
+        :
+#if DEBUG_BINARY_LOG
+        record_size(align8(sizeof(record_header))),
+#endif
+        state(enable ? silent : supress),
         line(line),
         loc(loc) {}
 
@@ -384,6 +819,18 @@ public:
         return on_print(std::forward<T>(t));
     }
 
+#if DEBUG_BINARY_LOG
+    ~debug() noexcept(false) {
+        if (state == panic) [[unlikely]] {
+            throw std::runtime_error(text->str());
+        }
+        if (state == print) {
+            finish_record();
+            binary_log::local().push(record, record_size);
+            binary_log::notify();
+        }
+    }
+#else
     ~debug() noexcept(false) {
         if (state == panic) [[unlikely]] {
             throw std::runtime_error(oss.str());
@@ -393,6 +840,7 @@ public:
                 std::cerr << oss.str();
             }
     }
+#endif
 };
 
 #else
@@ -0,0 +1,140 @@
+/****************************************************************************
+*
+* DaryHeapRbTreeΪʱܶԱ
+*
+* ÿÿģnֲ
+* 1insertnʱĶʱ
+* 2expireȡĶʱµĵʱȥظnΣ൱ԵĶʱ
+* 3cancel˳eraseжʱ൱ڶʱڵ֮ǰȡ
+* ģСʱظ֣ÿֲִܹдԼ1000
+*
+* ÷heap_bench [n...]Ĭ 1000 100000 10000000
+*  -DCMAKE_BUILD_TYPE=Release 
+*
+*****************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+#include "dary_heap.hpp"
+#include "rbtree.hpp"
+
+
+struct RbTimer : RbTree<RbTimer>::RbNode
+{
+    std::uint64_t mExpireTime = 0;
+
+    friend bool operator<(RbTimer const& lhs, RbTimer const& rhs) noexcept
+    {
+        return lhs.mExpireTime < rhs.mExpireTime;
+    }
+};
+
+struct BinaryHeapTimer : DaryHeap<BinaryHeapTimer, std::less<BinaryHeapTimer>, 2>::HeapNode
+{
+    std::uint64_t mExpireTime = 0;
+
+    friend bool operator<(BinaryHeapTimer const& lhs, BinaryHeapTimer const& rhs) noexcept
+    {
+        return lhs.mExpireTime < rhs.mExpireTime;
+    }
+};
+
+struct HeapTimer : DaryHeap<HeapTimer>::HeapNode
+{
+    std::uint64_t mExpireTime = 0;
+
+    friend bool operator<(HeapTimer const& lhs, HeapTimer const& rhs) noexcept
+    {
+        return lhs.mExpireTime < rhs.mExpireTime;
+    }
+};
+
+struct Result
+{
+    double insert = 0;
+    double expire = 0;
+    double cancel = 0;
+};
+
+template <class Container, class Timer>
+Result run(std::size_t n)
+{
+    constexpr std::size_t kTotalOps = 10000000;
+    std::size_t rounds = std::max<std::size_t>(1, kTotalOps / n);
+
+    std::mt19937_64 rng{ 42 };
+    std::uniform_int_distribution<std::uint64_t> delay{ 0, 1000000 };
+    std::unique_ptr<Timer[]> timers(new Timer[n]);
+    std::vector<std::size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+
+    using Clock = std::chrono::steady_clock;
+    Clock::duration insertTime{}, expireTime{}, cancelTime{};
+
+    for (std::size_t round = 0; round < rounds; ++round)
+    {
+        Container container;
+        for (std::size_t i = 0; i < n; ++i)
+            timers[i].mExpireTime = delay(rng);
+
+        auto start = Clock::now();
+        for (std::size_t i = 0; i < n; ++i)
+            container.insert(timers[i]);
+        insertTime += Clock::now() - start;
+
+        start = Clock::now();
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            auto& timer = container.front();
+            container.erase(timer);
+            timer.mExpireTime += delay(rng);
+            container.insert(timer);
+        }
+        expireTime += Clock::now() - start;
+
+        std::shuffle(order.begin(), order.end(), rng);
+        start = Clock::now();
+        for (std::size_t i : order)
+            container.erase(timers[i]);
+        cancelTime += Clock::now() - start;
+    }
+
+    auto perOp = [&](Clock::duration d) {
+        return std::chrono::duration<double, std::nano>(d).count() / double(n * rounds);
+    };
+    return Result{ perOp(insertTime), perOp(expireTime), perOp(cancelTime) };
+}
+
+void print(const char* name, std::size_t n, std::size_t nodeSize, Result const& r)
+{
+    std::cout << name << " n=" << n
+        << " insert=" << r.insert << "ns"
+        << " expire=" << r.expire << "ns"
+        << " cancel=" << r.cancel << "ns"
+        << " node=" << nodeSize << "B" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::size_t> sizes;
+    for (int i = 1; i < argc; ++i)
+        sizes.push_back(std::strtoull(argv[i], nullptr, 10));
+    if (sizes.empty())
+        sizes = { 1000, 100000, 10000000 };
+
+    for (std::size_t n : sizes)
+    {
+        //ѵÿڵﻹҪռһָ
+        print("RbTree      ", n, sizeof(RbTimer), run<RbTree<RbTimer>, RbTimer>(n));
+        print("DaryHeap<2> ", n, sizeof(BinaryHeapTimer) + sizeof(void*),
+            run<DaryHeap<BinaryHeapTimer, std::less<BinaryHeapTimer>, 2>, BinaryHeapTimer>(n));
+        print("DaryHeap<4> ", n, sizeof(HeapTimer) + sizeof(void*), run<DaryHeap<HeapTimer>, HeapTimer>(n));
+    }
+}
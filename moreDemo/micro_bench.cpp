@@ -0,0 +1,284 @@
+/****************************************************************************
+*
+* Э̻΢׼ԣstep7_demo.cppĿ
+*
+* 1task create+destroyһTask<int>ֱ٣ָֻЭ֡ķͷţ
+* 2co_await taskco_awaitһco_returnTask<int>Э̵ζԳתƺ٣
+* 3PreviousAwaiter transferЭ̻co_await PreviousAwaiterÿβһζԳתƣûз䣻
+* 4when_all(a, b) / when_all(range)汾range汾ÿβһwhen_allfan-outɲָ
+* 5Uninitialized<string>putValue+moveValueһSSOstd::stringԼco_awaitһTask
+* 6generator co_yieldeasyDemo/generator.hppÿβһco_yield+ָǶװ汾ͨelements_of8
+*
+* ÿһظ5ȡһ֣ ns/opcycles/op  allocs/op
+* ns/opsteady_clockcycles/oprdtscx86ƽ̨"-"rdtsc̶ƵʼƵ޹أ
+* allocs/opͨ滻ȫoperator newͳƣЭ֡when_allhelperͽᱻȥ
+*
+* ÷micro_bench [iterations] [fan_out]Ĭ 1000000 16
+*  -DCMAKE_BUILD_TYPE=Release 
+*
+*****************************************************************************/
+
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define MICRO_BENCH_HAS_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define MICRO_BENCH_HAS_RDTSC 1
+#else
+#define MICRO_BENCH_HAS_RDTSC 0
+#endif
+
+//step7_demo.cppֱдcppصmain֮
+#define STEP7_NO_MAIN
+#include "step7_demo.cpp"
+#include "generator.hpp"
+
+
+//ֻ߳ϲԣҪԭӱ
+static std::size_t gAllocations = 0;
+
+void* operator new(std::size_t size)
+{
+    ++gAllocations;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+//ñܰѼŻ
+static volatile std::size_t gSink = 0;
+
+std::uint64_t readCycles()
+{
+#if MICRO_BENCH_HAS_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+struct Sample
+{
+    double ns = 0;
+    double cycles = 0;
+    double allocs = 0;
+};
+
+//body(ops)ִopsβѭbody棬ÿβһμӵ
+template <class F>
+Sample measure(std::size_t ops, F&& body)
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr int kRounds = 5;
+
+    Sample best;
+    for (int round = 0; round < kRounds; ++round)
+    {
+        std::size_t allocations = gAllocations;
+        std::uint64_t cycles = readCycles();
+        auto start = Clock::now();
+        body(ops);
+        auto elapsed = Clock::now() - start;
+        cycles = readCycles() - cycles;
+        allocations = gAllocations - allocations;
+
+        Sample sample;
+        sample.ns = std::chrono::duration<double, std::nano>(elapsed).count() / double(ops);
+        sample.cycles = double(cycles) / double(ops);
+        sample.allocs = double(allocations) / double(ops);
+        if (round == 0 || sample.ns < best.ns)
+            best = sample;
+    }
+    return best;
+}
+
+void print(const char* name, Sample const& s)
+{
+    std::cout << std::left << std::setw(32) << name << std::right << std::fixed
+        << std::setprecision(2) << std::setw(10) << s.ns;
+    if (MICRO_BENCH_HAS_RDTSC)
+        std::cout << std::setprecision(1) << std::setw(12) << s.cycles;
+    else
+        std::cout << std::setw(12) << "-";
+    std::cout << std::setprecision(2) << std::setw(12) << s.allocs << std::endl;
+}
+
+//mainһTaskеЭ̶¼ѭ
+template <class T>
+T runTask(Task<T> const& t)
+{
+    t.mCoroutine.resume();
+    return t.mCoroutine.promise().result();
+}
+
+
+Task<int> leaf(int i)
+{
+    co_return i;
+}
+
+Task<std::size_t> awaitLoop(std::size_t ops)
+{
+    std::size_t sum = 0;
+    for (std::size_t i = 0; i < ops; ++i)
+        sum += co_await leaf(int(i));
+    co_return sum;
+}
+
+//ÿco_awaitPreviousAwaiterֱлԷصmain
+Task<> pingPong(std::coroutine_handle<> const& peer, std::size_t ops)
+{
+    for (std::size_t i = 0; i < ops; ++i)
+        co_await PreviousAwaiter(peer);
+}
+
+Task<std::size_t> whenAllPackLoop(std::size_t ops)
+{
+    std::size_t sum = 0;
+    for (std::size_t i = 0; i < ops; ++i)
+    {
+        auto [a, b] = co_await when_all(leaf(1), leaf(2));
+        sum += std::size_t(a + b);
+    }
+    co_return sum;
+}
+
+Task<std::size_t> whenAllRangeLoop(std::size_t ops, std::size_t fanOut)
+{
+    std::size_t sum = 0;
+    std::vector<Task<int>> tasks;
+    tasks.reserve(fanOut);
+    for (std::size_t i = 0; i < ops; ++i)
+    {
+        tasks.clear();
+        for (std::size_t j = 0; j < fanOut; ++j)
+            tasks.push_back(leaf(int(j)));
+        auto results = co_await when_all(tasks);
+        sum += results.size();
+    }
+    co_return sum;
+}
+
+Task<std::string> passString(std::string& s)
+{
+    co_return std::move(s);
+}
+
+Task<std::size_t> stringLoop(std::size_t ops)
+{
+    std::string s(64, 'x');
+    std::size_t sum = 0;
+    for (std::size_t i = 0; i < ops; ++i)
+    {
+        s = co_await passString(s);
+        sum += s.size();
+    }
+    co_return sum;
+}
+
+generator<int> counter(std::size_t ops)
+{
+    for (std::size_t i = 0; i < ops; ++i)
+        co_yield int(i);
+}
+
+generator<int> nested(std::size_t ops, int depth)
+{
+    if (depth == 0)
+        co_yield elements_of(counter(ops));
+    else
+        co_yield elements_of(nested(ops, depth - 1));
+}
+
+
+int main(int argc, char* argv[])
+{
+    std::size_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    std::size_t fanOut = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 16;
+    iterations = std::max<std::size_t>(iterations, 1);
+    fanOut = std::max<std::size_t>(fanOut, 1);
+
+    std::cout << std::left << std::setw(32) << "benchmark" << std::right
+        << std::setw(10) << "ns/op" << std::setw(12) << "cycles/op" << std::setw(12) << "allocs/op" << std::endl;
+
+    print("task create+destroy", measure(iterations, [](std::size_t ops) {
+        for (std::size_t i = 0; i < ops; ++i)
+        {
+            auto t = leaf(int(i));
+            gSink = std::size_t(bool(t.mCoroutine));
+        }
+    }));
+
+    print("co_await task", measure(iterations, [](std::size_t ops) {
+        auto t = awaitLoop(ops);
+        gSink = runTask(t);
+    }));
+
+    //aеbbлaһ2*opsת
+    print("PreviousAwaiter transfer", measure(2 * iterations, [](std::size_t ops) {
+        std::coroutine_handle<> ha, hb;
+        auto a = pingPong(hb, ops / 2);
+        auto b = pingPong(ha, std::size_t(-1));
+        ha = a.mCoroutine;
+        hb = b.mCoroutine;
+        runTask(a);
+    }));
+
+    print("when_all(a, b)", measure(iterations, [](std::size_t ops) {
+        auto t = whenAllPackLoop(ops);
+        gSink = runTask(t);
+    }));
+
+    //ÿwhen_allfanOutЭ̣ܵЭ
+    std::string rangeName = "when_all(range of " + std::to_string(fanOut) + ")";
+    print(rangeName.c_str(), measure(std::max<std::size_t>(iterations / fanOut, 1), [fanOut](std::size_t ops) {
+        auto t = whenAllRangeLoop(ops, fanOut);
+        gSink = runTask(t);
+    }));
+
+    print("Uninitialized<string> put+move", measure(iterations, [](std::size_t ops) {
+        Uninitialized<std::string> slot;
+        std::string s(64, 'x');
+        for (std::size_t i = 0; i < ops; ++i)
+        {
+            slot.putValue(std::move(s));
+            s = slot.moveValue();
+        }
+        gSink = s.size();
+    }));
+
+    print("co_await Task<string>", measure(iterations, [](std::size_t ops) {
+        auto t = stringLoop(ops);
+        gSink = runTask(t);
+    }));
+
+    print("generator co_yield", measure(iterations, [](std::size_t ops) {
+        std::size_t sum = 0;
+        for (int v : counter(ops))
+            sum += std::size_t(v);
+        gSink = sum;
+    }));
+
+    print("generator co_yield (nested x8)", measure(iterations, [](std::size_t ops) {
+        std::size_t sum = 0;
+        for (int v : nested(ops, 8))
+            sum += std::size_t(v);
+        gSink = sum;
+    }));
+}
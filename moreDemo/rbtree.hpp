@@ -227,68 +227,132 @@ private:
     /*     } */
     /* } */
 
+    void transplant(RbNode* node, RbNode* child) noexcept {
+        if (node->parent == nullptr) {
+            root = child;
+        }
+        else if (node == node->parent->left) {
+            node->parent->left = child;
+        }
+        else {
+            node->parent->right = child;
+        }
+        if (child != nullptr) {
+            child->parent = node->parent;
+        }
+    }
+
     void doErase(RbNode* current) noexcept {
         current->tree = nullptr;
 
-        RbNode* node = nullptr;
         RbNode* child = nullptr;
-        RbColor color = RED;
+        RbNode* parent = nullptr;
+        RbColor color = current->color;
 
-        if (current->left != nullptr && current->right != nullptr) {
-            RbNode* replace = current;
-            replace = replace->right;
+        if (current->left == nullptr) {
+            child = current->right;
+            parent = current->parent;
+            transplant(current, current->right);
+        }
+        else if (current->right == nullptr) {
+            child = current->left;
+            parent = current->parent;
+            transplant(current, current->left);
+        }
+        else {
+            RbNode* replace = current->right;
             while (replace->left != nullptr) {
                 replace = replace->left;
             }
+            color = replace->color;
+            child = replace->right;
 
-            if (current != replace->parent) {
-                current->parent->left = replace->right;
-                replace->right = current->right;
-                current->right->parent = replace;
-            }
-            else {
-                replace->parent = current;
-            }
-
-            if (current == root) {
-                root = replace;
-            }
-            else if (current->parent->left == current) {
-                current->parent->left = replace;
+            if (replace->parent == current) {
+                parent = replace;
             }
             else {
-                current->parent->right = replace;
+                parent = replace->parent;
+                transplant(replace, replace->right);
+                replace->right = current->right;
+                replace->right->parent = replace;
             }
 
+            transplant(current, replace);
             replace->left = current->left;
-            current->left->parent = replace;
-
-            node = replace;
-            color = node->color;
-            child = node->right;
-        }
-        else {
-            node = current;
-            color = node->color;
-            child = (node->left != nullptr) ? node->left : node->right;
+            replace->left->parent = replace;
+            replace->color = current->color;
         }
 
-        if (child != nullptr) {
-            child->parent = node->parent;
+        if (color == BLACK) {
+            fixErase(child, parent);
         }
+    }
 
-        if (node == root) {
-            root = child;
-        }
-        else if (node->parent->left == node) {
-            node->parent->left = child;
-        }
-        else {
-            node->parent->right = child;
+    void fixErase(RbNode* node, RbNode* parent) noexcept {
+        while (node != root && (node == nullptr || node->color == BLACK)) {
+            if (node == parent->left) {
+                RbNode* sibling = parent->right;
+                if (sibling->color == RED) {
+                    sibling->color = BLACK;
+                    parent->color = RED;
+                    rotateLeft(parent);
+                    sibling = parent->right;
+                }
+                if ((sibling->left == nullptr || sibling->left->color == BLACK) &&
+                    (sibling->right == nullptr || sibling->right->color == BLACK)) {
+                    sibling->color = RED;
+                    node = parent;
+                    parent = node->parent;
+                }
+                else {
+                    if (sibling->right == nullptr || sibling->right->color == BLACK) {
+                        sibling->left->color = BLACK;
+                        sibling->color = RED;
+                        rotateRight(sibling);
+                        sibling = parent->right;
+                    }
+                    sibling->color = parent->color;
+                    parent->color = BLACK;
+                    if (sibling->right != nullptr) {
+                        sibling->right->color = BLACK;
+                    }
+                    rotateLeft(parent);
+                    node = root;
+                }
+            }
+            else {
+                RbNode* sibling = parent->left;
+                if (sibling->color == RED) {
+                    sibling->color = BLACK;
+                    parent->color = RED;
+                    rotateRight(parent);
+                    sibling = parent->left;
+                }
+                if ((sibling->left == nullptr || sibling->left->color == BLACK) &&
+                    (sibling->right == nullptr || sibling->right->color == BLACK)) {
+                    sibling->color = RED;
+                    node = parent;
+                    parent = node->parent;
+                }
+                else {
+                    if (sibling->left == nullptr || sibling->left->color == BLACK) {
+                        sibling->right->color = BLACK;
+                        sibling->color = RED;
+                        rotateLeft(sibling);
+                        sibling = parent->left;
+                    }
+                    sibling->color = parent->color;
+                    parent->color = BLACK;
+                    if (sibling->left != nullptr) {
+                        sibling->left->color = BLACK;
+                    }
+                    rotateRight(parent);
+                    node = root;
+                }
+            }
         }
-
-        if (color == BLACK && root) {
-            fixViolation(child ? child : node->parent);
+        if (node != nullptr) {
+            node->color = BLACK;
         }
     }
 
@@ -13,15 +13,30 @@
 * 
 **************************************************************************/
 
+#include <atomic>
 #include <chrono>
 #include <coroutine>
+#include <cstddef>
 #include <deque>
+#include <new>
+#include <optional>
 #include <queue>
+#include <ranges>
 #include <span>
+#include <stop_token>
+#include <stdexcept>
 #include <thread>
+#include <utility>
 #include <variant>
+#include <vector>
 #include "rbtree.hpp"
 #include "debug.hpp"
+#if CORO_PROFILE
+#include <fstream>
+#include <iostream>
+#include <source_location>
+#include "coro_profile.hpp"
+#endif
 
 /*Ϊʹ1s2sʱ*/
 using namespace std::chrono_literals;
@@ -169,6 +184,33 @@ struct PreviousAwaiter {
 */
 template <class T> 
 struct Promise {
+#if CORO_PROFILE
+    //CORO_PROFILEʱЭ̺ͳʱ͹ʱcoro_profile.hppٶCORO_TRACEʱ¼ʱ
+    //ĬϲЭֵ̺õЭ̺λ
+    Promise(std::source_location const& loc = std::source_location::current())
+        : mProfile(loc, &mPrevious) {}
+
+    static void* operator new(std::size_t size) {
+        coro_profile::noteFrameSize(size);
+        return ::operator new(size);
+    }
+
+    template <class Expr>
+    auto await_transform(Expr&& expr) {
+        return coro_profile::profileAwait(std::forward<Expr>(expr), mProfile);
+    }
+
+    coro_profile::ProfiledAwaiter<std::suspend_always> initial_suspend() noexcept {
+        return { {}, mProfile };
+    }
+
+    auto final_suspend() noexcept {
+        mProfile.onFinal();
+        return PreviousAwaiter(mPrevious);
+    }
+
+    coro_profile::FrameProfile mProfile;
+#else
     auto initial_suspend() noexcept {
         return std::suspend_always();
     }
@@ -176,6 +218,7 @@ struct Promise {
     auto final_suspend() noexcept {
         return PreviousAwaiter(mPrevious);
     }
+#endif
 
     void unhandled_exception() noexcept {
         mException = std::current_exception();
@@ -202,6 +245,7 @@ struct Promise {
 
     std::coroutine_handle<> mPrevious{};
     std::exception_ptr mException{};
+    std::stop_token mStopToken{};   //co_awaitЭ̵ʱӸЭ̼̳йwhen_anyȡûɵķ֧
     Uninitialized<T> mResult;
 
     Promise& operator=(Promise&&) = delete;
@@ -212,6 +256,31 @@ struct Promise {
 */
 template <> 
 struct Promise<void> {
+#if CORO_PROFILE
+    Promise(std::source_location const& loc = std::source_location::current())
+        : mProfile(loc, &mPrevious) {}
+
+    static void* operator new(std::size_t size) {
+        coro_profile::noteFrameSize(size);
+        return ::operator new(size);
+    }
+
+    template <class Expr>
+    auto await_transform(Expr&& expr) {
+        return coro_profile::profileAwait(std::forward<Expr>(expr), mProfile);
+    }
+
+    coro_profile::ProfiledAwaiter<std::suspend_always> initial_suspend() noexcept {
+        return { {}, mProfile };
+    }
+
+    auto final_suspend() noexcept {
+        mProfile.onFinal();
+        return PreviousAwaiter(mPrevious);
+    }
+
+    coro_profile::FrameProfile mProfile;
+#else
     auto initial_suspend() noexcept {
         return std::suspend_always();
     }
@@ -219,6 +288,7 @@ struct Promise<void> {
     auto final_suspend() noexcept {
         return PreviousAwaiter(mPrevious);
     }
+#endif
 
     void unhandled_exception() noexcept {
         mException = std::current_exception();
@@ -238,6 +308,7 @@ struct Promise<void> {
 
     std::coroutine_handle<> mPrevious{};
     std::exception_ptr mException{};
+    std::stop_token mStopToken{};
 
     Promise& operator=(Promise&&) = delete;
 };
@@ -255,10 +326,15 @@ struct Task {
     Task(std::coroutine_handle<promise_type> coroutine) noexcept
         : mCoroutine(coroutine) {}
 
-    Task(Task&&) = delete;
+    //ƶܷŽstd::vectorｻwhen_all/when_anyrange汾
+    Task(Task&& that) noexcept
+        : mCoroutine(std::exchange(that.mCoroutine, nullptr)) {}
+
+    Task& operator=(Task&&) = delete;
 
     ~Task() {
-        mCoroutine.destroy();
+        if (mCoroutine)
+            mCoroutine.destroy();
     }
 
     struct Awaiter {
@@ -266,8 +342,12 @@ struct Task {
             return false;
         }
 
+        //ȡco_await´ȴЭ̼̳еȴmStopToken
+        template <class CallerPromise>
         std::coroutine_handle<promise_type>
-            await_suspend(std::coroutine_handle<> coroutine) const noexcept {
+            await_suspend(std::coroutine_handle<CallerPromise> coroutine) const noexcept {
+            if constexpr (requires { coroutine.promise().mStopToken; })
+                mCoroutine.promise().mStopToken = coroutine.promise().mStopToken;
             mCoroutine.promise().mPrevious = coroutine;
             return mCoroutine;
         }
@@ -300,6 +380,12 @@ struct Task {
 struct SleepUntilPromise : RbTree<SleepUntilPromise>::RbNode, Promise<void> 
 {
     std::chrono::system_clock::time_point mExpireTime;
+    bool mCancelled = false;
+
+#if CORO_PROFILE
+    SleepUntilPromise(std::source_location const& loc = std::source_location::current())
+        : Promise<void>(loc) {}
+#endif
 
     auto get_return_object() {
         return std::coroutine_handle<SleepUntilPromise>::from_promise(*this);
@@ -355,8 +441,19 @@ Loop& getLoop() {
     return loop;
 }
 
+/*
+* ȴȡʱco_await׳쳣Э쳣·˳
+*
+*/
+struct OperationCancelled : std::exception {
+    const char* what() const noexcept override {
+        return "operation cancelled";
+    }
+};
+
 /*
 * AwaiterͣЭ̼뵽¼ѭУԱʱ䵽֮¼ѭԻָЭ̵ִ
+* Э̵mStopTokenյȡ󣬶ʱڣco_await׳OperationCancelled
 *
 */
 struct SleepAwaiter {
@@ -364,16 +461,38 @@ struct SleepAwaiter {
         return false;
     }
 
-    void await_suspend(std::coroutine_handle<SleepUntilPromise> coroutine) const {
+    void await_suspend(std::coroutine_handle<SleepUntilPromise> coroutine) {
         auto& promise = coroutine.promise();
+        mPromise = &promise;
         promise.mExpireTime = mExpireTime;
         loop.addTimer(promise);   //뵽ʱ¼ѭеĲstd::coroutine_handleˣpromise
+
+        //յȡʱѶʱĳڣ¼ѭָrequest_stop()ĵջֱӻָ
+        //Ѿȡstop_callbackĹ캯ͻֱӵ
+        mCancel.emplace(promise.mStopToken, CancelSleep{ loop, promise });
     }
 
-    void await_resume() const noexcept {}
+    void await_resume() const {
+        if (mPromise->mCancelled)
+            throw OperationCancelled();
+    }
+
+    struct CancelSleep {
+        Loop& loop;
+        SleepUntilPromise& promise;
+
+        void operator()() const noexcept {
+            loop.mRbTimer.erase(promise);
+            promise.mCancelled = true;
+            promise.mExpireTime = std::chrono::system_clock::time_point::min();
+            loop.addTimer(promise);
+        }
+    };
 
     Loop& loop;
     std::chrono::system_clock::time_point mExpireTime;
+    SleepUntilPromise* mPromise = nullptr;
+    std::optional<std::stop_callback<CancelSleep>> mCancel{};
 };
 
 /*
@@ -416,6 +535,28 @@ struct CurrentCoroutineAwaiter {
     std::coroutine_handle<> mCurrent;
 };
 
+/*
+* ȡõǰЭ̵mStopToken
+*
+*/
+struct CurrentStopTokenAwaiter {
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    template <class P>
+    bool await_suspend(std::coroutine_handle<P> coroutine) noexcept {
+        mToken = coroutine.promise().mStopToken;
+        return false;
+    }
+
+    std::stop_token await_resume() const noexcept {
+        return mToken;
+    }
+
+    std::stop_token mToken;
+};
+
 /*
 * promise_typeͣʹpromise_typeЭ̻Эָ֮̽ǰһЭ̵ִ
 *
@@ -443,6 +584,7 @@ struct ReturnPreviousPromise {
     }
 
     std::coroutine_handle<> mPrevious{};
+    std::stop_token mStopToken{};   //whenAll/whenAnyڴhelper֮
 
     ReturnPreviousPromise& operator=(ReturnPreviousPromise&&) = delete;
 };
@@ -473,7 +615,8 @@ struct ReturnPreviousTask {
 struct WhenAllCtlBlock {
     std::size_t mCount;
     std::coroutine_handle<> mPrevious{};
-    std::exception_ptr mException{};
+    std::exception_ptr mException{};        //һ쳣
+    std::stop_source mStop{};               //Э׳쳣ʱȡЭ
 };
 
 /*
@@ -515,11 +658,13 @@ ReturnPreviousTask whenAllHelper(auto const& t, WhenAllCtlBlock& control,
         result.putValue(co_await t);
     }
     catch (...) {
-        control.mException = std::current_exception();
-        co_return control.mPrevious;
+        if (!control.mException) {
+            control.mException = std::current_exception();
+            control.mStop.request_stop();
+        }
     }
-    --control.mCount;
-    if (control.mCount == 0) {
+    //쳣ҲҪЭ̶whenAll֮Эָ̻Ѿͷŵhelper
+    if (--control.mCount == 0) {
         co_return control.mPrevious;
     }
     co_return nullptr;
@@ -535,6 +680,9 @@ whenAllImpl(std::index_sequence<Is...>, Ts &&...ts) {
     WhenAllCtlBlock control{ sizeof...(Ts) };
     std::tuple<Uninitialized<typename AwaitableTraits<Ts>::RetType>...> result;
     ReturnPreviousTask taskArray[]{ whenAllHelper(ts, control, std::get<Is>(result))... };
+    for (auto const& t : taskArray)
+        t.mCoroutine.promise().mStopToken = control.mStop.get_token();
+    std::stop_callback forward(co_await CurrentStopTokenAwaiter(), [&control] { control.mStop.request_stop(); });  //whenAllȡʱЭһȡ
     co_await WhenAllAwaiter(control, taskArray);
     co_return std::tuple<typename AwaitableTraits<Ts>::NonVoidRetType...>(
         std::get<Is>(result).moveValue()...);
@@ -548,13 +696,28 @@ auto when_all(Ts &&...ts) {
 }
 
 /*
-* whenanyʹõĿƿ
+* whenanyʹõĿƿ飨汾range汾ã
+*
+* ɵЭ̼Լ±꣬ȻȡЭ̣
+* whenAnyҪЭ̶ȡЭ쳣·˳֮Żָ
+* ֮󲻻ỹжʱI/OѾͷŵhelper
+* mCountЭ̸1һڷ𷽣WhenRangeAwaiter
 *
 */
 struct WhenAnyCtlBlock {
     static constexpr std::size_t kNullIndex = std::size_t(-1);
 
-    std::size_t mIndex{ kNullIndex };
+    bool tryWin(std::size_t index) noexcept {
+        std::size_t expected = kNullIndex;
+        if (!mIndex.compare_exchange_strong(expected, index, std::memory_order_acq_rel))
+            return false;
+        mStop.request_stop();
+        return true;
+    }
+
+    std::atomic<std::size_t> mIndex{ kNullIndex };
+    std::atomic<std::size_t> mCount{ 0 };   //ûЭ̸ + 1𷽣
+    std::stop_source mStop{};               //ȡûɵЭ
     std::coroutine_handle<> mPrevious{};
     std::exception_ptr mException{};
 };
@@ -572,11 +735,13 @@ struct WhenAnyAwaiter {
         await_suspend(std::coroutine_handle<> coroutine) const {   //coroutineҪЭ
         if (mTasks.empty()) return coroutine;
 
-        mControl.mPrevious = coroutine;  //¼ǰһЭ̣ʹͬһWhenAnyCtlBlockƿЭӵйͬpreviousЭ̣whenAnyImplЭ̾ͻֱӻָwhenAnyImplִ
-        for (auto const& t : mTasks.subspan(0, mTasks.size() - 1))
+        mControl.mPrevious = coroutine;  //¼ǰһЭ̣ʹͬһWhenAnyCtlBlockƿЭӵйͬpreviousЭ̣whenAnyImplЭָ̻whenAnyImplִ
+        for (auto const& t : mTasks)
             t.mCoroutine.resume();       //ֱӻָÿһЭ̵ִ
 
-        return mTasks.back().mCoroutine; //һЭִָ̻
+        if (mControl.mCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            return coroutine;            //ЭĹоͶ
+        return std::noop_coroutine();
     }
 
     void await_resume() const {
@@ -597,14 +762,18 @@ template <class T>
 ReturnPreviousTask whenAnyHelper(auto const& t, WhenAnyCtlBlock& control,
     Uninitialized<T>& result, std::size_t index) {
     try {
-        result.putValue(co_await t);   //tʵhello1hello2ӦЭ
+        auto&& value = co_await t;   //tʵhello1hello2ӦЭ
+        if (control.tryWin(index))   //ֻɵЭ̱
+            result.putValue(std::forward<decltype(value)>(value));
     }
     catch (...) {
-        control.mException = std::current_exception();
-        co_return control.mPrevious;
+        //ȡЭ̻׳OperationCancelledЭ̵쳣
+        if (control.tryWin(index))
+            control.mException = std::current_exception();
     }
-    --control.mIndex = index;    //ɵЭ̵
-    co_return control.mPrevious; //ָǰһЭ̵ִ
+    if (control.mCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        co_return control.mPrevious; //һЭָ̻whenAnyImpl
+    co_return nullptr;
 }
 
 /*
@@ -617,6 +786,10 @@ whenAnyImpl(std::index_sequence<Is...>, Ts &&...ts) {
     WhenAnyCtlBlock control{};             //ƿ
     std::tuple<Uninitialized<typename AwaitableTraits<Ts>::RetType>...> result;                 //3Э̵Ľʹtuple
     ReturnPreviousTask taskArray[]{ whenAnyHelper(ts, control, std::get<Is>(result), Is)... };  //Э飬whenAnyHelperҲЭ̣ÿЭ̵Ľ洢std::get<Is>(result)УIs±
+    for (auto const& t : taskArray)
+        t.mCoroutine.promise().mStopToken = control.mStop.get_token();
+    control.mCount.store(sizeof...(Ts) + 1, std::memory_order_relaxed);
+    std::stop_callback forward(co_await CurrentStopTokenAwaiter(), [&control] { control.mStop.request_stop(); });  //whenAnyԼȡʱȡЭ
     co_await WhenAnyAwaiter(control, taskArray);                                                //WhenAnyAwaiterһAwaiter
     Uninitialized<std::variant<typename AwaitableTraits<Ts>::NonVoidRetType...>> varResult;
     ((control.mIndex == Is && (varResult.putValue(
@@ -631,6 +804,295 @@ auto when_any(Ts &&...ts) {
         std::forward<Ts>(ts)...);   //whenAnyImplһЭ
 }
 
+/*
+* when_all/when_anyrange汾ʹõһڴ
+*
+* Э̵ĸʱ֪Э֡ϷһReturnPreviousTask飬
+* ƿ顢helperЭ̾ۺhelperЭ֡ͬһηڴ
+*
+*   | Ctl | std::coroutine_handle<> x n | Slot x n | helperЭ֡ x n |
+*
+* helperЭ֡ĴСֻб֪һhelperЭ֡operator newʱõ
+* ڴڴһhelperʱģhelperͬһ֡ĴСһ
+*
+*/
+template <class Ctl, class Slot>
+struct WhenRangeBlock {
+    static constexpr std::size_t kAlign = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+    static_assert(alignof(Ctl) <= kAlign && alignof(Slot) <= kAlign);
+
+    explicit WhenRangeBlock(std::size_t size) noexcept : mSize(size) {}
+
+    WhenRangeBlock(WhenRangeBlock&&) = delete;
+
+    ~WhenRangeBlock() {
+        if (!mMemory)
+            return;
+        for (std::size_t i = 0; i < mCreated; ++i)
+            handles()[i].destroy();
+        for (std::size_t i = 0; i < mSize; ++i)
+            slots()[i].~Slot();
+        control().~Ctl();
+        ::operator delete(mMemory);
+    }
+
+    //helperЭ̵operator newصmCreatedЭ֡λ
+    void* allocateFrame(std::size_t frameSize) {
+        if (!mMemory) {
+            mFrameSize = roundUp(frameSize);
+            mMemory = static_cast<std::byte*>(::operator new(framesOffset() + mFrameSize * mSize));
+            new (mMemory) Ctl();
+            for (std::size_t i = 0; i < mSize; ++i)
+                new (slots() + i) Slot();
+        }
+        return mMemory + framesOffset() + mFrameSize * mCreated;
+    }
+
+    void add(std::coroutine_handle<> coroutine) noexcept {
+        handles()[mCreated++] = coroutine;
+    }
+
+    Ctl& control() noexcept {
+        return *std::launder(reinterpret_cast<Ctl*>(mMemory));
+    }
+
+    std::coroutine_handle<>* handles() noexcept {
+        return reinterpret_cast<std::coroutine_handle<>*>(mMemory + handlesOffset());
+    }
+
+    Slot* slots() noexcept {
+        return std::launder(reinterpret_cast<Slot*>(mMemory + slotsOffset()));
+    }
+
+    std::span<std::coroutine_handle<> const> started() noexcept {
+        return { handles(), mCreated };
+    }
+
+    static constexpr std::size_t roundUp(std::size_t n) noexcept {
+        return (n + kAlign - 1) / kAlign * kAlign;
+    }
+
+    std::size_t handlesOffset() const noexcept {
+        return roundUp(sizeof(Ctl));
+    }
+
+    std::size_t slotsOffset() const noexcept {
+        return handlesOffset() + roundUp(sizeof(std::coroutine_handle<>) * mSize);
+    }
+
+    std::size_t framesOffset() const noexcept {
+        return slotsOffset() + roundUp(sizeof(Slot) * mSize);
+    }
+
+    std::size_t mSize;             //Э̸
+    std::size_t mCreated = 0;      //Ѿhelper
+    std::size_t mFrameSize = 0;    //ÿhelperЭ֡ĴС
+    std::byte* mMemory = nullptr;
+};
+
+/*
+* range汾helperЭʹõpromise_typeЭ֡WhenRangeBlock䣬WhenRangeBlockͳһͷ
+*
+* helperЭ̵Ĳ(Block&, T const&, std::size_t)operator new/deleteдɷģĳԱ
+* operator newǳԱģ壬GCCΪoperator delete(void*)ԣ-Wmismatched-new-delete
+*
+*/
+template <class Block, class T>
+struct WhenRangePromise : ReturnPreviousPromise {
+    auto get_return_object() {
+        return std::coroutine_handle<WhenRangePromise>::from_promise(*this);
+    }
+
+    static void* operator new(std::size_t size, Block& block, T const&, std::size_t) {
+        return block.allocateFrame(size);
+    }
+
+    //Э֡ڴWhenRangeBlockܣʲôҲ
+    static void operator delete(void*) noexcept {}
+
+    //operator newԵplacementʽ
+    static void operator delete(void*, Block&, T const&, std::size_t) noexcept {}
+};
+
+template <class Block, class T>
+struct WhenRangeHelperTask {
+    using promise_type = WhenRangePromise<Block, T>;
+
+    WhenRangeHelperTask(std::coroutine_handle<promise_type> coroutine) noexcept
+        : mCoroutine(coroutine) {}
+
+    std::coroutine_handle<promise_type> mCoroutine;   //WhenRangeBlock
+};
+
+/*
+* range汾ʹõAwaiter
+*
+* ƿmCountЭ̸1һڷ𷽣
+* Э̿ڱ߳ϽֻЭ̼һЭ̿ﻹЭʱͻָwhenAll
+* ԷЭ֮ټԼһ0һָwhenAll
+*
+*/
+template <class Ctl>
+struct WhenRangeAwaiter {
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    std::coroutine_handle<>
+        await_suspend(std::coroutine_handle<> coroutine) const {
+        mControl.mPrevious = coroutine;
+        for (auto h : mTasks)
+            h.resume();
+        if (mControl.mCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            return coroutine;
+        return std::noop_coroutine();
+    }
+
+    void await_resume() const {
+        if (mControl.mException) [[unlikely]] {
+            std::rethrow_exception(mControl.mException);
+            }
+    }
+
+    Ctl& mControl;
+    std::span<std::coroutine_handle<> const> mTasks;
+};
+
+/*
+* range汾whenallʹõĿƿ飬ԭӵģЭڶ̵ִ߳Ҳ
+*
+*/
+struct WhenAllRangeCtlBlock {
+    std::atomic<std::size_t> mCount{ 0 };   //ûЭ̸ + 1𷽣
+    std::coroutine_handle<> mPrevious{};
+    std::atomic<bool> mFailed{ false };
+    std::exception_ptr mException{};        //һ쳣
+    std::stop_source mStop{};               //Э׳쳣ʱȡЭ
+};
+
+template <class R, class Slot, class T>
+WhenRangeHelperTask<WhenRangeBlock<WhenAllRangeCtlBlock, Slot>, T>
+whenAllRangeHelper(WhenRangeBlock<WhenAllRangeCtlBlock, Slot>& block, T const& t, std::size_t index) {
+    auto& control = block.control();
+    try {
+        if constexpr (std::is_void_v<R>) {
+            co_await t;
+            block.slots()[index].emplace();
+        }
+        else {
+            block.slots()[index].emplace(co_await t);
+        }
+    }
+    catch (...) {
+        if (!control.mFailed.exchange(true, std::memory_order_acq_rel)) {
+            control.mException = std::current_exception();
+            control.mStop.request_stop();
+        }
+    }
+    //쳣ҲҪЭ̶whenAll֮Эָ̻Ѿͷŵڴ
+    if (control.mCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        co_return control.mPrevious;
+    co_return nullptr;
+}
+
+template <class R>
+Task<std::vector<typename AwaitableTraits<std::ranges::range_value_t<R>>::NonVoidRetType>>
+whenAllRangeImpl(R&& tasks) {
+    using RetType = typename AwaitableTraits<std::ranges::range_value_t<R>>::RetType;
+    using ValueType = typename AwaitableTraits<std::ranges::range_value_t<R>>::NonVoidRetType;
+
+    std::size_t n = static_cast<std::size_t>(std::ranges::distance(tasks));
+    std::vector<ValueType> result;
+    if (n == 0)
+        co_return result;
+
+    WhenRangeBlock<WhenAllRangeCtlBlock, std::optional<ValueType>> block(n);
+    for (auto const& t : tasks) {
+        auto helper = whenAllRangeHelper<RetType>(block, t, block.mCreated).mCoroutine;
+        helper.promise().mStopToken = block.control().mStop.get_token();
+        block.add(helper);
+    }
+    auto& control = block.control();
+    control.mCount.store(n + 1, std::memory_order_relaxed);
+    std::stop_callback forward(co_await CurrentStopTokenAwaiter(), [&control] { control.mStop.request_stop(); });  //whenAllȡʱЭһȡ
+    co_await WhenRangeAwaiter<WhenAllRangeCtlBlock>(control, block.started());
+
+    result.reserve(n);
+    for (std::size_t i = 0; i < n; ++i)
+        result.push_back(std::move(*block.slots()[i]));
+    co_return result;
+}
+
+/*
+* ʱwhen_allstd::vector<Task<T>>std::vector<T>
+*
+*/
+template <std::ranges::forward_range R>
+    requires Awaitable<std::ranges::range_value_t<R>>
+auto when_all(R&& tasks) {
+    return whenAllRangeImpl(std::forward<R>(tasks));
+}
+
+template <class R, class Slot, class T>
+WhenRangeHelperTask<WhenRangeBlock<WhenAnyCtlBlock, Slot>, T>
+whenAnyRangeHelper(WhenRangeBlock<WhenAnyCtlBlock, Slot>& block, T const& t, std::size_t index) {
+    auto& control = block.control();
+    try {
+        //ÿhelperֻдԼĽۣĽWhenRangeBlockһ
+        if constexpr (std::is_void_v<R>) {
+            co_await t;
+            block.slots()[index].emplace();
+        }
+        else {
+            block.slots()[index].emplace(co_await t);
+        }
+        control.tryWin(index);
+    }
+    catch (...) {
+        if (control.tryWin(index))
+            control.mException = std::current_exception();
+    }
+    if (control.mCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        co_return control.mPrevious;
+    co_return nullptr;
+}
+
+template <class R>
+Task<std::pair<std::size_t, typename AwaitableTraits<std::ranges::range_value_t<R>>::NonVoidRetType>>
+whenAnyRangeImpl(R&& tasks) {
+    using RetType = typename AwaitableTraits<std::ranges::range_value_t<R>>::RetType;
+    using ValueType = typename AwaitableTraits<std::ranges::range_value_t<R>>::NonVoidRetType;
+
+    std::size_t n = static_cast<std::size_t>(std::ranges::distance(tasks));
+    if (n == 0)
+        throw std::invalid_argument("when_any: empty range");
+
+    WhenRangeBlock<WhenAnyCtlBlock, std::optional<ValueType>> block(n);
+    for (auto const& t : tasks) {
+        auto helper = whenAnyRangeHelper<RetType>(block, t, block.mCreated).mCoroutine;
+        helper.promise().mStopToken = block.control().mStop.get_token();
+        block.add(helper);
+    }
+    auto& control = block.control();
+    control.mCount.store(n + 1, std::memory_order_relaxed);
+    std::stop_callback forward(co_await CurrentStopTokenAwaiter(), [&control] { control.mStop.request_stop(); });
+    co_await WhenRangeAwaiter<WhenAnyCtlBlock>(control, block.started());
+
+    std::size_t index = block.control().mIndex.load(std::memory_order_acquire);
+    co_return std::pair<std::size_t, ValueType>(index, std::move(*block.slots()[index]));
+}
+
+/*
+* ʱwhen_anyɵ±Ľ
+* Ͳ汾һᱻȡwhen_anyǶ˳֮ŷ
+*
+*/
+template <std::ranges::forward_range R>
+    requires Awaitable<std::ranges::range_value_t<R>>
+auto when_any(R&& tasks) {
+    return whenAnyRangeImpl(std::forward<R>(tasks));
+}
+
 Task<int> hello1() {
     debug(), "hello1ʼ˯1";
     co_await sleep_for(1s); // 1s ȼ std::chrono::seconds(1)
@@ -640,7 +1102,13 @@ Task<int> hello1() {
 
 Task<int> hello2() {
     debug(), "hello2ʼ˯2";
-    co_await sleep_for(2s); // 2s ȼ std::chrono::seconds(2)
+    try {
+        co_await sleep_for(2s); // 2s ȼ std::chrono::seconds(2)
+    }
+    catch (OperationCancelled const&) {
+        debug(), "hello2ȡ";   //hello1˯ѣwhen_anyȡhello2
+        throw;
+    }
     debug(), "hello2˯";
     co_return 2;
 }
@@ -656,9 +1124,57 @@ Task<int> hello() {
     //co_return i + j;
 }
 
+Task<int> shard(int i) {
+    co_await sleep_for(std::chrono::milliseconds(100 * i));
+    co_return i * i;
+}
+
+Task<int> helloRange(int n) {
+    //ʱ֪ҪȶٸƬ
+    std::vector<Task<int>> shards;
+    for (int i = 1; i <= n; ++i)
+        shards.push_back(shard(i));
+    auto squares = co_await when_all(shards);
+    int sum = 0;
+    for (int v : squares)
+        sum += v;
+    debug(), "helloRange", (int)squares.size(), "Ƭˣƽ", sum;
+
+    //when_anyصʱƬѾȡˣʱҲѾ¼ѭƳ
+    std::vector<Task<int>> hedged;
+    for (int i = n; i >= 1; --i)
+        hedged.push_back(shard(i));
+    auto [index, value] = co_await when_any(hedged);
+    debug(), "helloRange", (int)index, "Ƭɣ", value, "ʣµĶʱ", (int)!getLoop().mRbTimer.empty();
+    co_return sum;
+}
+
+//micro_bench.cppֱӰļЩĿʱҪmain
+#ifndef STEP7_NO_MAIN
 int main() {
+#if CORO_SAMPLE
+    coro_sampler::start();
+#endif
     auto t = hello();   //helloЭ
     getLoop().run(t);   //ָhelloЭ̵ִ
     debug(), "еõhello:", t.mCoroutine.promise().result();   //õhelloЭ̵Ľ
+
+    auto r = helloRange(4);
+    getLoop().run(r);
+    debug(), "еõhelloRange:", r.mCoroutine.promise().result();
+#if CORO_PROFILE
+    coro_profile::print(std::cerr);
+#endif
+#if CORO_TRACE
+    std::ofstream trace("step7_trace.json");
+    coro_trace::writeJson(trace);
+#endif
+#if CORO_SAMPLE
+    //demo󲿷ʱ˯ߣITIMER_PROFֻCPUʱƣܶ
+    coro_sampler::stop();
+    std::ofstream folded("step7.folded");
+    coro_sampler::writeFolded(folded);
+#endif
     return 0;
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
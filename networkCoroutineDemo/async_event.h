@@ -0,0 +1,101 @@
+#pragma once
+
+/*
+* 协程的手动复位事件
+*
+*   co_await event;      // 事件没有set之前挂起
+*   event.set();         // 唤醒所有等待的协程，之后的co_await都直接返回，直到reset()
+*   event.reset();
+*
+* 状态只有一个原子字：
+*   set_state         已经set
+*   0 (nullptr)       没有set，没有等待者
+*   其他              没有set，值是等待者栈的栈顶（awaiter本身就是节点，挂在协程帧里，不分配内存）
+*
+* co_await和set()都是一次CAS/exchange，set()把整个栈取下来依次唤醒；
+* 等待者挂起时记录下当前线程的executor，set()时把它post回去；没有executor时在set()的线程上直接恢复
+*
+*/
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+
+#include "thread_pool.hpp"
+
+class async_manual_reset_event {
+public:
+    explicit async_manual_reset_event(bool initially_set = false) noexcept :
+        state_(initially_set ? set_state : 0) {}
+
+    async_manual_reset_event(const async_manual_reset_event&) = delete;
+
+    bool is_set() const noexcept { return state_.load(std::memory_order_acquire) == set_state; }
+
+    void set();
+
+    // 已经set的事件恢复到未set，没有set时什么都不做（不会丢掉等待者）
+    void reset() noexcept {
+        std::uintptr_t old = set_state;
+        state_.compare_exchange_strong(old, 0, std::memory_order_relaxed);
+    }
+
+    class awaiter {
+    public:
+        explicit awaiter(async_manual_reset_event& event) noexcept : event_(event) {}
+
+        bool await_ready() const noexcept { return event_.is_set(); }
+
+        bool await_suspend(std::coroutine_handle<> h) noexcept {
+            handle_ = h;
+            exec_ = executor::current();
+            std::uintptr_t old = event_.state_.load(std::memory_order_acquire);
+            do {
+                if(old == set_state) {
+                    return false;
+                }
+                next_ = reinterpret_cast<awaiter*>(old);
+            } while(!event_.state_.compare_exchange_weak(old, reinterpret_cast<std::uintptr_t>(this),
+                std::memory_order_release, std::memory_order_acquire));
+            return true;
+        }
+
+        void await_resume() noexcept {}
+    private:
+        friend async_manual_reset_event;
+
+        async_manual_reset_event& event_;
+        awaiter* next_ = nullptr;
+        std::coroutine_handle<> handle_;
+        executor* exec_ = nullptr;
+    };
+
+    awaiter operator co_await() noexcept { return awaiter{*this}; }
+private:
+    constexpr static std::uintptr_t set_state = 1;
+
+    std::atomic<std::uintptr_t> state_;
+};
+
+inline void async_manual_reset_event::set() {
+    std::uintptr_t old = state_.exchange(set_state, std::memory_order_acq_rel);
+    if(old == set_state) return;
+
+    // 栈是后进先出的，先反转一下，按等待的顺序唤醒
+    awaiter* waiters = nullptr;
+    for(auto* w = reinterpret_cast<awaiter*>(old); w;) {
+        awaiter* next = w->next_;
+        w->next_ = waiters;
+        waiters = w;
+        w = next;
+    }
+    while(waiters) {
+        awaiter* w = waiters;
+        waiters = w->next_;   // 恢复之后awaiter可能已经不存在了，先取next
+        if(w->exec_) {
+            w->exec_->post(w->handle_);
+        } else {
+            w->handle_.resume();
+        }
+    }
+}
@@ -0,0 +1,172 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include "async_file.h"
+#include "io_context.h"
+
+FileOp::FileOp(IoContext& io_context, int fd, Kind kind, off_t offset,
+    void* buffer, std::size_t len, int error) :
+    io_context_(io_context), fd_(fd), kind_(kind), offset_(offset), iovs_(&iov_), iovcnt_(1) {
+    iov_.iov_base = buffer;
+    iov_.iov_len = len;
+    if(error != 0) {
+        result_ = -error;
+        ready_ = true;
+    }
+}
+
+FileOp::FileOp(IoContext& io_context, int fd, Kind kind, off_t offset,
+    const struct iovec* iov, int iovcnt) :
+    io_context_(io_context), fd_(fd), kind_(kind), offset_(offset), iovs_(iov), iovcnt_(iovcnt) {
+    iov_.iov_base = nullptr;
+    iov_.iov_len = 0;
+}
+
+bool FileOp::await_suspend(std::coroutine_handle<> h) {
+    handle_ = h;
+
+#if defined(__linux__)
+    if(Uring* ring = io_context_.uring()) {
+        if(io_uring_sqe* sqe = ring->GetSqe()) {
+            sqe->fd = fd_;
+            sqe->user_data = reinterpret_cast<std::uint64_t>(static_cast<UringRequest*>(this));
+            switch(kind_) {
+            case Kind::Read:
+                sqe->opcode = IORING_OP_READV;
+                sqe->addr = reinterpret_cast<std::uint64_t>(iovs_);
+                sqe->len = iovcnt_;
+                sqe->off = offset_;
+                break;
+            case Kind::Write:
+                sqe->opcode = IORING_OP_WRITEV;
+                sqe->addr = reinterpret_cast<std::uint64_t>(iovs_);
+                sqe->len = iovcnt_;
+                sqe->off = offset_;
+                break;
+            case Kind::Fsync:
+                sqe->opcode = IORING_OP_FSYNC;
+                break;
+            case Kind::Fdatasync:
+                sqe->opcode = IORING_OP_FSYNC;
+                sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+                break;
+            }
+            return true;   // 真正的提交在事件循环下一轮epoll_wait之前
+        }
+    }
+#endif
+
+    run_ = &FileOp::RunBlocking;
+    if(io_context_.file_pool().try_submit(this)) {
+        return true;
+    }
+    result_ = Syscall();   // 线程池队列满了，只能在当前线程同步执行
+    return false;
+}
+
+ssize_t FileOp::await_resume() noexcept {
+    if(result_ < 0) {
+        errno = -result_;
+        return -1;
+    }
+    return result_;
+}
+
+int FileOp::Syscall() noexcept {
+    ssize_t ret = 0;
+    switch(kind_) {
+    case Kind::Read:
+        ret = ::preadv(fd_, iovs_, iovcnt_, offset_);
+        break;
+    case Kind::Write:
+        ret = ::pwritev(fd_, iovs_, iovcnt_, offset_);
+        break;
+    case Kind::Fsync:
+        ret = ::fsync(fd_);
+        break;
+    case Kind::Fdatasync:
+#if defined(__APPLE__)
+        ret = ::fsync(fd_);    // macOS上没有fdatasync
+#else
+        ret = ::fdatasync(fd_);
+#endif
+        break;
+    }
+    return ret == -1 ? -errno : static_cast<int>(ret);
+}
+
+void FileOp::RunBlocking(pool_job* job) {
+    auto op = static_cast<FileOp*>(job);
+    op->result_ = op->Syscall();
+    op->io_context_.post(op->handle_);   // 回到事件循环线程上恢复协程
+}
+
+AsyncFile::AsyncFile(IoContext& io_context, const char* path, int flags, mode_t mode, bool direct) :
+    io_context_(io_context), direct_(direct) {
+#if defined(O_DIRECT)
+    if(direct_) {
+        flags |= O_DIRECT;
+    }
+#endif
+    fd_ = ::open(path, flags | O_CLOEXEC, mode);
+    if(fd_ == -1) {
+        throw std::runtime_error{"open file error"};
+    }
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+    if(direct_) {
+        ::fcntl(fd_, F_NOCACHE, 1);   // macOS上没有O_DIRECT
+    }
+#endif
+}
+
+AsyncFile::~AsyncFile() {
+    if(fd_ == -1) return;
+    ::close(fd_);
+}
+
+FileOp AsyncFile::read_at(off_t offset, std::span<std::byte> buffer) {
+    int error = Aligned(offset, buffer.data(), buffer.size()) ? 0 : EINVAL;
+    return FileOp{io_context_, fd_, FileOp::Kind::Read, offset, buffer.data(), buffer.size(), error};
+}
+
+FileOp AsyncFile::write_at(off_t offset, std::span<const std::byte> buffer) {
+    int error = Aligned(offset, buffer.data(), buffer.size()) ? 0 : EINVAL;
+    return FileOp{io_context_, fd_, FileOp::Kind::Write, offset,
+        const_cast<std::byte*>(buffer.data()), buffer.size(), error};
+}
+
+FileOp AsyncFile::writev_at(off_t offset, std::span<const struct iovec> iovs) {
+    return FileOp{io_context_, fd_, FileOp::Kind::Write, offset, iovs.data(), static_cast<int>(iovs.size())};
+}
+
+FileOp AsyncFile::fsync() {
+    return FileOp{io_context_, fd_, FileOp::Kind::Fsync, 0, nullptr, 0};
+}
+
+FileOp AsyncFile::fdatasync() {
+    return FileOp{io_context_, fd_, FileOp::Kind::Fdatasync, 0, nullptr, 0};
+}
+
+bool AsyncFile::Aligned(off_t offset, const void* buffer, std::size_t len) const {
+    std::size_t align = alignment();
+    return offset % align == 0 &&
+        reinterpret_cast<std::uintptr_t>(buffer) % align == 0 &&
+        len % align == 0;
+}
+
+AlignedBuffer::AlignedBuffer(std::size_t size, std::size_t alignment) : size_(size) {
+    // aligned_alloc要求size是alignment的整数倍
+    std::size_t rounded = (size + alignment - 1) / alignment * alignment;
+    data_ = static_cast<std::byte*>(std::aligned_alloc(alignment, rounded));
+    if(data_ == nullptr) {
+        throw std::bad_alloc{};
+    }
+}
+
+AlignedBuffer::~AlignedBuffer() {
+    std::free(data_);
+}
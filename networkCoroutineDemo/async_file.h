@@ -0,0 +1,137 @@
+#pragma once
+
+/*
+* 异步文件I/O
+*
+*   co_await file.read_at(offset, buffer);
+*   co_await file.write_at(offset, buffer);
+*   co_await file.fsync();
+*   co_await file.writev_at(offset, iovecs);   // 多个缓冲区一次写入
+*   co_await file.fdatasync();
+*
+* 文件在epoll里永远是"就绪"的，不能像socket那样等可读可写事件，所以：
+* （1）Linux上优先把请求提交到IoContext的io_uring，完成后由事件循环恢复协程；
+* （2）io_uring不可用时，把preadv/pwritev/fsync投递到IoContext的文件线程池，执行完之后通过IoContext::post()回到事件循环；
+* （3）线程池队列满了的时候，只能在当前线程同步执行，co_await不会挂起；
+*
+* co_await的返回值和系统调用一样：成功返回字节数（fsync返回0），失败返回-1并设置errno
+*
+*/
+
+#include <coroutine>
+#include <cstddef>
+#include <span>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "thread_pool.hpp"
+#include "uring.h"
+
+class IoContext;
+class AsyncFile;
+
+/*
+* 一次文件操作的awaiter，既是线程池的任务节点，也是io_uring的请求
+*/
+class FileOp : public pool_job, public UringRequest {
+public:
+    enum class Kind { Read, Write, Fsync, Fdatasync };
+
+    FileOp(IoContext& io_context, int fd, Kind kind, off_t offset,
+        void* buffer, std::size_t len, int error = 0);
+
+    // 多个缓冲区的读写，iov指向的数组在co_await结束之前必须有效
+    FileOp(IoContext& io_context, int fd, Kind kind, off_t offset,
+        const struct iovec* iov, int iovcnt);
+
+    FileOp(const FileOp&) = delete;
+
+    bool await_ready() const noexcept { return ready_; }
+
+    bool await_suspend(std::coroutine_handle<> h);
+
+    ssize_t await_resume() noexcept;
+private:
+    int Syscall() noexcept;                // 同步执行系统调用，失败时返回-errno
+    static void RunBlocking(pool_job* job); // 在线程池线程上执行
+
+    IoContext& io_context_;
+    int fd_;
+    Kind kind_;
+    off_t offset_;
+    struct iovec iov_;              // 单个缓冲区的时候用这个，iovs_指向它
+    const struct iovec* iovs_;
+    int iovcnt_;
+    bool ready_ = false;    // 参数检查失败时直接返回，不用挂起
+};
+
+/*
+* 异步文件
+* direct为true时绕过page cache（Linux上是O_DIRECT），缓冲区地址、偏移和长度都必须按alignment()对齐，
+* 对齐的缓冲区可以用AlignedBuffer分配
+*/
+class AsyncFile {
+public:
+    AsyncFile(IoContext& io_context, const char* path, int flags, mode_t mode = 0644, bool direct = false);
+
+    AsyncFile(const AsyncFile&) = delete;
+    AsyncFile(AsyncFile&& file) :
+        io_context_(file.io_context_),
+        fd_(file.fd_),
+        direct_(file.direct_) {
+        file.fd_ = -1;
+    }
+
+    ~AsyncFile();
+
+    FileOp read_at(off_t offset, std::span<std::byte> buffer);
+
+    FileOp write_at(off_t offset, std::span<const std::byte> buffer);
+
+    FileOp writev_at(off_t offset, std::span<const struct iovec> iovs);
+
+    FileOp fsync();
+
+    // 只保证数据落盘，不强制刷新mtime等元数据
+    FileOp fdatasync();
+
+    IoContext& io_context() const { return io_context_; }
+
+    int fd() const { return fd_; }
+
+    bool direct() const { return direct_; }
+
+    // O_DIRECT要求的对齐大小，常见设备的逻辑块大小都不超过4096
+    std::size_t alignment() const { return direct_ ? direct_alignment : 1; }
+private:
+    constexpr static std::size_t direct_alignment = 4096;
+
+    bool Aligned(off_t offset, const void* buffer, std::size_t len) const;
+
+    IoContext& io_context_;
+    int fd_ = -1;
+    bool direct_ = false;
+};
+
+/*
+* 按指定大小对齐的缓冲区，给O_DIRECT读写使用
+*/
+class AlignedBuffer {
+public:
+    AlignedBuffer(std::size_t size, std::size_t alignment);
+
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer(AlignedBuffer&& buffer) : data_(buffer.data_), size_(buffer.size_) {
+        buffer.data_ = nullptr;
+        buffer.size_ = 0;
+    }
+
+    ~AlignedBuffer();
+
+    std::byte* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    std::span<std::byte> span() const { return {data_, size_}; }
+private:
+    std::byte* data_ = nullptr;
+    std::size_t size_ = 0;
+};
@@ -0,0 +1,145 @@
+#pragma once
+
+/*
+* 异步生成器：在两次co_yield之间可以co_await I/O
+*
+*   async_generator<std::span<const std::byte>> chunks = socket.chunks();
+*   for(auto it = co_await chunks.begin(); it != chunks.end(); co_await ++it) {
+*       ... 处理*it ...
+*   }
+*
+* C++20没有for co_await，所以begin()和++it都要自己co_await，循环的写法和上面一样
+*
+* （1）co_yield的机制和easyDemo里的generator一样，promise里只保存被yield对象的地址，不拷贝；
+* （2）调用方co_await begin()/++it时，把自己记录在promise.consumer_里然后切换到生成器协程（和task的continuation_一样）；
+* （3）生成器协程里co_await recv等I/O时挂起，由IoContext在数据到达后恢复，调用方这段时间一直挂起等着；
+* （4）co_yield或者协程结束时，直接切换回consumer_（对称转移），不经过事件循环；
+* （5）生成器里抛出的异常保存在promise里，在调用方co_await的地方重新抛出；
+*
+* 生成器协程只在调用方co_await的时候运行，所以调用方拿着async_generator的时候，生成器一定挂起在co_yield上（或者还没开始、已经结束），
+* 这时析构async_generator销毁协程帧是安全的
+*
+*/
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+template<typename T>
+class async_generator {
+public:
+    using value_type = std::remove_cvref_t<T>;
+    using reference = std::conditional_t<std::is_reference_v<T>, T, T&>;
+    using pointer = std::add_pointer_t<reference>;
+
+    struct promise_type {
+        pointer value_ = nullptr;
+        std::coroutine_handle<> consumer_;          // 正在等待下一个值的协程
+        std::exception_ptr exception_;
+
+        async_generator get_return_object() noexcept {
+            return async_generator{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        // 创建之后先挂起，调用方co_await begin()时才开始执行
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        // co_yield和协程结束都是切换回调用方
+        struct yield_awaiter {
+            bool await_ready() noexcept { return false; }
+            void await_resume() noexcept {}
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                return h.promise().consumer_;
+            }
+        };
+
+        yield_awaiter final_suspend() noexcept { return {}; }
+
+        // 被yield的对象（包括临时对象）在协程挂起期间一直有效，只记录地址
+        yield_awaiter yield_value(value_type& value) noexcept {
+            value_ = std::addressof(value);
+            return {};
+        }
+
+        yield_awaiter yield_value(value_type&& value) noexcept {
+            value_ = std::addressof(value);
+            return {};
+        }
+
+        void return_void() noexcept {}
+
+        void unhandled_exception() noexcept {
+            exception_ = std::current_exception();
+        }
+    };
+
+    class iterator;
+
+    // co_await begin()和co_await ++it共用的awaiter：恢复生成器，直到它下一次co_yield或者结束
+    struct advance_awaiter {
+        bool await_ready() const noexcept { return !coro_ || coro_.done(); }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> consumer) noexcept {
+            coro_.promise().consumer_ = consumer;
+            return coro_;
+        }
+
+        iterator await_resume() {
+            if(coro_ && coro_.done() && coro_.promise().exception_) {
+                std::rethrow_exception(coro_.promise().exception_);
+            }
+            return iterator{coro_};
+        }
+
+        std::coroutine_handle<promise_type> coro_;
+    };
+
+    class iterator {
+    public:
+        using value_type = async_generator::value_type;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+        explicit iterator(std::coroutine_handle<promise_type> coro) noexcept : coro_(coro) {}
+
+        // 需要co_await，返回的还是指向同一个生成器的迭代器
+        advance_awaiter operator++() noexcept { return advance_awaiter{coro_}; }
+
+        reference operator*() const noexcept { return static_cast<reference>(*coro_.promise().value_); }
+
+        pointer operator->() const noexcept { return coro_.promise().value_; }
+
+        friend bool operator==(const iterator& it, std::default_sentinel_t) noexcept {
+            return !it.coro_ || it.coro_.done();
+        }
+    private:
+        std::coroutine_handle<promise_type> coro_;
+    };
+
+    async_generator() = default;
+
+    async_generator(const async_generator&) = delete;
+    async_generator(async_generator&& other) noexcept : coro_(std::exchange(other.coro_, nullptr)) {}
+
+    async_generator& operator=(async_generator other) noexcept {
+        std::swap(coro_, other.coro_);
+        return *this;
+    }
+
+    ~async_generator() {
+        if(coro_) coro_.destroy();
+    }
+
+    // 只能调用一次
+    advance_awaiter begin() noexcept { return advance_awaiter{coro_}; }
+
+    std::default_sentinel_t end() const noexcept { return {}; }
+private:
+    explicit async_generator(std::coroutine_handle<promise_type> coro) noexcept : coro_(coro) {}
+
+    std::coroutine_handle<promise_type> coro_;
+};
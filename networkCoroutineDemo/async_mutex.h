@@ -0,0 +1,139 @@
+#pragma once
+
+/*
+* 协程互斥锁：拿不到锁时挂起协程，而不是阻塞整个IoContext线程
+*
+*   {
+*       auto guard = co_await mutex.scoped_lock();
+*       ... 临界区，里面可以继续co_await ...
+*   }   // guard析构时解锁，锁直接交给下一个等待者
+*
+* 状态只有一个原子字：
+*   not_locked        没有上锁
+*   0 (nullptr)       已经上锁，没有等待者
+*   其他              已经上锁，值是等待者栈的栈顶（awaiter本身就是节点，挂在协程帧里，不分配内存）
+*
+* 上锁和排队都是一次CAS；解锁时由持有锁的协程把新到的等待者整体取下来，反转成先进先出的waiters_，
+* waiters_只有持有锁的一方会访问，所以不需要加锁；
+* 解锁不会让锁回到未上锁状态再让大家去抢，而是直接交给waiters_的第一个协程，保证公平，也不会有惊群
+*
+* 等待者挂起时记录下当前线程的executor，解锁时把它post回去；没有executor时在解锁的线程上直接恢复
+*
+*/
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <utility>
+
+#include "thread_pool.hpp"
+
+class async_mutex {
+public:
+    async_mutex() = default;
+    async_mutex(const async_mutex&) = delete;
+
+    bool try_lock() noexcept {
+        std::uintptr_t old = not_locked;
+        return state_.compare_exchange_strong(old, locked_no_waiters,
+            std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    void unlock();
+
+    class lock_guard {
+    public:
+        explicit lock_guard(async_mutex& mutex) noexcept : mutex_(&mutex) {}
+        lock_guard(const lock_guard&) = delete;
+        lock_guard(lock_guard&& other) noexcept : mutex_(std::exchange(other.mutex_, nullptr)) {}
+        ~lock_guard() {
+            if(mutex_) mutex_->unlock();
+        }
+    private:
+        async_mutex* mutex_;
+    };
+
+    class lock_awaiter {
+    public:
+        explicit lock_awaiter(async_mutex& mutex) noexcept : mutex_(mutex) {}
+
+        bool await_ready() noexcept { return mutex_.try_lock(); }
+
+        bool await_suspend(std::coroutine_handle<> h) noexcept {
+            handle_ = h;
+            exec_ = executor::current();
+            std::uintptr_t old = mutex_.state_.load(std::memory_order_relaxed);
+            for(;;) {
+                if(old == not_locked) {
+                    // 锁在这期间被释放了，直接拿锁，不挂起
+                    if(mutex_.state_.compare_exchange_weak(old, locked_no_waiters,
+                        std::memory_order_acquire, std::memory_order_relaxed)) {
+                        return false;
+                    }
+                } else {
+                    next_ = reinterpret_cast<lock_awaiter*>(old);
+                    if(mutex_.state_.compare_exchange_weak(old, reinterpret_cast<std::uintptr_t>(this),
+                        std::memory_order_release, std::memory_order_relaxed)) {
+                        return true;
+                    }
+                }
+            }
+        }
+
+        void await_resume() noexcept {}
+    protected:
+        friend async_mutex;
+
+        async_mutex& mutex_;
+        lock_awaiter* next_ = nullptr;
+        std::coroutine_handle<> handle_;
+        executor* exec_ = nullptr;
+    };
+
+    struct scoped_lock_awaiter : lock_awaiter {
+        using lock_awaiter::lock_awaiter;
+
+        [[nodiscard]] lock_guard await_resume() noexcept { return lock_guard{mutex_}; }
+    };
+
+    // co_await lock()之后需要自己调用unlock()
+    lock_awaiter lock() noexcept { return lock_awaiter{*this}; }
+
+    // co_await scoped_lock()返回lock_guard，离开作用域时自动解锁
+    scoped_lock_awaiter scoped_lock() noexcept { return scoped_lock_awaiter{*this}; }
+private:
+    constexpr static std::uintptr_t not_locked = 1;
+    constexpr static std::uintptr_t locked_no_waiters = 0;
+
+    std::atomic<std::uintptr_t> state_{not_locked};
+    lock_awaiter* waiters_ = nullptr;   // 先进先出的等待队列，只有持有锁的一方访问
+};
+
+inline void async_mutex::unlock() {
+    lock_awaiter* waiter = waiters_;
+    if(!waiter) {
+        std::uintptr_t old = locked_no_waiters;
+        if(state_.compare_exchange_strong(old, not_locked,
+            std::memory_order_release, std::memory_order_relaxed)) {
+            return;
+        }
+
+        // 有新的等待者，把栈整个取下来反转成队列
+        old = state_.exchange(locked_no_waiters, std::memory_order_acquire);
+        auto* stack = reinterpret_cast<lock_awaiter*>(old);
+        do {
+            lock_awaiter* next = stack->next_;
+            stack->next_ = waiter;
+            waiter = stack;
+            stack = next;
+        } while(stack);
+    }
+
+    // 锁的所有权直接交给队首的协程
+    waiters_ = waiter->next_;
+    if(waiter->exec_) {
+        waiter->exec_->post(waiter->handle_);
+    } else {
+        waiter->handle_.resume();
+    }
+}
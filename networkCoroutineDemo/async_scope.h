@@ -0,0 +1,163 @@
+#pragma once
+
+/*
+* 结构化并发：async_scope
+*
+*   async_scope scope;
+*   for(...) {
+*       scope.spawn(handle(socket));   // 立即开始执行，直到子协程第一次挂起
+*   }
+*   co_await scope.join();             // 等所有子协程结束，有子协程抛出异常时在这里重新抛出第一个异常
+*
+* 和直接t.resume()启动一个"分离"的task相比：
+* （1）scope记录了所有还没结束的子协程（侵入式双向链表，节点在包装协程的promise里，不额外分配），
+*      active()可以看到当前有多少个子协程，方便观察和限制每个scope的并发数；
+* （2）子协程结束时，它的协程帧（包括task的帧和包装协程的帧）马上被销毁，里面持有的资源（例如shared_ptr<Socket>）随之释放；
+* （3）第一个抛出的异常被保存下来，同时请求取消其他子协程；join()重新抛出这个异常；
+* （4）取消是协作式的：request_stop()之后，子协程里正在等待的sleep、recv等操作被取消，
+*      子协程也可以通过get_stop_token()或者co_await current_stop_token()看到取消请求，自己尽快退出；
+*
+* scope不是线程安全的，子协程应该都在同一个IoContext上运行；
+* 和std::thread一样，还有子协程没有结束时析构scope会调用std::terminate()，所以析构之前一定要co_await join()
+*
+*/
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <stop_token>
+#include <utility>
+
+#include "task.h"
+
+class async_scope;
+
+namespace detail {
+
+// 包装协程：co_await子task，结束时从scope中摘掉自己并销毁自己的协程帧
+struct scope_child {
+    struct promise_type {
+        async_scope* scope_ = nullptr;
+        promise_type* prev_ = nullptr;
+        promise_type* next_ = nullptr;
+        std::stop_token stop_token_;   // scope的stop_token，co_await子task时传给子task
+
+        scope_child get_return_object() noexcept {
+            return scope_child{coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        suspend_always initial_suspend() noexcept { return {}; }
+
+        struct final_awaiter {
+            bool await_ready() noexcept { return false; }
+            coroutine_handle<> await_suspend(coroutine_handle<promise_type> h) noexcept;
+            void await_resume() noexcept {}
+        };
+
+        final_awaiter final_suspend() noexcept { return {}; }
+
+        void return_void() noexcept {}
+
+        // 子task的异常在包装协程里已经catch住了，这里不会走到
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+
+    coroutine_handle<promise_type> handle_;
+};
+
+} // namespace detail
+
+class async_scope {
+public:
+    async_scope() = default;
+    async_scope(const async_scope&) = delete;
+
+    ~async_scope() {
+        if(head_) {
+            std::terminate();   // 还有子协程在运行，它们结束时会访问已经析构的scope
+        }
+    }
+
+    // 接管task并马上开始执行，task的协程帧在它结束时销毁（co_await task会销毁它的协程帧）
+    template<typename T>
+    void spawn(task<T> t) {
+        auto child = Run(*this, t).handle_;
+        auto& promise = child.promise();
+        promise.scope_ = this;
+        promise.stop_token_ = stop_.get_token();
+        promise.next_ = head_;
+        if(head_) head_->prev_ = &promise;
+        head_ = &promise;
+        ++active_;
+        ++spawned_;
+        child.resume();
+    }
+
+    struct join_awaiter {
+        bool await_ready() const noexcept { return scope_.active_ == 0; }
+
+        void await_suspend(coroutine_handle<> h) noexcept { scope_.joiner_ = h; }
+
+        void await_resume() const {
+            if(scope_.exception_) {
+                std::rethrow_exception(std::exchange(scope_.exception_, nullptr));
+            }
+        }
+
+        async_scope& scope_;
+    };
+
+    // 等所有子协程结束，包括join期间新spawn的子协程
+    join_awaiter join() noexcept { return join_awaiter{*this}; }
+
+    // 请求取消所有子协程，子协程通过get_stop_token()观察
+    void request_stop() noexcept { stop_.request_stop(); }
+
+    std::stop_token get_stop_token() const noexcept { return stop_.get_token(); }
+
+    // 还没有结束的子协程个数
+    std::size_t active() const noexcept { return active_; }
+
+    // 一共spawn过的子协程个数
+    std::uint64_t spawned() const noexcept { return spawned_; }
+private:
+    friend detail::scope_child::promise_type::final_awaiter;
+
+    template<typename T>
+    static detail::scope_child Run(async_scope& scope, task<T> t) {
+        try {
+            co_await t;
+        } catch(...) {
+            if(!scope.exception_) {
+                scope.exception_ = std::current_exception();
+                scope.request_stop();   // 第一个异常出现之后，其他子协程也没有必要继续了
+            }
+        }
+    }
+
+    // 子协程结束：从链表中摘掉，最后一个结束的子协程恢复join的协程
+    coroutine_handle<> Remove(detail::scope_child::promise_type& promise) noexcept {
+        if(promise.prev_) promise.prev_->next_ = promise.next_; else head_ = promise.next_;
+        if(promise.next_) promise.next_->prev_ = promise.prev_;
+        if(--active_ == 0 && joiner_) {
+            return std::exchange(joiner_, nullptr);
+        }
+        return std::noop_coroutine();
+    }
+
+    detail::scope_child::promise_type* head_ = nullptr;
+    std::size_t active_ = 0;
+    std::uint64_t spawned_ = 0;
+    coroutine_handle<> joiner_;
+    std::exception_ptr exception_;
+    std::stop_source stop_;
+};
+
+inline coroutine_handle<> detail::scope_child::promise_type::final_awaiter::await_suspend(
+    coroutine_handle<promise_type> h) noexcept {
+    async_scope* scope = h.promise().scope_;
+    coroutine_handle<> next = scope->Remove(h.promise());
+    h.destroy();   // 包装协程已经结束，马上释放它的协程帧
+    return next;
+}
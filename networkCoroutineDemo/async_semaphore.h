@@ -0,0 +1,109 @@
+#pragma once
+
+/*
+* 协程信号量，用来限制并发数
+*
+*   async_semaphore limit{16};
+*   co_await limit.acquire();
+*   ... 最多16个协程同时在这里 ...
+*   limit.release();
+*
+* count_是唯一的状态字：正数表示还剩多少许可，负数表示有多少协程在等待（或者正要开始等待）；
+* （1）acquire：有许可时一次CAS拿走，不挂起；没有时fetch_sub之后挂到等待队列上；
+* （2）release：fetch_add之后发现原来是负数，说明有等待者，取出队首的协程把许可直接交给它；
+* 只有真的需要排队和唤醒时才会碰到等待队列，等待队列用一个小锁保护（awaiter本身就是节点，挂在协程帧里，不分配内存）；
+* 等待者fetch_sub之后、进入队列之前，release可能已经来了，这时release留下一个tokens_，等待者看到之后就不挂起了
+*
+* 等待者挂起时记录下当前线程的executor，release时把它post回去；没有executor时在release的线程上直接恢复
+*
+*/
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <mutex>
+
+#include "thread_pool.hpp"
+
+class async_semaphore {
+public:
+    explicit async_semaphore(std::ptrdiff_t permits) noexcept : count_(permits) {}
+
+    async_semaphore(const async_semaphore&) = delete;
+
+    bool try_acquire() noexcept {
+        std::ptrdiff_t old = count_.load(std::memory_order_relaxed);
+        while(old > 0) {
+            if(count_.compare_exchange_weak(old, old - 1,
+                std::memory_order_acquire, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void release();
+
+    class acquire_awaiter {
+    public:
+        explicit acquire_awaiter(async_semaphore& semaphore) noexcept : semaphore_(semaphore) {}
+
+        bool await_ready() noexcept { return semaphore_.try_acquire(); }
+
+        bool await_suspend(std::coroutine_handle<> h) {
+            handle_ = h;
+            exec_ = executor::current();
+            if(semaphore_.count_.fetch_sub(1, std::memory_order_acquire) > 0) {
+                return false;
+            }
+            std::lock_guard<std::mutex> lock(semaphore_.mutex_);
+            if(semaphore_.tokens_ > 0) {
+                --semaphore_.tokens_;
+                return false;
+            }
+            if(semaphore_.tail_) semaphore_.tail_->next_ = this; else semaphore_.head_ = this;
+            semaphore_.tail_ = this;
+            return true;
+        }
+
+        void await_resume() noexcept {}
+    private:
+        friend async_semaphore;
+
+        async_semaphore& semaphore_;
+        acquire_awaiter* next_ = nullptr;
+        std::coroutine_handle<> handle_;
+        executor* exec_ = nullptr;
+    };
+
+    acquire_awaiter acquire() noexcept { return acquire_awaiter{*this}; }
+private:
+    std::atomic<std::ptrdiff_t> count_;
+    std::mutex mutex_;                      // 只保护下面的等待队列
+    acquire_awaiter* head_ = nullptr;
+    acquire_awaiter* tail_ = nullptr;
+    std::size_t tokens_ = 0;                // 已经发出、但等待者还没来得及进队列的许可
+};
+
+inline void async_semaphore::release() {
+    if(count_.fetch_add(1, std::memory_order_release) >= 0) {
+        return;
+    }
+
+    acquire_awaiter* waiter = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        waiter = head_;
+        if(!waiter) {
+            ++tokens_;
+            return;
+        }
+        head_ = waiter->next_;
+        if(!head_) tail_ = nullptr;
+    }
+    if(waiter->exec_) {
+        waiter->exec_->post(waiter->handle_);
+    } else {
+        waiter->handle_.resume();
+    }
+}
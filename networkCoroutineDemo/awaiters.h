@@ -6,23 +6,30 @@
 *
 */
 
+#include <cerrno>
 #include <type_traits>
-#include <iostream>
 #include <memory>
+#include <optional>
+#include <stop_token>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <netdb.h>
 #include <unistd.h>
+#include "debug.hpp"
 #include "task.h"
 #include "socket.h"
+#include "io_context.h"
 
 /*
 * 所有Waiter的行为是类似的
 * （1）await_ready()返回false，不可能直接就绪；
 * （2）await_suspend()是最核心的部分，判断系统调用是否可以直接返回结果，如果可以则不需要挂起，会返回false，否则就返回true挂起，并在挂起之前把socket的接收协程设置好，便于后续唤醒；
 * （3）await_resume()是核心的部分，判断之前是否因为系统调用条件不满足而挂起，如果是则调用系统调用并返回系统调用的结果，之前等待的协程就能从这得到返回结果；
+* （4）挂起期间协程的stop_token收到取消请求时（例如when_any里另一个分支先完成了），不再等待事件，
+*      协程通过就绪队列恢复，co_await返回-1，errno为ECANCELED；取消请求需要在事件循环线程上发出；
 * 
 * 
 * 
@@ -41,7 +48,8 @@ public:
     bool await_ready() const noexcept { return false; }
 
     //这里的函数参数h代表所在协程的句柄，就是调用co_await的协程序
-    bool await_suspend(std::coroutine_handle<> h) noexcept {
+    template<typename Promise>
+    bool await_suspend(std::coroutine_handle<Promise> h) noexcept {
         static_assert(std::is_base_of_v<AsyncSyscall, Syscall>);
         handle_ = h;
         value_ = static_cast<Syscall*>(this)->Syscall();
@@ -52,20 +60,44 @@ public:
         if(suspended_) {
             // 设置每个操作的coroutine handle，recv/send在适当的epoll事件发生后才能正常调用
             static_cast<Syscall*>(this)->SetCoroHandle();
+
+            // 已经请求过取消时，stop_callback的构造函数里就会直接调用Cancel
+            auto token = detail::stop_token_of(h);
+            if(token.stop_possible()) {
+                cancel_.emplace(token, Cancel{this});
+            }
         }
         return suspended_;
     }
 
     //事件就绪之后，waiter的这个函数会调用系统调用，然后把系统调用的结果返回
     ReturnValue await_resume() noexcept {
-        std::cout<<"await_resume\n";
+        debug(), "await_resume";
+        cancel_.reset();
+        if(cancelled_) {
+            errno = ECANCELED;
+            return -1;
+        }
         if(suspended_) {
             value_ = static_cast<Syscall*>(this)->Syscall();
         }
         return value_;
     }
 protected:
+    // 取消时不再等待事件：摘掉socket上记录的协程，通过就绪队列恢复它
+    struct Cancel {
+        AsyncSyscall* self_;
+
+        void operator()() const noexcept {
+            self_->cancelled_ = true;
+            static_cast<Syscall*>(self_)->ClearCoroHandle();
+            static_cast<Syscall*>(self_)->Context().post(self_->handle_);
+        }
+    };
+
     bool suspended_;   //是否需要挂起协程
+    bool cancelled_ = false;
+    std::optional<std::stop_callback<Cancel>> cancel_;
 
     // 当前awaiter所在协程的handle，需要设置给socket的coro_recv_或是coro_send_来读写数据
     // handle_不是在构造函数中设置的，所以在子类的构造函数中也无法获取，必须在await_suspend以后才能设置
@@ -83,25 +115,37 @@ class Accept : public AsyncSyscall<Accept, int> {
 public:
     Accept(Socket* socket) : AsyncSyscall{}, socket_(socket) {
         socket_->io_context_.WatchRead(socket_);
-        std::cout<<" socket accept opertion\n";
+        debug(), "socket accept operation";
     }
 
     ~Accept() {
         socket_->io_context_.UnwatchRead(socket_);
-        std::cout<<"~socket accept operation\n";
+        debug(), "~socket accept operation";
     }
 
     int Syscall() {
         struct sockaddr_storage addr;
         socklen_t addr_size = sizeof(addr);
-        std::cout<<"accept "<<socket_->fd_<<"\n";
-        return ::accept(socket_->fd_, (struct sockaddr*)&addr, &addr_size);
+        debug(), "accept", socket_->fd_;
+        int fd = ::accept(socket_->fd_, (struct sockaddr*)&addr, &addr_size);
+        if(fd != -1) {
+            socket_->io_context_.metrics_.accepts.add();
+        }
+        return fd;
     }
 
     //将被waiter挂起的协程记录下来到socket对象中,后面epoll会事件就绪后会唤醒这个协程
     void SetCoroHandle() {
         socket_->coro_recv_ = handle_;
     }
+
+    void ClearCoroHandle() {
+        socket_->coro_recv_ = nullptr;
+    }
+
+    IoContext& Context() {
+        return socket_->io_context_;
+    }
 private:
     Socket* socket_;
     void* buffer_;
@@ -117,27 +161,81 @@ public:
     Send(Socket* socket, void* buffer, std::size_t len) : AsyncSyscall(),
         socket_(socket), buffer_(buffer), len_(len) {
         socket_->io_context_.WatchWrite(socket_);
-        std::cout<<"socket send operation\n";
+        debug(), "socket send operation";
     }
     ~Send() {
         socket_->io_context_.UnwatchWrite(socket_);
-        std::cout<<"~ socket send operation\n";
+        debug(), "~socket send operation";
     }
 
     ssize_t Syscall() {
-        std::cout<<"send"<<socket_->fd_<<"\n";
-        return ::send(socket_->fd_, buffer_, len_, 0);
+        debug(), "send", socket_->fd_;
+        ssize_t n = ::send(socket_->fd_, buffer_, len_, 0);
+        if(n > 0) {
+            socket_->io_context_.metrics_.bytes_sent.add(n);
+        }
+        return n;
     }
 
     void SetCoroHandle() {
         socket_->coro_send_ = handle_;
     }
+
+    void ClearCoroHandle() {
+        socket_->coro_send_ = nullptr;
+    }
+
+    IoContext& Context() {
+        return socket_->io_context_;
+    }
 private:
     Socket* socket_;
     void* buffer_;
     std::size_t len_;
 };
 
+/*
+* 多块数据一起发送的waiter，和Send一样等可写事件
+*
+*/
+class Writev : public AsyncSyscall<Writev, ssize_t> {
+public:
+    Writev(Socket* socket, const struct iovec* iov, int count) : AsyncSyscall(),
+        socket_(socket), iov_(iov), count_(count) {
+        socket_->io_context_.WatchWrite(socket_);
+        debug(), "socket writev operation";
+    }
+    ~Writev() {
+        socket_->io_context_.UnwatchWrite(socket_);
+        debug(), "~socket writev operation";
+    }
+
+    ssize_t Syscall() {
+        debug(), "writev", socket_->fd_;
+        ssize_t n = ::writev(socket_->fd_, iov_, count_);
+        if(n > 0) {
+            socket_->io_context_.metrics_.bytes_sent.add(n);
+        }
+        return n;
+    }
+
+    void SetCoroHandle() {
+        socket_->coro_send_ = handle_;
+    }
+
+    void ClearCoroHandle() {
+        socket_->coro_send_ = nullptr;
+    }
+
+    IoContext& Context() {
+        return socket_->io_context_;
+    }
+private:
+    Socket* socket_;
+    const struct iovec* iov_;
+    int count_;
+};
+
 /*
 * 接受数据waiter
 *
@@ -147,22 +245,34 @@ public:
     Recv(Socket* socket, void* buffer, size_t len): AsyncSyscall(), 
         socket_(socket), buffer_(buffer), len_(len) {
         socket_->io_context_.WatchRead(socket_);
-        std::cout<<"socket recv operation\n";
+        debug(), "socket recv operation";
     }
 
     ~Recv() {
         socket_->io_context_.UnwatchRead(socket_);
-        std::cout<<"~socket recv operation\n";
+        debug(), "~socket recv operation";
     }
 
     ssize_t Syscall() {
-        std::cout<<"recv fd="<<socket_->fd_<<"\n";
-        return ::recv(socket_->fd_, buffer_, len_, 0);
+        debug(), "recv", socket_->fd_;
+        ssize_t n = ::recv(socket_->fd_, buffer_, len_, 0);
+        if(n > 0) {
+            socket_->io_context_.metrics_.bytes_received.add(n);
+        }
+        return n;
     }
     
     void SetCoroHandle() {
         socket_->coro_recv_ = handle_;
     }
+
+    void ClearCoroHandle() {
+        socket_->coro_recv_ = nullptr;
+    }
+
+    IoContext& Context() {
+        return socket_->io_context_;
+    }
 private:
     Socket* socket_;
     void* buffer_;
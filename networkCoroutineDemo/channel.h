@@ -0,0 +1,321 @@
+#pragma once
+
+/*
+* 协程之间传递数据的有界多生产者多消费者通道
+*
+*   channel<int> ch{64};
+*   bool ok = co_await ch.send(42);          // 通道关闭时返回false
+*   std::optional<int> v = co_await ch.recv(); // 通道关闭并且数据取完之后返回nullopt
+*   ch.close();
+*
+* （1）快速路径：数据放在一个固定容量的无锁环形队列里（每个格子带序号的MPMC队列），
+*      有空位时send、有数据时recv直接在await_ready里完成，不加锁、不挂起、不分配内存；
+* （2）慢速路径：队列满了的send、队列空了的recv，把awaiter自己挂到等待链表上（侵入式，awaiter就在协程帧里），
+*      只有这时才加锁；
+* （3）每次send/recv成功之后检查有没有等待者，有的话把数据直接在队列和等待者之间搬运，然后唤醒等待者；
+*      等待者登记之后会再试一次队列，和唤醒方之间用seq_cst栅栏配对，所以不会丢失唤醒；
+* （4）等待者挂起时记录下当前线程的executor（IoContext、resume_queue），被唤醒时post回这个executor，
+*      所以同一个IoContext里的协程之间、不同线程之间都可以使用；没有executor时在唤醒方的线程上直接恢复；
+*
+*/
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <utility>
+
+#include "thread_pool.hpp"
+
+template<typename T>
+class channel {
+public:
+    // 容量向上取整到2的幂，至少是2
+    explicit channel(std::size_t capacity) {
+        std::size_t size = 2;
+        while(size < capacity) size <<= 1;
+        mask_ = size - 1;
+        cells_ = std::make_unique<Cell[]>(size);
+        for(std::size_t i = 0; i < size; ++i) {
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    channel(const channel&) = delete;
+
+    ~channel() {
+        std::optional<T> value;
+        while(TryPop(value)) {}
+    }
+
+    std::size_t capacity() const { return mask_ + 1; }
+
+    // 关闭之后send都返回false，recv把剩下的数据取完之后返回nullopt，正在等待的协程都会被唤醒
+    void close();
+
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+    // 等待链表上的节点
+    struct Waiter {
+        Waiter* next = nullptr;
+        std::coroutine_handle<> handle;
+        executor* exec = nullptr;
+        bool ok = false;
+    };
+
+    struct SendAwaiter : Waiter {
+        bool await_ready() {
+            if(ch.closed()) return true;
+            if(ch.TryPush(value)) {
+                this->ok = true;
+                ch.Transfer();
+                return true;
+            }
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> h) {
+            this->handle = h;
+            this->exec = executor::current();
+            return ch.ParkSender(this);
+        }
+
+        bool await_resume() const noexcept { return this->ok; }
+
+        channel& ch;
+        T value;
+    };
+
+    struct RecvAwaiter : Waiter {
+        bool await_ready() {
+            if(ch.TryPop(value)) {
+                this->ok = true;
+                ch.Transfer();
+                return true;
+            }
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> h) {
+            this->handle = h;
+            this->exec = executor::current();
+            return ch.ParkReceiver(this);
+        }
+
+        std::optional<T> await_resume() {
+            if(!this->ok) return std::nullopt;
+            return std::move(value);
+        }
+
+        channel& ch;
+        std::optional<T> value{};
+    };
+
+    SendAwaiter send(T value) { return SendAwaiter{{}, *this, std::move(value)}; }
+
+    RecvAwaiter recv() { return RecvAwaiter{{}, *this}; }
+private:
+    struct alignas(64) Cell {
+        std::atomic<std::size_t> seq;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* get() { return std::launder(reinterpret_cast<T*>(storage)); }
+    };
+
+    // 成功时把value移动进队列，失败时value不变
+    bool TryPush(T& value);
+    bool TryPop(std::optional<T>& value);
+
+    // 等待链表加锁之后，再试一次队列，还是不行才挂起
+    bool ParkSender(SendAwaiter* w);
+    bool ParkReceiver(RecvAwaiter* w);
+
+    // 在队列和等待者之间搬运数据，唤醒搬运完成的等待者
+    void Transfer();
+
+    static void Append(Waiter*& head, Waiter*& tail, Waiter* w) {
+        w->next = nullptr;
+        if(tail) tail->next = w; else head = w;
+        tail = w;
+    }
+
+    static Waiter* PopFront(Waiter*& head, Waiter*& tail) {
+        Waiter* w = head;
+        head = w->next;
+        if(!head) tail = nullptr;
+        return w;
+    }
+
+    static void Resume(Waiter* list) {
+        while(list) {
+            Waiter* w = list;
+            list = w->next;   // 恢复之后awaiter可能已经不存在了，先取next
+            if(w->exec) {
+                w->exec->post(w->handle);
+            } else {
+                w->handle.resume();
+            }
+        }
+    }
+
+    std::unique_ptr<Cell[]> cells_;
+    std::size_t mask_ = 0;
+    alignas(64) std::atomic<std::size_t> tail_{0};   // 下一个写入的位置
+    alignas(64) std::atomic<std::size_t> head_{0};   // 下一个读取的位置
+    alignas(64) std::atomic<std::size_t> waiting_{0}; // 等待链表上的节点个数，为0时快速路径不用加锁
+    std::atomic<bool> closed_{false};
+    std::mutex mutex_;                               // 只保护下面的等待链表
+    Waiter* senders_ = nullptr;
+    Waiter* senders_tail_ = nullptr;
+    Waiter* receivers_ = nullptr;
+    Waiter* receivers_tail_ = nullptr;
+};
+
+template<typename T>
+bool channel<T>::TryPush(T& value) {
+    std::size_t pos = tail_.load(std::memory_order_relaxed);
+    for(;;) {
+        Cell& cell = cells_[pos & mask_];
+        std::size_t seq = cell.seq.load(std::memory_order_acquire);
+        auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+        if(diff == 0) {
+            if(tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                ::new (cell.storage) T(std::move(value));
+                cell.seq.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if(diff < 0) {
+            return false;   // 满了
+        } else {
+            pos = tail_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template<typename T>
+bool channel<T>::TryPop(std::optional<T>& value) {
+    std::size_t pos = head_.load(std::memory_order_relaxed);
+    for(;;) {
+        Cell& cell = cells_[pos & mask_];
+        std::size_t seq = cell.seq.load(std::memory_order_acquire);
+        auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+        if(diff == 0) {
+            if(head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                T* p = cell.get();
+                value.emplace(std::move(*p));
+                p->~T();
+                cell.seq.store(pos + mask_ + 1, std::memory_order_release);
+                return true;
+            }
+        } else if(diff < 0) {
+            return false;   // 空了
+        } else {
+            pos = head_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template<typename T>
+bool channel<T>::ParkSender(SendAwaiter* w) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        waiting_.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(closed()) {
+            waiting_.fetch_sub(1, std::memory_order_relaxed);
+            w->ok = false;
+            return false;
+        }
+        if(!TryPush(w->value)) {
+            Append(senders_, senders_tail_, w);
+            return true;
+        }
+        waiting_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    w->ok = true;
+    Transfer();
+    return false;
+}
+
+template<typename T>
+bool channel<T>::ParkReceiver(RecvAwaiter* w) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        waiting_.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool popped = TryPop(w->value);
+        if(!popped && !closed()) {
+            Append(receivers_, receivers_tail_, w);
+            return true;
+        }
+        waiting_.fetch_sub(1, std::memory_order_relaxed);
+        w->ok = popped;
+        if(!popped) return false;
+    }
+    Transfer();
+    return false;
+}
+
+template<typename T>
+void channel<T>::Transfer() {
+    // 和ParkSender/ParkReceiver里的栅栏配对：要么对方登记之后能看到队列的变化，要么这里能看到对方登记了
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(waiting_.load(std::memory_order_relaxed) == 0) return;
+
+    Waiter* ready = nullptr;
+    Waiter* ready_tail = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool progress = true;
+        while(progress) {
+            progress = false;
+            while(receivers_ && TryPop(static_cast<RecvAwaiter*>(receivers_)->value)) {
+                Waiter* w = PopFront(receivers_, receivers_tail_);
+                w->ok = true;
+                Append(ready, ready_tail, w);
+                progress = true;
+            }
+            while(senders_ && TryPush(static_cast<SendAwaiter*>(senders_)->value)) {
+                Waiter* w = PopFront(senders_, senders_tail_);
+                w->ok = true;
+                Append(ready, ready_tail, w);
+                progress = true;
+            }
+        }
+        for(Waiter* w = ready; w; w = w->next) {
+            waiting_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+    Resume(ready);   // 在锁外恢复，被恢复的协程可能马上又来send/recv
+}
+
+template<typename T>
+void channel<T>::close() {
+    closed_.store(true, std::memory_order_release);
+    Transfer();   // 先把能交付的数据交付掉
+
+    Waiter* ready = nullptr;
+    Waiter* ready_tail = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // 剩下的接收者等不到数据了，剩下的发送者也发不出去了
+        while(receivers_) {
+            Waiter* w = PopFront(receivers_, receivers_tail_);
+            w->ok = false;
+            Append(ready, ready_tail, w);
+        }
+        while(senders_) {
+            Waiter* w = PopFront(senders_, senders_tail_);
+            w->ok = false;
+            Append(ready, ready_tail, w);
+        }
+        for(Waiter* w = ready; w; w = w->next) {
+            waiting_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+    Resume(ready);
+}
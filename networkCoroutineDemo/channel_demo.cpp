@@ -0,0 +1,116 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "io_context.h"
+#include "channel.h"
+#include "task.h"
+
+/*
+* channel的demo
+* （1）同一个IoContext里的生产者和消费者协程；
+* （2）多个线程上的生产者协程（每个线程一个resume_queue）把数据发给IoContext线程上的消费者协程；
+*
+* 用法：coro_channel [生产者线程数] [每个生产者发送的个数] [通道容量]
+*
+*/
+
+task<bool> producer(channel<std::uint64_t>& ch, std::uint64_t first, std::uint64_t count,
+    std::atomic<int>& running) {
+    for(std::uint64_t i = 0; i < count; ++i) {
+        if(!co_await ch.send(first + i)) {
+            co_return false;
+        }
+    }
+    // 最后一个生产者负责关闭通道
+    if(running.fetch_sub(1) == 1) {
+        ch.close();
+    }
+    co_return true;
+}
+
+task<bool> consumer(channel<std::uint64_t>& ch, IoContext& io_context,
+    std::uint64_t& received, std::uint64_t& sum) {
+    while(auto value = co_await ch.recv()) {
+        ++received;
+        sum += *value;
+    }
+    io_context.stop();
+    co_return true;
+}
+
+bool check(const char* name, std::uint64_t received, std::uint64_t sum, std::uint64_t n, double seconds) {
+    bool ok = received == n && sum == n * (n - 1) / 2;
+    std::cout<<name<<": received="<<received<<" sum="<<sum<<(ok ? " OK" : " MISMATCH");
+    if(seconds > 0) {
+        std::cout<<" Mmsg/s="<<received / seconds / 1e6;
+    }
+    std::cout<<"\n";
+    return ok;
+}
+
+// 同一个IoContext里：两个生产者，容量很小，双方会频繁地互相挂起和唤醒
+bool same_loop(std::uint64_t count) {
+    IoContext io_context;
+    channel<std::uint64_t> ch{4};
+    std::atomic<int> running{2};
+    std::uint64_t received = 0, sum = 0;
+
+    auto c = consumer(ch, io_context, received, sum);
+    auto p1 = producer(ch, 0, count, running);
+    auto p2 = producer(ch, count, count, running);
+    io_context.post(c.handle_);
+    io_context.post(p1.handle_);
+    io_context.post(p2.handle_);
+    io_context.run();
+
+    c.handle_.destroy();
+    p1.handle_.destroy();
+    p2.handle_.destroy();
+    return check("same loop", received, sum, 2 * count, 0);
+}
+
+bool cross_thread(int threads, std::uint64_t count, std::size_t capacity) {
+    IoContext io_context;
+    channel<std::uint64_t> ch{capacity};
+    std::atomic<int> running{threads};
+    std::uint64_t received = 0, sum = 0;
+
+    // 消费者要在IoContext线程上启动，这样它挂起时记录下的executor才是IoContext
+    auto c = consumer(ch, io_context, received, sum);
+    io_context.post(c.handle_);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for(int i = 0; i < threads; ++i) {
+        workers.emplace_back([&, i] {
+            resume_queue queue;
+            auto p = producer(ch, i * count, count, running);
+            p.resume();
+            while(!p.handle_.done()) {
+                queue.run_one();
+            }
+            p.handle_.destroy();
+        });
+    }
+    io_context.run();
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for(auto& t : workers) {
+        t.join();
+    }
+
+    c.handle_.destroy();
+    return check("cross thread", received, sum, threads * count, seconds);
+}
+
+int main(int argc, char* argv[]) {
+    int threads = argc > 1 ? std::atoi(argv[1]) : 4;
+    std::uint64_t count = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+    std::size_t capacity = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 1024;
+
+    bool ok = same_loop(10000);
+    ok = cross_thread(threads, count, capacity) && ok;
+    return ok ? 0 : 1;
+}
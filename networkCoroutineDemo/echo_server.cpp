@@ -1,5 +1,10 @@
 #include "io_context.h"
 #include "awaiters.h"
+#include "async_scope.h"
+#if CORO_SAMPLE
+#include <csignal>
+#include <fstream>
+#endif
 
 /*
 * co_await的作用：形成嵌套协程的调用链
@@ -41,16 +46,32 @@ task<> echo_socket(std::shared_ptr<Socket> socket) {
 }
 
 task<> accept(Socket& listen) {
+    async_scope connections;
     for(;;) {
         auto socket = co_await listen.accept();
-        auto t = echo_socket(socket);
-        t.resume();    //这里用的不是co_await，所以不会和echo_socket协程有调用链关系
+        //每个连接是scope的一个子协程，连接结束时协程帧马上被销毁，socket也随之关闭
+        connections.spawn(echo_socket(socket));
+        std::cout<<"active connections "<<connections.active()<<"\n";
     }
 }
 
+#if CORO_SAMPLE
+//Ctrl+C停止事件循环，把采样导出到coro_epoll.folded；stop()里只有原子写和write()，可以在信号处理函数里调用
+static IoContext* g_io_context = nullptr;
+
+static void on_interrupt(int) {
+    g_io_context->stop();
+}
+#endif
+
 int main() {
     //创建上下文
     IoContext io_context;
+#if CORO_SAMPLE
+    g_io_context = &io_context;
+    std::signal(SIGINT, on_interrupt);
+    coro_sampler::start();
+#endif
 
     Socket listen{"10009", io_context};
 
@@ -59,4 +80,9 @@ int main() {
     t.resume();       //这里用的不是co_await，所以不会和echo_socket协程有调用链关系，当co_await listen.accept();挂起之后就会回到这里继续往下执行
 
     io_context.run(); // 启动事件循环
+#if CORO_SAMPLE
+    coro_sampler::stop();
+    std::ofstream folded("coro_epoll.folded");
+    std::cout<<"samples "<<coro_sampler::writeFolded(folded)<<" -> coro_epoll.folded\n";
+#endif
 }
@@ -0,0 +1,71 @@
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <string_view>
+#include "io_context.h"
+#include "async_file.h"
+#include "task.h"
+
+/*
+* 异步文件I/O的demo：写入、fsync、再读回来，全程不阻塞事件循环
+*
+* 用法：coro_file [文件路径] [--no-uring]
+*
+*/
+
+task<bool> direct_io(IoContext& io_context, const char* path) {
+    AsyncFile file{io_context, path, O_RDWR | O_CREAT | O_TRUNC, 0644, true};
+    AlignedBuffer buffer{file.alignment(), file.alignment()};
+    std::memset(buffer.data(), 'x', buffer.size());
+
+    ssize_t n = co_await file.write_at(0, buffer.span());
+    std::cout<<"O_DIRECT write_at "<<n<<"\n";
+    n = co_await file.read_at(0, buffer.span());
+    std::cout<<"O_DIRECT read_at "<<n<<"\n";
+
+    // 没有对齐的缓冲区会直接失败
+    n = co_await file.read_at(1, buffer.span().subspan(1));
+    std::cout<<"O_DIRECT unaligned read_at "<<n<<" errno="<<errno<<"\n";
+    co_return true;
+}
+
+task<> file_demo(IoContext& io_context, const char* path) {
+    {
+        AsyncFile file{io_context, path, O_RDWR | O_CREAT | O_TRUNC};
+
+        std::string_view text = "hello, async file\n";
+        ssize_t n = co_await file.write_at(0, std::as_bytes(std::span{text}));
+        std::cout<<"write_at "<<n<<"\n";
+
+        n = co_await file.fsync();
+        std::cout<<"fsync "<<n<<"\n";
+
+        char buffer[64] = {0};
+        n = co_await file.read_at(0, std::as_writable_bytes(std::span{buffer}));
+        std::cout<<"read_at "<<n<<": "<<buffer;
+    }
+
+    // tmpfs等文件系统不支持O_DIRECT，打开文件会失败
+    std::string direct_path = std::string{path} + ".direct";
+    int fd = ::open(direct_path.c_str(), O_RDWR | O_CREAT | O_DIRECT, 0644);
+    if(fd == -1) {
+        std::cout<<"O_DIRECT not supported here\n";
+    } else {
+        ::close(fd);
+        co_await direct_io(io_context, direct_path.c_str());
+    }
+
+    io_context.stop();
+}
+
+int main(int argc, char* argv[]) {
+    const char* path = argc > 1 ? argv[1] : "file_demo.txt";
+    bool use_uring = !(argc > 2 && std::strcmp(argv[2], "--no-uring") == 0);
+
+    IoContext io_context{use_uring};
+
+    auto t = file_demo(io_context, path);
+    t.resume();
+
+    io_context.run();
+}
@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <latch>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*
+* HTTP服务器的压测客户端：几个线程，每个线程用epoll驱动一组keep-alive连接
+* 客户端不用协程运行时，避免把客户端自己的开销算到被测的服务器头上
+*
+* 每个连接循环：一次write发出pipeline个请求 -> 收齐pipeline个响应 -> 记下这一批的往返时间 -> 发下一批
+* 结束时输出每秒请求数、每秒收到的字节数、每批往返时间的分位数，以及错误数（连接断开、非2xx响应）
+*
+* 用法：coro_http_bench [port] [connections] [pipeline] [seconds] [threads] [path]
+*       默认 10012 64 1 10 2 /plaintext，只连127.0.0.1
+*
+* 和其他C++服务器比较：
+* （1）同一台机器、同样的编译选项（Release，coro_http的stderr重定向到文件），服务器和客户端用taskset绑在不同的核上，
+*      例如 taskset -c 0 ./coro_http 和 taskset -c 2,3 ./coro_http_bench 10012 64 16；
+*      coro_http只有一个事件循环线程，对方也配成一个线程（或者都按核数扩展，线程数相同）；
+* （2）对方实现同样的GET /plaintext（13字节的"Hello, World!"），用这个客户端、同样的参数各测几轮取中位数；
+* （3）也可以用wrk交叉验证：wrk -t2 -c64 -d10s --latency http://127.0.0.1:10012/plaintext，管线化用wrk的pipeline.lua
+*
+*/
+
+using std::chrono::steady_clock;
+
+namespace {
+
+constexpr std::size_t kLatencyBuckets = 100000;    // 每批往返时间按微秒分桶，100ms以上都算在最后一个桶里
+constexpr std::size_t kBufferSize = 64 * 1024;
+
+struct Options {
+    std::string port = "10012";
+    int connections = 64;
+    int pipeline = 1;
+    int seconds = 10;
+    int threads = 2;
+    std::string path = "/plaintext";
+};
+
+struct Result {
+    std::uint64_t requests = 0;
+    std::uint64_t bytes = 0;
+    std::uint64_t errors = 0;
+    std::uint64_t non2xx = 0;
+    std::uint64_t max_us = 0;
+    std::vector<std::uint64_t> latency = std::vector<std::uint64_t>(kLatencyBuckets);
+
+    void merge(const Result& other) {
+        requests += other.requests;
+        bytes += other.bytes;
+        errors += other.errors;
+        non2xx += other.non2xx;
+        max_us = std::max(max_us, other.max_us);
+        for(std::size_t i = 0; i < kLatencyBuckets; ++i) {
+            latency[i] += other.latency[i];
+        }
+    }
+};
+
+struct Connection {
+    int fd = -1;
+    int outstanding = 0;                    // 这一批还没收到的响应数
+    steady_clock::time_point sent_at;
+    std::vector<char> buffer = std::vector<char>(kBufferSize);
+    std::size_t used = 0;
+};
+
+int Connect(const std::string& port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<std::uint16_t>(std::atoi(port.c_str())));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(fd == -1 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1) {
+        std::perror("connect");
+        std::exit(1);
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    ::fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+// Content-Length的名字不区分大小写
+std::size_t ContentLength(std::string_view head) {
+    constexpr std::string_view name = "content-length:";
+    for(std::size_t pos = head.find('\n'); pos != std::string_view::npos; pos = head.find('\n', pos + 1)) {
+        auto line = head.substr(pos + 1);
+        if(line.size() < name.size()) break;
+        bool match = true;
+        for(std::size_t i = 0; i < name.size() && match; ++i) {
+            match = (line[i] | 0x20) == name[i];
+        }
+        if(match) {
+            return std::strtoull(line.data() + name.size(), nullptr, 10);
+        }
+    }
+    return 0;
+}
+
+bool SendBatch(Connection& c, const std::string& batch) {
+    // 上一批的响应都收到了才发下一批，发送缓冲区是空的，一次write能写完
+    c.sent_at = steady_clock::now();
+    c.outstanding = 0;
+    ssize_t n = ::write(c.fd, batch.data(), batch.size());
+    return n == static_cast<ssize_t>(batch.size());
+}
+
+// 解析已经收到的完整响应，返回false表示连接出错
+bool Consume(Connection& c, int pipeline, Result& result) {
+    std::size_t pos = 0;
+    while(c.outstanding < pipeline) {
+        std::string_view data{c.buffer.data() + pos, c.used - pos};
+        auto head_end = data.find("\r\n\r\n");
+        if(head_end == std::string_view::npos) break;
+        std::size_t total = head_end + 4 + ContentLength(data.substr(0, head_end + 2));
+        if(total > data.size()) break;
+        if(data.size() < 12 || data[9] != '2') {
+            ++result.non2xx;
+        }
+        ++c.outstanding;
+        pos += total;
+    }
+    std::memmove(c.buffer.data(), c.buffer.data() + pos, c.used - pos);
+    c.used -= pos;
+    return c.used < c.buffer.size();   // 缓冲区满了还凑不出一个响应，说明响应太大或者格式不对
+}
+
+void Run(const Options& options, int connections, std::latch& ready, steady_clock::time_point& deadline, Result& result) {
+    std::string batch;
+    for(int i = 0; i < options.pipeline; ++i) {
+        batch += "GET " + options.path + " HTTP/1.1\r\nHost: 127.0.0.1\r\nAccept: */*\r\n\r\n";
+    }
+
+    int epfd = ::epoll_create1(0);
+    std::vector<Connection> conns(connections);
+    for(auto& c : conns) {
+        c.fd = Connect(options.port);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = &c;
+        ::epoll_ctl(epfd, EPOLL_CTL_ADD, c.fd, &ev);
+    }
+    ready.arrive_and_wait();   // 所有线程都连上以后一起开始
+
+    auto drop = [&](Connection& c) {
+        ++result.errors;
+        ::epoll_ctl(epfd, EPOLL_CTL_DEL, c.fd, nullptr);
+        ::close(c.fd);
+        c.fd = -1;
+    };
+    for(auto& c : conns) {
+        if(!SendBatch(c, batch)) drop(c);
+    }
+
+    epoll_event events[256];
+    while(steady_clock::now() < deadline) {
+        int n = ::epoll_wait(epfd, events, 256, 10);
+        for(int i = 0; i < n; ++i) {
+            auto& c = *static_cast<Connection*>(events[i].data.ptr);
+            if(c.fd == -1) continue;
+            ssize_t len = ::recv(c.fd, c.buffer.data() + c.used, c.buffer.size() - c.used, 0);
+            if(len <= 0) {
+                if(len == -1 && errno == EAGAIN) continue;
+                drop(c);
+                continue;
+            }
+            c.used += len;
+            result.bytes += len;
+            if(!Consume(c, options.pipeline, result)) {
+                drop(c);
+                continue;
+            }
+            if(c.outstanding < options.pipeline) continue;
+
+            auto now = steady_clock::now();
+            if(now >= deadline) break;
+            auto us = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - c.sent_at).count());
+            ++result.latency[std::min<std::uint64_t>(us, kLatencyBuckets - 1)];
+            result.max_us = std::max(result.max_us, us);
+            result.requests += options.pipeline;
+            if(!SendBatch(c, batch)) drop(c);
+        }
+    }
+
+    for(auto& c : conns) {
+        if(c.fd != -1) ::close(c.fd);
+    }
+    ::close(epfd);
+}
+
+std::uint64_t Percentile(const Result& result, double p) {
+    std::uint64_t total = 0;
+    for(auto n : result.latency) total += n;
+    auto target = static_cast<std::uint64_t>(static_cast<double>(total) * p);
+    std::uint64_t seen = 0;
+    for(std::size_t i = 0; i < kLatencyBuckets; ++i) {
+        seen += result.latency[i];
+        if(seen > target) return i;
+    }
+    return result.max_us;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if(argc > 1) options.port = argv[1];
+    if(argc > 2) options.connections = std::max(1, std::atoi(argv[2]));
+    if(argc > 3) options.pipeline = std::clamp(std::atoi(argv[3]), 1, 256);
+    if(argc > 4) options.seconds = std::max(1, std::atoi(argv[4]));
+    if(argc > 5) options.threads = std::clamp(std::atoi(argv[5]), 1, options.connections);
+    if(argc > 6) options.path = argv[6];
+
+    std::cout<<"127.0.0.1:"<<options.port<<options.path<<" connections="<<options.connections
+        <<" pipeline="<<options.pipeline<<" threads="<<options.threads<<" seconds="<<options.seconds<<"\n";
+
+    std::vector<Result> results(options.threads);
+    std::vector<std::thread> threads;
+    std::latch ready{options.threads + 1};
+    steady_clock::time_point deadline = steady_clock::time_point::max();
+    for(int i = 0; i < options.threads; ++i) {
+        // 连接尽量平均分给各个线程
+        int connections = options.connections / options.threads + (i < options.connections % options.threads ? 1 : 0);
+        threads.emplace_back([&, i, connections] { Run(options, connections, ready, deadline, results[i]); });
+    }
+    // 所有线程都在arrive_and_wait()之后才读deadline，latch保证能看到这里的写
+    deadline = steady_clock::now() + std::chrono::seconds(options.seconds);
+    auto start = steady_clock::now();
+    ready.arrive_and_wait();
+    for(auto& t : threads) t.join();
+    double elapsed = std::chrono::duration<double>(steady_clock::now() - start).count();
+
+    Result total;
+    for(const auto& r : results) total.merge(r);
+
+    std::cout<<std::fixed<<std::setprecision(0)
+        <<"requests "<<total.requests<<" in "<<std::setprecision(2)<<elapsed<<"s, errors "<<total.errors
+        <<", non-2xx "<<total.non2xx<<"\n"
+        <<std::setprecision(0)<<"requests/sec "<<static_cast<double>(total.requests) / elapsed
+        <<", received "<<std::setprecision(2)<<static_cast<double>(total.bytes) / elapsed / (1 << 20)<<" MiB/s\n"
+        <<"batch latency (us) p50 "<<Percentile(total, 0.5)<<" p90 "<<Percentile(total, 0.9)
+        <<" p99 "<<Percentile(total, 0.99)<<" p99.9 "<<Percentile(total, 0.999)<<" max "<<total.max_us<<"\n";
+}
@@ -0,0 +1,48 @@
+#include <csignal>
+#include <iostream>
+#include <string>
+#include "io_context.h"
+#include "http_server.h"
+
+/*
+* HTTP/1.1服务器的demo，也是http_bench.cpp压测的对象
+*
+*   GET /plaintext   返回"Hello, World!"（和TechEmpower的plaintext测试一样）
+*   GET /            返回一行说明
+*   POST /echo       把请求的body原样返回
+*   其他             404
+*
+* 用法：coro_http [port]，默认10012
+*   curl -v http://127.0.0.1:10012/plaintext
+*   printf 'GET /plaintext HTTP/1.1\r\nHost: x\r\n\r\nGET / HTTP/1.1\r\nHost: x\r\n\r\n' | nc 127.0.0.1 10012   // 管线化
+*
+* 压测时用 -DCMAKE_BUILD_TYPE=Release 编译；每次recv/send都会记一条debug()日志，压测时把stderr重定向到文件
+*
+*/
+
+int main(int argc, char* argv[]) {
+    std::string port = argc > 1 ? argv[1] : "10012";
+
+    // 对端关闭以后再写会收到SIGPIPE，默认会杀掉进程
+    std::signal(SIGPIPE, SIG_IGN);
+
+    HttpServer server{[](const http_request& request, http_response& response) {
+        if(request.target == "/plaintext") {
+            response.body = "Hello, World!";
+        } else if(request.target == "/") {
+            response.body = "coroutine http server: GET /plaintext, POST /echo\n";
+        } else if(request.target == "/echo" && request.method == "POST") {
+            response.content_type = "application/octet-stream";
+            response.body = request.body;   // 指向接收缓冲区，发完之前不会被覆盖
+        } else {
+            response.status = 404;
+            response.reason = "Not Found";
+        }
+    }};
+
+    IoContext io_context;
+    auto t = server.serve(io_context, port);
+    t.resume();
+    std::cout<<"listening on "<<port<<"\n";
+    io_context.run();
+}
@@ -0,0 +1,443 @@
+/*
+* http_parser.h中函数的实现
+*
+*/
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include "http_parser.h"
+
+// SIMD的实现用函数的target属性编译，不需要给整个文件加-mavx2，运行时再按CPUID选择
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define HTTP_PARSER_X86 1
+#include <immintrin.h>
+#else
+#define HTTP_PARSER_X86 0
+#endif
+
+namespace {
+
+// 每个字符是否属于某一类，按字符查表
+using CharTable = std::array<bool, 256>;
+
+// 头部名字和method：RFC 9110里的token
+constexpr CharTable TokenChars = [] {
+    CharTable table{};
+    for(int c = '0'; c <= '9'; ++c) table[c] = true;
+    for(int c = 'a'; c <= 'z'; ++c) table[c] = true;
+    for(int c = 'A'; c <= 'Z'; ++c) table[c] = true;
+    for(char c : std::string_view{"!#$%&'*+-.^_`|~"}) table[static_cast<unsigned char>(c)] = true;
+    return table;
+}();
+
+// 请求行里的target：除了空格和控制字符之外都接受，合法性交给处理请求的人判断
+constexpr CharTable TargetChars = [] {
+    CharTable table{};
+    for(int c = 0x21; c < 0x100; ++c) table[c] = c != 0x7f;
+    return table;
+}();
+
+// 头部的值：可见字符、空格、HTAB和obs-text
+constexpr CharTable ValueChars = [] {
+    CharTable table = TargetChars;
+    table[' '] = true;
+    table['\t'] = true;
+    return table;
+}();
+
+const char* Scan(const char* p, const char* end, const CharTable& table) {
+    while(p != end && table[static_cast<unsigned char>(*p)]) {
+        ++p;
+    }
+    return p;
+}
+
+/*
+* 三种字符集各有一个扫描函数，返回第一个不属于字符集的位置，都不是时返回end
+* SIMD的版本按块处理，剩下不够一块的尾巴交给查表
+*
+*/
+struct ScalarScan {
+    static const char* Token(const char* p, const char* end) { return Scan(p, end, TokenChars); }
+    static const char* Target(const char* p, const char* end) { return Scan(p, end, TargetChars); }
+    static const char* Value(const char* p, const char* end) { return Scan(p, end, ValueChars); }
+};
+
+#if HTTP_PARSER_X86
+
+/*
+* token的字符集不是几个连续的范围，用半字节查表：
+* 高半字节为h的字符对应第h - 2位（token字符的高半字节只有2到7），
+* LowNibbles[l]里是所有"低半字节为l的token字符"的高半字节对应的位，两次pshufb的结果相与不为0就是token字符
+* 0x80以上的字符高半字节查到的是0
+*
+*/
+struct NibbleTables {
+    alignas(16) std::uint8_t low[16] = {};
+    alignas(16) std::uint8_t high[16] = {};
+};
+
+constexpr NibbleTables TokenNibbles = [] {
+    NibbleTables tables;
+    for(int h = 2; h <= 7; ++h) {
+        tables.high[h] = static_cast<std::uint8_t>(1 << (h - 2));
+    }
+    for(int c = 0; c < 0x80; ++c) {
+        if(TokenChars[c]) {
+            tables.low[c & 0x0f] |= tables.high[c >> 4];
+        }
+    }
+    return tables;
+}();
+
+static_assert([] {
+    for(int c = 0; c < 0x100; ++c) {
+        bool in_table = c < 0x80 && (TokenNibbles.low[c & 0x0f] & TokenNibbles.high[c >> 4]) != 0;
+        if(in_table != TokenChars[c]) return false;
+    }
+    return true;
+}(), "token nibble tables do not match TokenChars");
+
+struct Sse42Scan {
+    // 16个字节里不是token字符的位置
+    [[gnu::target("sse4.2")]] static int TokenStops(__m128i v) {
+        const __m128i low = _mm_load_si128(reinterpret_cast<const __m128i*>(TokenNibbles.low));
+        const __m128i high = _mm_load_si128(reinterpret_cast<const __m128i*>(TokenNibbles.high));
+        const __m128i nibble = _mm_set1_epi8(0x0f);
+        __m128i lo = _mm_shuffle_epi8(low, _mm_and_si128(v, nibble));
+        __m128i hi = _mm_shuffle_epi8(high, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128()));
+    }
+
+    [[gnu::target("sse4.2")]] static const char* Token(const char* p, const char* end) {
+        for(; end - p >= 16; p += 16) {
+            int stops = TokenStops(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+            if(stops != 0) return p + __builtin_ctz(stops);
+        }
+        return Scan(p, end, TokenChars);
+    }
+
+    // pcmpestri在16个字节里找第一个落在ranges里的字节，ranges是若干对[下限, 上限]，没有时返回16
+    template<int RangesLength>
+    [[gnu::target("sse4.2")]] static const char* FindRanges(const char* p, const char* end, const char* ranges) {
+        const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ranges));
+        for(; end - p >= 16; p += 16) {
+            int i = _mm_cmpestri(r, RangesLength, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), 16,
+                _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+            if(i != 16) return p + i;
+        }
+        return p;
+    }
+
+    // target在空格、控制字符和DEL处结束
+    [[gnu::target("sse4.2")]] static const char* Target(const char* p, const char* end) {
+        alignas(16) static const char ranges[16] = "\x00\x20\x7f\x7f";
+        return Scan(FindRanges<4>(p, end, ranges), end, TargetChars);
+    }
+
+    // 值在除HTAB以外的控制字符和DEL处结束
+    [[gnu::target("sse4.2")]] static const char* Value(const char* p, const char* end) {
+        alignas(16) static const char ranges[16] = "\x00\x08\x0a\x1f\x7f\x7f";
+        return Scan(FindRanges<6>(p, end, ranges), end, ValueChars);
+    }
+};
+
+struct Avx2Scan {
+    [[gnu::target("avx2")]] static const char* Token(const char* p, const char* end) {
+        const __m256i low = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(TokenNibbles.low)));
+        const __m256i high = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(TokenNibbles.high)));
+        const __m256i nibble = _mm256_set1_epi8(0x0f);
+        for(; end - p >= 32; p += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            __m256i lo = _mm256_shuffle_epi8(low, _mm256_and_si256(v, nibble));
+            __m256i hi = _mm256_shuffle_epi8(high, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+            auto stops = static_cast<unsigned>(_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), _mm256_setzero_si256())));
+            if(stops != 0) return p + __builtin_ctz(stops);
+        }
+        return Sse42Scan::Token(p, end);
+    }
+
+    // c <= limit（无符号）的字节：min(c, limit) == c
+    [[gnu::target("avx2")]] static __m256i AtMost(__m256i v, char limit) {
+        return _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(limit)), v);
+    }
+
+    [[gnu::target("avx2")]] static const char* Target(const char* p, const char* end) {
+        const __m256i del = _mm256_set1_epi8(0x7f);
+        for(; end - p >= 32; p += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            __m256i stop = _mm256_or_si256(AtMost(v, 0x20), _mm256_cmpeq_epi8(v, del));
+            auto stops = static_cast<unsigned>(_mm256_movemask_epi8(stop));
+            if(stops != 0) return p + __builtin_ctz(stops);
+        }
+        return Scan(p, end, TargetChars);
+    }
+
+    [[gnu::target("avx2")]] static const char* Value(const char* p, const char* end) {
+        const __m256i del = _mm256_set1_epi8(0x7f);
+        const __m256i tab = _mm256_set1_epi8('\t');
+        for(; end - p >= 32; p += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            __m256i control = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, tab), AtMost(v, 0x1f));
+            __m256i stop = _mm256_or_si256(control, _mm256_cmpeq_epi8(v, del));
+            auto stops = static_cast<unsigned>(_mm256_movemask_epi8(stop));
+            if(stops != 0) return p + __builtin_ctz(stops);
+        }
+        return Scan(p, end, ValueChars);
+    }
+};
+
+#endif // HTTP_PARSER_X86
+
+// 吃掉一个CRLF或者LF：1成功，0数据不够，-1不是行尾
+int EatLineEnd(const char*& p, const char* end) {
+    if(p == end) return 0;
+    if(*p == '\n') {
+        ++p;
+        return 1;
+    }
+    if(*p != '\r') return -1;
+    if(p + 1 == end) return 0;
+    if(p[1] != '\n') return -1;
+    p += 2;
+    return 1;
+}
+
+// 数据不够时，已经收到的部分要和"HTTP/1."对得上，否则马上就能判断出格式错误
+int ParseVersion(const char*& p, const char* end, int& minor_version) {
+    constexpr std::string_view prefix = "HTTP/1.";
+    std::size_t available = static_cast<std::size_t>(end - p);
+    if(available <= prefix.size()) {
+        return std::memcmp(p, prefix.data(), available) == 0 ? 0 : -1;
+    }
+    if(std::memcmp(p, prefix.data(), prefix.size()) != 0 || (p[7] != '0' && p[7] != '1')) {
+        return -1;
+    }
+    minor_version = p[7] - '0';
+    p += prefix.size() + 1;
+    return EatLineEnd(p, end);
+}
+
+// Content-Length只能是十进制数字，太长的直接拒绝，不用处理溢出
+bool ParseLength(std::string_view value, std::size_t& length) {
+    if(value.empty() || value.size() > 18) return false;
+    std::size_t n = 0;
+    for(char c : value) {
+        if(c < '0' || c > '9') return false;
+        n = n * 10 + static_cast<std::size_t>(c - '0');
+    }
+    length = n;
+    return true;
+}
+
+// Connection的值是逗号分隔的一串选项
+void ParseConnection(std::string_view value, bool& keep_alive) {
+    while(!value.empty()) {
+        auto comma = value.find(',');
+        auto option = value.substr(0, comma);
+        while(!option.empty() && (option.front() == ' ' || option.front() == '\t')) option.remove_prefix(1);
+        while(!option.empty() && (option.back() == ' ' || option.back() == '\t')) option.remove_suffix(1);
+        if(iequals(option, "close")) {
+            keep_alive = false;
+        } else if(iequals(option, "keep-alive")) {
+            keep_alive = true;
+        }
+        if(comma == std::string_view::npos) break;
+        value.remove_prefix(comma + 1);
+    }
+}
+
+} // namespace
+
+bool iequals(std::string_view lhs, std::string_view rhs) {
+    if(lhs.size() != rhs.size()) return false;
+    for(std::size_t i = 0; i < lhs.size(); ++i) {
+        // 或上0x20以后相等、而且是字母，才是同一个字母的大小写
+        char a = lhs[i], b = rhs[i];
+        if(a == b) continue;
+        if((a | 0x20) != (b | 0x20) || (a | 0x20) < 'a' || (a | 0x20) > 'z') return false;
+    }
+    return true;
+}
+
+std::string_view http_request::header(std::string_view name) const {
+    for(std::size_t i = 0; i < header_count; ++i) {
+        if(iequals(headers[i].name, name)) {
+            return headers[i].value;
+        }
+    }
+    return {};
+}
+
+namespace {
+
+// 三个实现共用的解析过程，只有扫描函数不一样；always_inline让它整个展开到各自带target属性的入口函数里
+template<typename Scanner>
+[[gnu::always_inline]] inline int Parse(const char* data, std::size_t len, http_request& request) {
+    const char* p = data;
+    const char* end = data + len;
+    request.header_count = 0;
+    request.content_length = 0;
+    request.header_length = 0;
+    request.body = {};
+    request.chunked = false;
+
+    // 请求之前多出来的空行要忽略（RFC 9112 2.2），有的客户端在POST的body后面会多发一个CRLF
+    while(p != end && (*p == '\r' || *p == '\n')) {
+        ++p;
+    }
+
+    // 请求行：method SP target SP HTTP/1.x
+    const char* start = p;
+    p = Scanner::Token(p, end);
+    if(p == end) return 0;
+    if(*p != ' ' || p == start) return -1;
+    request.method = {start, static_cast<std::size_t>(p - start)};
+
+    start = ++p;
+    p = Scanner::Target(p, end);
+    if(p == end) return 0;
+    if(*p != ' ' || p == start) return -1;
+    request.target = {start, static_cast<std::size_t>(p - start)};
+
+    ++p;
+    if(int r = ParseVersion(p, end, request.minor_version); r <= 0) return r;
+    request.keep_alive = request.minor_version == 1;
+
+    // 头部：name ":" OWS value OWS，空行结束
+    bool has_length = false;
+    for(;;) {
+        if(p == end) return 0;
+        if(*p == '\r' || *p == '\n') {
+            if(int r = EatLineEnd(p, end); r <= 0) return r;
+            break;
+        }
+        if(request.header_count == http_request::max_headers) return -1;
+
+        start = p;
+        p = Scanner::Token(p, end);
+        if(p == end) return 0;
+        if(*p != ':' || p == start) return -1;   // 名字后面不能有空格，行首是空格时就是折行
+        std::string_view name{start, static_cast<std::size_t>(p - start)};
+
+        ++p;
+        while(p != end && (*p == ' ' || *p == '\t')) {
+            ++p;
+        }
+        start = p;
+        p = Scanner::Value(p, end);
+        if(p == end) return 0;
+        const char* value_end = p;
+        while(value_end != start && (value_end[-1] == ' ' || value_end[-1] == '\t')) {
+            --value_end;
+        }
+        if(int r = EatLineEnd(p, end); r <= 0) return r;
+        std::string_view value{start, static_cast<std::size_t>(value_end - start)};
+        request.headers[request.header_count++] = {name, value};
+
+        // 只关心三个头部，先按长度分开，大多数头部一次比较都不用做
+        switch(name.size()) {
+        case 14:
+            if(iequals(name, "content-length")) {
+                std::size_t length = 0;
+                if(!ParseLength(value, length) || (has_length && length != request.content_length)) return -1;
+                request.content_length = length;
+                has_length = true;
+            }
+            break;
+        case 10:
+            if(iequals(name, "connection")) {
+                ParseConnection(value, request.keep_alive);
+            }
+            break;
+        case 17:
+            if(iequals(name, "transfer-encoding")) {
+                request.chunked = true;
+            }
+            break;
+        }
+    }
+
+    std::size_t header_length = static_cast<std::size_t>(p - data);
+    request.header_length = header_length;
+    if(request.chunked) {
+        request.content_length = 0;
+        return static_cast<int>(header_length);
+    }
+    if(request.content_length > static_cast<std::size_t>(end - p)) return 0;
+    request.body = {p, request.content_length};
+    return static_cast<int>(header_length + request.content_length);
+}
+
+int ParseScalar(const char* data, std::size_t len, http_request& request) {
+    return Parse<ScalarScan>(data, len, request);
+}
+
+#if HTTP_PARSER_X86
+
+[[gnu::target("sse4.2"), gnu::flatten]] int ParseSse42(const char* data, std::size_t len, http_request& request) {
+    return Parse<Sse42Scan>(data, len, request);
+}
+
+[[gnu::target("avx2"), gnu::flatten]] int ParseAvx2(const char* data, std::size_t len, http_request& request) {
+    return Parse<Avx2Scan>(data, len, request);
+}
+
+#endif
+
+using ParseFunction = int (*)(const char*, std::size_t, http_request&);
+
+ParseFunction Select(http_parser_isa isa) {
+    switch(isa) {
+#if HTTP_PARSER_X86
+    case http_parser_isa::avx2: return ParseAvx2;
+    case http_parser_isa::sse42: return ParseSse42;
+#endif
+    default: return ParseScalar;
+    }
+}
+
+// 程序启动时选好，之后每次解析只是一次间接调用
+const ParseFunction BestParse = Select(best_parser_isa());
+
+} // namespace
+
+bool parser_isa_supported(http_parser_isa isa) {
+#if HTTP_PARSER_X86
+    __builtin_cpu_init();   // 在其他全局变量的初始化里调用时，CPUID的结果可能还没有准备好
+    switch(isa) {
+    case http_parser_isa::avx2: return __builtin_cpu_supports("avx2");
+    case http_parser_isa::sse42: return __builtin_cpu_supports("sse4.2");
+    case http_parser_isa::scalar: return true;
+    }
+    return false;
+#else
+    return isa == http_parser_isa::scalar;
+#endif
+}
+
+http_parser_isa best_parser_isa() {
+    for(auto isa : {http_parser_isa::avx2, http_parser_isa::sse42}) {
+        if(parser_isa_supported(isa)) return isa;
+    }
+    return http_parser_isa::scalar;
+}
+
+const char* to_string(http_parser_isa isa) {
+    switch(isa) {
+    case http_parser_isa::avx2: return "avx2";
+    case http_parser_isa::sse42: return "sse4.2";
+    case http_parser_isa::scalar: return "scalar";
+    }
+    return "?";
+}
+
+int parse_request(const char* data, std::size_t len, http_request& request) {
+    return BestParse(data, len, request);
+}
+
+int parse_request(const char* data, std::size_t len, http_request& request, http_parser_isa isa) {
+    return Select(isa)(data, len, request);
+}
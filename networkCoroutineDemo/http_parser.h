@@ -0,0 +1,66 @@
+#pragma once
+
+/*
+* 原地解析HTTP/1.x请求
+*
+*   http_request request;
+*   int n = parse_request(data, len, request);   // n > 0：一个完整的请求占了n个字节；0：还没收完；-1：格式错误
+*
+* （1）不拷贝也不分配内存：method、target、每个头部的名字和值都是指向data的string_view，
+*      头部放在http_request里的定长数组中，超过max_headers个时按格式错误处理；
+* （2）解析到的请求在data被覆盖之前有效，HttpServer里就是下一次recv之前；
+* （3）带Content-Length的请求要等body也收完才算完整，body同样指向data；
+*      Transfer-Encoding（chunked）的body不解析，只设置chunked，返回值只包括请求头；
+*      头部收完、body还没收完时返回0，但header_length和content_length已经填好，调用者可以提前判断body放不放得下；
+* （4）行尾可以是CRLF也可以是单独的LF；不接受头部的折行（obs-fold）
+* （5）找token、target和头部值的结束位置是主要的开销，x86上有三个实现，程序启动时按CPUID选好：
+*      avx2：一次比较32个字节，movemask得到停下来的位置；token的字符集用两次pshufb按高低半字节查表；
+*      sse42：target和值用pcmpestri按字符范围一次找16个字节，token同样用pshufb；
+*      scalar：逐个字节查表，其他平台只有这一个；
+*      三个实现的结果完全一样，http_parser_bench.cpp在测速度之前会先用变异的请求对比一遍
+*
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+struct http_header {
+    std::string_view name;
+    std::string_view value;
+};
+
+struct http_request {
+    constexpr static std::size_t max_headers = 32;
+
+    std::string_view method;
+    std::string_view target;
+    int minor_version = 1;                  // HTTP/1.0还是HTTP/1.1
+    http_header headers[max_headers];
+    std::size_t header_count = 0;
+    std::size_t content_length = 0;
+    std::size_t header_length = 0;          // 请求行到空行的长度，头部还没收完时是0
+    std::string_view body;
+    bool keep_alive = true;                 // HTTP/1.1默认保持连接，HTTP/1.0默认关闭，Connection头部可以改变它
+    bool chunked = false;
+
+    // 按名字找头部，不区分大小写，找不到时返回空
+    std::string_view header(std::string_view name) const;
+};
+
+enum class http_parser_isa { scalar, sse42, avx2 };
+
+// CPU支持的最快的实现，parse_request()用的就是它
+http_parser_isa best_parser_isa();
+
+bool parser_isa_supported(http_parser_isa isa);
+
+const char* to_string(http_parser_isa isa);
+
+int parse_request(const char* data, std::size_t len, http_request& request);
+
+// 指定用哪一个实现，给对比和基准测试用，isa必须是CPU支持的
+int parse_request(const char* data, std::size_t len, http_request& request, http_parser_isa isa);
+
+// 不区分大小写地比较ASCII字符串，HTTP的头部名字和一些头部的值（close、chunked）都不区分大小写
+bool iequals(std::string_view lhs, std::string_view rhs);
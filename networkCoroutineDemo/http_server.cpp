@@ -0,0 +1,203 @@
+/*
+* http_server.h中函数的实现
+*
+*/
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <utility>
+#include "http_server.h"
+#include "async_scope.h"
+#include "awaiters.h"
+#include "timer.h"
+#include "when.h"
+
+namespace {
+
+// 关闭连接前最多花这么久丢掉客户端还在发的数据
+constexpr auto linger_timeout = std::chrono::seconds(2);
+
+// 协议层面的错误直接回一个固定的响应，然后关闭连接
+http_response ErrorResponse(int status, std::string_view reason) {
+    http_response response;
+    response.status = status;
+    response.reason = reason;
+    response.close = true;
+    return response;
+}
+
+} // namespace
+
+HttpServer::HttpServer(Handler handler, std::size_t buffer_size)
+    : handler_(std::move(handler)), buffer_size_(buffer_size) {}
+
+task<> HttpServer::serve(IoContext& io_context, std::string port, const char* host) {
+    Socket listen{port, io_context, host};
+    async_scope connections;
+    for(;;) {
+        auto socket = co_await listen.accept();
+        connections.spawn(Serve(socket));
+    }
+}
+
+/*
+* 每个连接：recv -> 解析出所有完整的请求并生成响应 -> 用writev一次发出去 -> 把没解析完的数据挪到缓冲区开头 -> recv
+* 发送完之前不会再recv，请求缓冲区里的数据（包括handler指向它的body）在发送期间保持不变
+*
+*/
+task<> HttpServer::Serve(std::shared_ptr<Socket> socket) {
+    Connection connection{buffer_size_};
+    http_request request;   // 每次解析都会重新填写，不用每个请求构造一次
+    bool close = false;
+    while(!close) {
+        ssize_t n = co_await socket->recv(connection.input.get() + connection.end,
+            connection.capacity - connection.end);
+        if(n <= 0) {
+            co_return;
+        }
+        connection.end += n;
+
+        for(;;) {
+            const char* data = connection.input.get() + connection.begin;
+            int consumed = parse_request(data, connection.end - connection.begin, request);
+            if(consumed == 0) {
+                // 头部已经收完，但加上body放不进缓冲区：不用等它收满就可以回413
+                if(request.header_length != 0
+                    && request.content_length > connection.capacity - request.header_length) {
+                    Append(connection, ErrorResponse(413, "Content Too Large"));
+                    close = true;
+                } else if(connection.begin == 0 && connection.end == connection.capacity) {
+                    // 缓冲区从头到尾都是同一个请求的头部还没收完
+                    Append(connection, ErrorResponse(431, "Request Header Fields Too Large"));
+                    close = true;
+                }
+                break;
+            }
+            if(consumed < 0) {
+                Append(connection, ErrorResponse(400, "Bad Request"));
+                close = true;
+                break;
+            }
+            connection.begin += consumed;
+            if(request.chunked) {
+                Append(connection, ErrorResponse(501, "Not Implemented"));
+                close = true;
+                break;
+            }
+
+            http_response response;
+            handler_(request, response);
+            response.close = response.close || !request.keep_alive;
+            Append(connection, response);
+            if(response.close) {
+                close = true;
+                break;
+            }
+        }
+
+        // 整批响应用writev发出去；只发出去一部分时，跳过已经发完的iovec，调整发了一半的那个
+        auto& iovs = Gather(connection);
+        std::size_t first = 0;
+        while(first < iovs.size()) {
+            int count = static_cast<int>(std::min<std::size_t>(iovs.size() - first, IOV_MAX));
+            ssize_t sent = co_await socket->writev(iovs.data() + first, count);
+            if(sent <= 0) {
+                co_return;
+            }
+            for(std::size_t left = static_cast<std::size_t>(sent); left > 0;) {
+                if(left >= iovs[first].iov_len) {
+                    left -= iovs[first].iov_len;
+                    ++first;
+                } else {
+                    iovs[first].iov_base = static_cast<char*>(iovs[first].iov_base) + left;
+                    iovs[first].iov_len -= left;
+                    left = 0;
+                }
+            }
+        }
+        connection.output.clear();   // 发完才能清空，保留的容量给下一批复用
+
+        // 把不完整的请求挪到缓冲区开头，给后面的数据腾出地方
+        if(connection.begin == connection.end) {
+            connection.begin = connection.end = 0;
+        } else if(connection.end == connection.capacity) {
+            std::memmove(connection.input.get(), connection.input.get() + connection.begin,
+                connection.end - connection.begin);
+            connection.end -= connection.begin;
+            connection.begin = 0;
+        }
+    }
+
+    // 客户端可能还在发送（例如回413时body还没发完），这时直接close，内核收到数据会回RST，
+    // 客户端可能还没读到响应就被RST丢掉了：先关闭发送方向，丢掉收到的数据，直到对端关闭或者超时再close
+    socket->shutdown_write();
+    auto deadline = std::chrono::steady_clock::now() + linger_timeout;
+    for(;;) {
+        auto left = deadline - std::chrono::steady_clock::now();
+        if(left <= left.zero()) {
+            break;
+        }
+        auto r = co_await when_any(socket->recv(connection.input.get(), connection.capacity), sleep_for(left));
+        if(r.index() == 1 || std::get<0>(r) <= 0) {
+            break;
+        }
+    }
+}
+
+void HttpServer::Append(Connection& connection, const http_response& response) {
+    auto& out = connection.output;
+    std::size_t offset = out.size();
+    char number[24];
+
+    out.append("HTTP/1.1 ");
+    out.append(number, std::to_chars(number, number + sizeof(number), response.status).ptr);
+    out.push_back(' ');
+    out.append(response.reason);
+    out.append("\r\nServer: coro\r\nDate: ");
+    out.append(Date());
+    out.append("\r\nContent-Type: ");
+    out.append(response.content_type);
+    out.append("\r\nContent-Length: ");
+    out.append(number, std::to_chars(number, number + sizeof(number), response.body.size()).ptr);
+    out.append(response.close ? "\r\nConnection: close\r\n\r\n" : "\r\n\r\n");
+
+    connection.pending.push_back({offset, out.size() - offset, response.body});
+}
+
+/*
+* 输出缓冲区在追加的过程中可能重新分配，所以先记下偏移，到这里才变成iovec；
+* 相邻的响应头之间没有body时合并成一个iovec
+*
+*/
+std::vector<struct iovec>& HttpServer::Gather(Connection& connection) {
+    auto& iovs = connection.iovs;
+    iovs.clear();
+    char* base = connection.output.data();
+    for(const auto& pending : connection.pending) {
+        if(!iovs.empty() && static_cast<char*>(iovs.back().iov_base) + iovs.back().iov_len == base + pending.offset) {
+            iovs.back().iov_len += pending.length;
+        } else {
+            iovs.push_back({base + pending.offset, pending.length});
+        }
+        if(!pending.body.empty()) {
+            iovs.push_back({const_cast<char*>(pending.body.data()), pending.body.size()});
+        }
+    }
+    connection.pending.clear();
+    return iovs;
+}
+
+// Date头部精确到秒，同一秒里的响应共用一个格式化好的字符串
+std::string_view HttpServer::Date() {
+    std::time_t now = std::time(nullptr);
+    if(now != date_time_) {
+        std::tm tm;
+        gmtime_r(&now, &tm);
+        date_length_ = std::strftime(date_, sizeof(date_), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        date_time_ = now;
+    }
+    return {date_, date_length_};
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+/*
+* 在Socket/IoContext上的HTTP/1.1服务器，支持keep-alive和管线化（pipelining）
+*
+*   HttpServer server{[](const http_request& request, http_response& response) {
+*       response.body = "Hello, World!";
+*   }};
+*   auto t = server.serve(io_context, "8080");
+*   t.resume();
+*   io_context.run();
+*
+* （1）每个连接一个固定大小的接收缓冲区，请求在缓冲区里原地解析（http_parser.h），头部都是string_view，
+*      处理请求时不分配内存；
+* （2）一次recv收到的所有完整请求依次交给handler，所有响应攒在一起，用一次writev发出去（管线化的客户端一次发很多请求）；
+*      响应头写进连接自己的输出缓冲区，body不拷贝，直接作为一个iovec；
+* （3）body可以指向静态数据、handler自己保存的数据，或者请求缓冲区（例如回显请求的body），发送完之前都要有效；
+* （4）请求格式错误、请求头加body超过缓冲区大小、请求头本身超过缓冲区大小、带Transfer-Encoding的请求分别回400、413、431、501，然后关闭连接；
+*      请求里有Connection: close（或者HTTP/1.0没有keep-alive）时，发完这个请求的响应后关闭连接；
+*      关闭之前先shutdown发送方向，丢掉客户端还在发的数据，直到它关闭连接（最多2秒），免得还没读到的响应被RST丢掉；
+*
+*/
+
+#include <cstddef>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/uio.h>
+
+#include "http_parser.h"
+#include "io_context.h"
+#include "socket.h"
+#include "task.h"
+
+struct http_response {
+    int status = 200;
+    std::string_view reason = "OK";
+    std::string_view content_type = "text/plain";
+    std::string_view body;                  // 在这一批响应发出去之前要一直有效
+    bool close = false;                     // 发完这个响应以后关闭连接
+};
+
+class HttpServer {
+public:
+    // handler在事件循环线程上调用，不能挂起；默认response是200 OK、空的text/plain
+    using Handler = std::function<void(const http_request&, http_response&)>;
+
+    // buffer_size：每个连接的接收缓冲区大小，也是请求头加上body的最大长度
+    explicit HttpServer(Handler handler, std::size_t buffer_size = 16 * 1024);
+
+    HttpServer(const HttpServer&) = delete;
+
+    // 在host:port上接受连接，一直运行到IoContext停止；host为空时监听所有地址
+    task<> serve(IoContext& io_context, std::string port, const char* host = nullptr);
+private:
+    // 一个响应：头部在输出缓冲区里的位置，body在别处
+    struct Pending {
+        std::size_t offset;
+        std::size_t length;
+        std::string_view body;
+    };
+
+    struct Connection {
+        explicit Connection(std::size_t buffer_size) : input(new char[buffer_size]), capacity(buffer_size) {}
+
+        std::unique_ptr<char[]> input;
+        std::size_t capacity;
+        std::size_t begin = 0;              // 还没有解析的数据在[begin, end)
+        std::size_t end = 0;
+        std::string output;                 // 这一批响应的头部
+        std::vector<Pending> pending;
+        std::vector<struct iovec> iovs;
+    };
+
+    task<> Serve(std::shared_ptr<Socket> socket);
+    std::vector<struct iovec>& Gather(Connection& connection);
+    void Append(Connection& connection, const http_response& response);
+    std::string_view Date();
+
+    Handler handler_;
+    std::size_t buffer_size_;
+    std::time_t date_time_ = 0;             // Date头部每秒格式化一次
+    char date_[64] = {};
+    std::size_t date_length_ = 0;
+};
@@ -2,32 +2,257 @@
 /*
 * 上下文，主要是epoll的封装，注册/取消监听事件
 *
+* 除了socket之外，IoContext还负责：
+* （1）Post()：其他线程（例如文件I/O的线程池）把协程交还给事件循环恢复，通过eventfd唤醒epoll_wait；
+* （2）文件I/O：Linux上优先使用io_uring，完成事件同样通过eventfd通知；不可用时回退到线程池+preadv/pwritev；
+* （3）定时器：sleep_for/sleep_until挂起的协程按到期时间放在4叉堆里（DaryHeap），等定时器和等I/O是同一次epoll_wait，
+*      线程不会因为sleep而看不到socket事件；
+*      Linux上最早的到期时间设置到一个timerfd上（CLOCK_MONOTONIC + TFD_TIMER_ABSTIME，和steady_clock是同一个时钟），
+*      timerfd和socket一起挂在epoll上，精度不受epoll_wait毫秒级超时的限制，只有最早的到期时间变化时才重新设置；
+*      没有timerfd的平台（kqueue）或者创建失败时，退回到用最早的到期时间作为epoll_wait/kevent的超时；
+*      定时器可以设置松弛量（slack）：到期时间向上取整到slack的整数倍，落在同一个窗口里的定时器共用一个到期时间，
+*      在同一轮循环里一起恢复，空闲连接很多的服务器上可以大大减少epoll_wait的返回次数；
+* （4）就绪队列：在事件循环线程上post()的协程直接放进就绪队列，不加锁也不写eventfd，下一轮epoll_wait之前统一恢复；
+* （5）循环延迟：每一轮从epoll_wait返回到再次进入epoll_wait之间，新就绪的事件都只能排队，
+*      这段时间记在loop_stats()的直方图里；LoopWatchdog（watchdog.h）在另一个线程上发现迟迟不回到epoll_wait的循环；
+* （6）运行时指标：epoll_wait、epoll_ctl、协程恢复、收发字节数等计数都在metrics()里，MetricsExporter（metrics.h）按Prometheus的格式导出；
+*
+* 每一轮循环：恢复就绪队列 -> 提交io_uring -> epoll_wait(超时 = 就绪队列非空 ? 0 : 最早的定时器) -> 恢复I/O事件 -> 恢复到期的定时器
 *
 */
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <pthread.h>
 #include <set>
+#include <vector>
+
+#include "dary_heap.hpp"
+#include "thread_pool.hpp"
+#include "uring.h"
 
 class Socket;
 class Send;
+class Writev;
 class Recv;
 class Accept;
+class FileOp;
+class SleepAwaiter;
 
-class IoContext {
+/*
+* 单写者计数器：只在一个线程（事件循环线程）上修改，用relaxed的load+store代替fetch_add，
+* x86和ARM上都是普通的读写指令，没有lock前缀；其他线程随时可以读，读到的是某一时刻的完整值
+*/
+class io_counter {
 public:
-    IoContext();
+    void add(std::uint64_t n = 1) noexcept { value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    void set(std::uint64_t n) noexcept { value_.store(n, std::memory_order_relaxed); }
+    std::uint64_t load() const noexcept { return value_.load(std::memory_order_relaxed); }
+private:
+    std::atomic<std::uint64_t> value_{0};
+};
+
+/*
+* 定时器节点，嵌在SleepAwaiter里（也就是挂起的协程帧里），堆里只保存节点指针
+* 节点析构时会自动从堆里摘下来
+*/
+struct TimerNode : DaryHeap<TimerNode>::HeapNode {
+    std::chrono::steady_clock::time_point expires_;
+    std::coroutine_handle<> handle_;
+
+    friend bool operator<(const TimerNode& lhs, const TimerNode& rhs) noexcept {
+        return lhs.expires_ < rhs.expires_;
+    }
+};
+
+class IoContext : public executor {
+public:
+    // use_uring为false时，文件I/O强制走线程池回退路径
+    explicit IoContext(bool use_uring = true);
+    ~IoContext();
 
     void run();
-private:
+
+    // 让run()在当前这一轮事件处理完之后返回，可以在任意线程调用
+    void stop();
+
+    // 在事件循环线程上恢复协程，可以在任意线程调用
+    void post(std::coroutine_handle<> h) override;
+
+    // 当前线程的IoContext：run()的时候是正在运行的那个，否则是本线程上第一个创建的那个
+    // sleep_for/sleep_until用它来找到定时器所在的事件循环
+    static IoContext* current() noexcept { return current_; }
+
+    // 定时器默认的松弛量，0表示精确到期；sleep_for/sleep_until也可以单独给每个定时器指定
+    // 定时器最多晚slack触发，不会提前触发
+    void set_timer_slack(std::chrono::steady_clock::duration slack) { timer_slack_ = slack; }
+    std::chrono::steady_clock::duration timer_slack() const { return timer_slack_; }
+
+    struct TimerStats {
+        std::uint64_t scheduled = 0;   // 添加的定时器个数
+        std::uint64_t coalesced = 0;   // 其中因为slack被推迟了到期时间的个数
+        std::uint64_t cancelled = 0;   // 被取消的定时器个数
+        std::uint64_t fired = 0;       // 恢复的定时器个数（包括被取消的）
+        std::uint64_t wakeups = 0;     // 有定时器到期的循环轮数
+
+        // 一个定时器一次唤醒的话需要fired次，实际只用了wakeups次
+        std::uint64_t saved() const { return fired - wakeups; }
+    };
+
+    const TimerStats& timer_stats() const { return timer_stats_; }
+
+    // 每一轮循环从epoll_wait返回到再次进入epoll_wait之间的时间，直方图的第i个桶是[2^(i-1), 2^i)微秒
+    struct LoopStats {
+        constexpr static std::size_t buckets = 32;
+        std::uint64_t iterations = 0;
+        std::uint64_t stalls = 0;                  // 看门狗发现的卡顿次数
+        std::chrono::nanoseconds max{0};
+        std::chrono::nanoseconds total{0};
+        std::uint64_t histogram[buckets] = {};
+    };
+
+    // 可以在任意线程调用，各项计数之间不保证是同一时刻的
+    LoopStats loop_stats() const;
+
+    // 每次epoll_wait最多返回的事件数
     constexpr static std::size_t max_events = 10;
+
+    /*
+    * 运行时指标，只在事件循环线程上更新，任意线程都可以读
+    * 按缓存行对齐，放在IoContext的最后，事件循环线程更新计数时不会和其他线程访问的数据（例如posted_）抢同一个缓存行
+    */
+    struct alignas(64) Metrics {
+        io_counter waits;                               // epoll_wait/kevent的调用次数
+        io_counter events;                              // 返回的事件总数
+        io_counter events_per_wait[max_events + 1];     // 第i项：返回了i个事件的次数
+        io_counter ctl_add;                             // epoll_ctl按操作分别计数，kqueue上modify不会出现
+        io_counter ctl_mod;
+        io_counter ctl_del;
+        io_counter resumes;                             // 事件循环恢复协程的次数：socket事件、就绪队列、其他线程post()、定时器
+        io_counter spurious_wakeups;                    // socket有事件但没有协程在等（ResumeRecv/ResumeSend里的"no handle"）
+        io_counter sockets_opened;                      // 两者之差是当前还活着的socket数
+        io_counter sockets_closed;
+        io_counter bytes_received;
+        io_counter bytes_sent;
+        io_counter accepts;
+        io_counter loop_iterations;                     // 下面几项是loop_stats()的数据
+        io_counter loop_busy_ns;
+        io_counter loop_max_ns;
+        io_counter loop_histogram[LoopStats::buckets];
+    };
+
+    const Metrics& metrics() const { return metrics_; }
+private:
+    constexpr static unsigned uring_entries = 256;
+    constexpr static std::size_t file_pool_threads = 4;
+    constexpr static std::size_t file_pool_queue = 1024;
     const int fd_;
     friend Socket;
     friend Send;
+    friend Writev;
     friend Recv;
     friend Accept;
+    friend FileOp;
+    friend SleepAwaiter;
+    friend class LoopWatchdog;
     void Attach(Socket* socket);
     void WatchRead(Socket* socket);
     void UnwatchRead(Socket* socket);
     void WatchWrite(Socket* socket);
     void UnwatchWrite(Socket* socket);
     void Detach(Socket* socket);
+
+    void Wakeup();
+    void RunPosted();
+    void RunReady();
+
+    // 定时器只能在事件循环线程上添加和取消
+    void AddTimer(TimerNode* timer) { timers_.insert(*timer); }
+    void CancelTimer(TimerNode* timer) {
+        timers_.erase(*timer);
+        ++timer_stats_.cancelled;
+    }
+
+    // 按slack把到期时间向上取整到slack的整数倍，slack为空时使用timer_slack_
+    std::chrono::steady_clock::time_point Coalesce(std::chrono::steady_clock::time_point expires,
+        std::optional<std::chrono::steady_clock::duration> slack);
+
+    // 距离最早的定时器到期还有多少毫秒（向上取整），没有定时器时返回-1，和epoll_wait的超时参数一致
+    int NextTimeout() const;
+
+    // 恢复所有已经到期的定时器
+    void RunTimers();
+
+    // 最早的到期时间和timerfd上设置的不一样时重新设置timerfd
+    void ArmTimer();
+
+    // 从epoll_wait返回时调用LoopBusy()，进入epoll_wait之前调用LoopIdle()，记下这一轮忙了多久
+    static std::int64_t LoopClock() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    void LoopBusy() noexcept { busy_since_.store(LoopClock(), std::memory_order_release); }
+    void LoopIdle() noexcept;
+
+#if defined(__linux__)
+    Uring* uring() { return uring_.get(); }
+#else
+    void* uring() { return nullptr; }
+#endif
+    thread_pool& file_pool();
+
+    int wake_fd_ = -1;                  // 用来唤醒epoll_wait的eventfd
+    std::atomic<bool> stopped_{false};
+    std::mutex post_mutex_;
+    std::vector<std::coroutine_handle<>> posted_;   // 其他线程交还回来的协程
+    std::vector<std::coroutine_handle<>> ready_;    // 事件循环线程自己post()的协程，只有本线程访问
+    DaryHeap<TimerNode> timers_;                    // 按到期时间排序的定时器
+    std::chrono::steady_clock::duration timer_slack_{0};
+    int timer_fd_ = -1;                             // timerfd，-1表示退回到epoll_wait的超时
+    std::chrono::steady_clock::time_point armed_ = std::chrono::steady_clock::time_point::max();   // timerfd上设置的到期时间，max表示没有设置
+    TimerStats timer_stats_;
+    pthread_t loop_thread_{};                       // 正在run()的线程，看门狗给它发信号抓调用栈
+    std::atomic<std::int64_t> busy_since_{0};       // 这一轮从epoll_wait返回的时间（LoopClock），0表示在epoll_wait里或者没有运行
+    std::atomic<std::uint64_t> loop_stalls_{0};     // 看门狗线程写
+    inline static thread_local IoContext* current_ = nullptr;
+#if defined(__linux__)
+    std::unique_ptr<Uring> uring_;
+#endif
+    std::once_flag file_pool_once_;
+    std::unique_ptr<thread_pool> file_pool_;   // 文件I/O的回退路径，第一次使用时才创建
+    Metrics metrics_;
 };
+
+inline void IoContext::LoopIdle() noexcept {
+    auto since = busy_since_.load(std::memory_order_relaxed);
+    if(since != 0) {
+        auto busy = std::uint64_t(LoopClock() - since);
+        auto bucket = std::min<std::size_t>(std::bit_width(busy / 1000), LoopStats::buckets - 1);
+        metrics_.loop_histogram[bucket].add();
+        metrics_.loop_iterations.add();
+        metrics_.loop_busy_ns.add(busy);
+        if(busy > metrics_.loop_max_ns.load()) {
+            metrics_.loop_max_ns.set(busy);
+        }
+    }
+    busy_since_.store(0, std::memory_order_release);
+}
+
+inline IoContext::LoopStats IoContext::loop_stats() const {
+    LoopStats stats;
+    stats.iterations = metrics_.loop_iterations.load();
+    stats.stalls = loop_stalls_.load(std::memory_order_relaxed);
+    stats.max = std::chrono::nanoseconds(metrics_.loop_max_ns.load());
+    stats.total = std::chrono::nanoseconds(metrics_.loop_busy_ns.load());
+    for(std::size_t i = 0; i < LoopStats::buckets; ++i) {
+        stats.histogram[i] = metrics_.loop_histogram[i].load();
+    }
+    return stats;
+}
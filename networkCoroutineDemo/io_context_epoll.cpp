@@ -3,27 +3,131 @@
 *
 */
 
+#include <cerrno>
+#include <climits>
 #include <stdexcept>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
 #include <cstring>
+#include <utility>
 #include "io_context.h"
 #include "socket.h"
+#if CORO_TRACE
+#include "coro_profile.hpp"
+#endif
 
-IoContext::IoContext(): fd_(epoll_create1(0)) {
+IoContext::IoContext(bool use_uring): fd_(epoll_create1(0)) {
     if(fd_ == -1) {
         throw std::runtime_error{"epoll_create1"};
     }
+
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(wake_fd_ == -1) {
+        throw std::runtime_error{"eventfd"};
+    }
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = this;    // data.ptr指向IoContext自己，用来和socket区分开
+    if(epoll_ctl(fd_, EPOLL_CTL_ADD, wake_fd_, &ev) == -1) {
+        throw std::runtime_error{"epoll_ctl: eventfd"};
+    }
+
+    // 定时器用timerfd唤醒epoll_wait，创建失败时退回到epoll_wait的超时
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(timer_fd_ != -1) {
+        ev.events = EPOLLIN;
+        ev.data.ptr = &timer_fd_;
+        if(epoll_ctl(fd_, EPOLL_CTL_ADD, timer_fd_, &ev) == -1) {
+            throw std::runtime_error{"epoll_ctl: timerfd"};
+        }
+    }
+
+    if(use_uring) {
+        uring_ = Uring::TryCreate(uring_entries);
+        if(uring_) {
+            uring_->RegisterEventfd(wake_fd_);   // io_uring有完成事件时也会写这个eventfd
+        }
+    }
+
+    if(!current_) {
+        current_ = this;
+    }
+}
+
+IoContext::~IoContext() {
+    if(current_ == this) {
+        current_ = nullptr;
+    }
+    file_pool_.reset();   // 先等线程池里的文件操作结束
+    uring_.reset();
+    if(timer_fd_ != -1) {
+        ::close(timer_fd_);
+    }
+    ::close(wake_fd_);
+    ::close(fd_);
 }
 
 void IoContext::run() {
-    struct epoll_event ev, events[max_events];
-    for(;;) {
-        int nfds = epoll_wait(fd_, events, max_events, -1);   //等待事件就绪：可读、可写
+    executor* previous = std::exchange(executor::current(), this);   // 在本线程上挂起的协程，之后都回到这个IoContext上恢复
+    IoContext* previous_context = std::exchange(current_, this);
+#if CORO_TRACE
+    coro_trace::setThreadName("IoContext");
+#endif
+    loop_thread_ = pthread_self();
+    LoopBusy();
+    struct epoll_event events[max_events];
+    while(!stopped_.load(std::memory_order_acquire)) {
+        RunReady();
+
+        if(uring_) {
+            uring_->Submit();   // 上一轮攒下来的文件I/O请求一次性提交
+        }
+
+        //等待事件就绪：可读、可写，或者最早的定时器到期；还有就绪的协程时不阻塞
+        int timeout = 0;
+        if(ready_.empty()) {
+            if(timer_fd_ != -1) {
+                ArmTimer();   // 定时器到期时timerfd可读，epoll_wait不需要超时
+                timeout = -1;
+            } else {
+                timeout = NextTimeout();
+            }
+        }
+        LoopIdle();
+#if CORO_TRACE
+        auto wait_start = coro_profile::now();
+#endif
+        int nfds = epoll_wait(fd_, events, max_events, timeout);
+        LoopBusy();
+#if CORO_TRACE
+        coro_trace::complete("epoll_wait", "io", wait_start, coro_profile::now(), this, nfds < 0 ? 0 : nfds);
+#endif
         if(nfds == -1) {
+            if(errno == EINTR) continue;
             throw std::runtime_error{"epoll_wait"};
         }
+        metrics_.waits.add();
+        metrics_.events.add(nfds);
+        metrics_.events_per_wait[nfds].add();
 
         for(int i = 0; i < nfds; ++i) {
+            if(events[i].data.ptr == this) {
+                uint64_t value;
+                while(::read(wake_fd_, &value, sizeof(value)) > 0) {}
+                RunPosted();
+                if(uring_) {
+                    uring_->Reap();
+                }
+                continue;
+            }
+            if(events[i].data.ptr == &timer_fd_) {
+                uint64_t expirations;
+                while(::read(timer_fd_, &expirations, sizeof(expirations)) > 0) {}
+                armed_ = std::chrono::steady_clock::time_point::max();   // 已经到期，timerfd不会再触发了
+                continue;   // 到期的定时器在下面的RunTimers()里恢复
+            }
             auto socket = static_cast<Socket*>(events[i].data.ptr);
             if(events[i].events & EPOLLIN) {
                 socket->ResumeRecv();    //这里是最核心的代码，以往的非协程模式下，这里应该调用用户的回调函数，而协程模式下则是恢复读协程的运行
@@ -32,7 +136,132 @@ void IoContext::run() {
                 socket->ResumeSend();    //这里是最核心的代码，恢复写协程的运行
             }
         }
+
+        RunTimers();
     }
+    LoopIdle();
+    current_ = previous_context;
+    executor::current() = previous;
+}
+
+void IoContext::stop() {
+    stopped_.store(true, std::memory_order_release);
+    Wakeup();
+}
+
+void IoContext::post(std::coroutine_handle<> h) {
+    if(executor::current() == this) {
+        ready_.push_back(h);   // 就在事件循环线程上，下一轮直接恢复，不需要唤醒epoll_wait
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(post_mutex_);
+        posted_.push_back(h);
+    }
+    Wakeup();
+}
+
+void IoContext::Wakeup() {
+    uint64_t one = 1;
+    ssize_t n = ::write(wake_fd_, &one, sizeof(one));
+    (void)n;   // eventfd计数器溢出时写失败也没关系，说明已经有未处理的唤醒
+}
+
+void IoContext::RunPosted() {
+    std::vector<std::coroutine_handle<>> posted;
+    {
+        std::lock_guard<std::mutex> lock(post_mutex_);
+        posted.swap(posted_);
+    }
+    metrics_.resumes.add(posted.size());
+    for(auto h : posted) {
+        h.resume();
+    }
+}
+
+void IoContext::RunReady() {
+    if(ready_.empty()) return;
+    std::vector<std::coroutine_handle<>> ready;
+    ready.swap(ready_);   // 恢复过程中新post()的协程留到下一轮
+    metrics_.resumes.add(ready.size());
+    for(auto h : ready) {
+        h.resume();
+    }
+}
+
+int IoContext::NextTimeout() const {
+    if(timers_.empty()) {
+        return -1;
+    }
+    auto left = timers_.front().expires_ - std::chrono::steady_clock::now();
+    if(left <= std::chrono::steady_clock::duration::zero()) {
+        return 0;
+    }
+    // 向上取整，否则会在定时器到期之前醒来，白白多转一圈
+    auto ms = std::chrono::ceil<std::chrono::milliseconds>(left).count();
+    return ms > INT_MAX ? INT_MAX : static_cast<int>(ms);
+}
+
+void IoContext::ArmTimer() {
+    auto expires = timers_.empty() ? std::chrono::steady_clock::time_point::max() : timers_.front().expires_;
+    if(expires == armed_) {
+        return;
+    }
+
+    struct itimerspec spec = {};   // 全0表示取消timerfd
+    if(!timers_.empty()) {
+        // steady_clock就是CLOCK_MONOTONIC，time_since_epoch()可以直接作为TFD_TIMER_ABSTIME的绝对时间
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(expires.time_since_epoch()).count();
+        if(ns <= 0) {
+            ns = 1;   // 已经取消的定时器到期时间是min()，it_value不能是0，否则就变成取消timerfd了
+        }
+        spec.it_value.tv_sec = ns / 1000000000;
+        spec.it_value.tv_nsec = ns % 1000000000;
+    }
+    if(timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) == -1) {
+        throw std::runtime_error{"timerfd_settime"};
+    }
+    armed_ = expires;
+}
+
+std::chrono::steady_clock::time_point IoContext::Coalesce(std::chrono::steady_clock::time_point expires,
+    std::optional<std::chrono::steady_clock::duration> slack) {
+    auto window = slack.value_or(timer_slack_);
+    ++timer_stats_.scheduled;
+    if(window <= std::chrono::steady_clock::duration::zero()) {
+        return expires;
+    }
+    auto rest = expires.time_since_epoch() % window;
+    if(rest == std::chrono::steady_clock::duration::zero()) {
+        return expires;
+    }
+    ++timer_stats_.coalesced;
+    return expires + (window - rest);   // 只往后推，不会提前到期
+}
+
+void IoContext::RunTimers() {
+    auto now = std::chrono::steady_clock::now();
+    if(timers_.empty() || now < timers_.front().expires_) {
+        return;
+    }
+    ++timer_stats_.wakeups;
+    while(!timers_.empty() && timers_.front().expires_ <= now) {
+        auto& timer = timers_.front();
+        timers_.erase(timer);
+        ++timer_stats_.fired;
+        metrics_.resumes.add();
+#if CORO_TRACE
+        coro_trace::instant("timer", "timer", coro_profile::now(), timer.handle_.address());
+#endif
+        timer.handle_.resume();   // 恢复之后定时器节点所在的协程帧可能已经销毁了，不能再访问timer
+    }
+}
+
+thread_pool& IoContext::file_pool() {
+    std::call_once(file_pool_once_, [this] {
+        file_pool_ = std::make_unique<thread_pool>(file_pool_threads, file_pool_queue);
+    });
+    return *file_pool_;
 }
 
 void IoContext::Attach(Socket* socket) {
@@ -44,6 +273,8 @@ void IoContext::Attach(Socket* socket) {
         throw std::runtime_error{"epoll_ctl: attach"};
     }
     socket->io_state_ = io_state;
+    metrics_.ctl_add.add();
+    metrics_.sockets_opened.add();
 }
 
 // 定义一个宏，消除重复的代码
@@ -56,6 +287,7 @@ void IoContext::Attach(Socket* socket) {
             throw std::runtime_error{"epoll_ctl: mod"}; \
         } \
         socket->io_state_ = new_state; \
+        metrics_.ctl_mod.add(); \
     } \
 
 void IoContext::WatchRead(Socket* socket) {
@@ -83,4 +315,6 @@ void IoContext::Detach(Socket* socket) {
         perror("epoll ctl: del");
         exit(EXIT_FAILURE);
     }
+    metrics_.ctl_del.add();
+    metrics_.sockets_closed.add();
 }
@@ -1,27 +1,81 @@
+#include <cerrno>
+#include <climits>
 #include <stdexcept>
 #include <sys/types.h>
 #include <sys/event.h>
 #include <sys/time.h>
 #include <unistd.h>
 #include <cstring>
+#include <utility>
 #include "io_context.h"
 #include "socket.h"
+#if CORO_TRACE
+#include "coro_profile.hpp"
+#endif
 
-IoContext::IoContext(): fd_(kqueue()) {
+IoContext::IoContext(bool use_uring): fd_(kqueue()) {
     if(fd_ == -1) {
         throw std::runtime_error{"kqueue() error"};
     }
+    (void)use_uring;   // kqueue平台上没有io_uring，文件I/O总是走线程池
+
+    // 用EVFILT_USER代替eventfd来唤醒kevent
+    struct kevent ev;
+    EV_SET(&ev, 0, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, this);
+    if(-1 == kevent(fd_, &ev, 1, NULL, 0, NULL)) {
+        throw std::runtime_error{"kevent: EVFILT_USER"};
+    }
+
+    if(!current_) {
+        current_ = this;
+    }
+}
+
+IoContext::~IoContext() {
+    if(current_ == this) {
+        current_ = nullptr;
+    }
+    file_pool_.reset();
+    ::close(fd_);
 }
 
 void IoContext::run() {
-    struct kevent ev, events[max_events];
-    for(;;) {
-        int nfds = kevent(fd_, NULL, 0, events, max_events, NULL);
+    executor* previous = std::exchange(executor::current(), this);
+    IoContext* previous_context = std::exchange(current_, this);
+#if CORO_TRACE
+    coro_trace::setThreadName("IoContext");
+#endif
+    loop_thread_ = pthread_self();
+    LoopBusy();
+    struct kevent events[max_events];
+    while(!stopped_.load(std::memory_order_acquire)) {
+        RunReady();
+
+        // 超时由最早的定时器决定，还有就绪的协程时不阻塞
+        int timeout = ready_.empty() ? NextTimeout() : 0;
+        struct timespec ts = { timeout / 1000, (timeout % 1000) * 1000000L };
+        LoopIdle();
+#if CORO_TRACE
+        auto wait_start = coro_profile::now();
+#endif
+        int nfds = kevent(fd_, NULL, 0, events, max_events, timeout < 0 ? NULL : &ts);
+        LoopBusy();
+#if CORO_TRACE
+        coro_trace::complete("kevent", "io", wait_start, coro_profile::now(), this, nfds < 0 ? 0 : nfds);
+#endif
         if(nfds == -1) {
+            if(errno == EINTR) continue;
             throw std::runtime_error{"kevent()"};
         }
+        metrics_.waits.add();
+        metrics_.events.add(nfds);
+        metrics_.events_per_wait[nfds].add();
 
         for(int i = 0; i < nfds; ++i) {
+            if(events[i].filter == EVFILT_USER) {
+                RunPosted();
+                continue;
+            }
             auto socket = static_cast<Socket*>(events[i].udata);
             if(events[i].filter == EVFILT_READ) {
                 socket->ResumeRecv();
@@ -30,7 +84,109 @@ void IoContext::run() {
                 socket->ResumeSend();
             }
         }
+
+        RunTimers();
+    }
+    LoopIdle();
+    current_ = previous_context;
+    executor::current() = previous;
+}
+
+void IoContext::stop() {
+    stopped_.store(true, std::memory_order_release);
+    Wakeup();
+}
+
+void IoContext::post(std::coroutine_handle<> h) {
+    if(executor::current() == this) {
+        ready_.push_back(h);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(post_mutex_);
+        posted_.push_back(h);
+    }
+    Wakeup();
+}
+
+void IoContext::Wakeup() {
+    struct kevent ev;
+    EV_SET(&ev, 0, EVFILT_USER, 0, NOTE_TRIGGER, 0, this);
+    kevent(fd_, &ev, 1, NULL, 0, NULL);
+}
+
+void IoContext::RunPosted() {
+    std::vector<std::coroutine_handle<>> posted;
+    {
+        std::lock_guard<std::mutex> lock(post_mutex_);
+        posted.swap(posted_);
+    }
+    metrics_.resumes.add(posted.size());
+    for(auto h : posted) {
+        h.resume();
+    }
+}
+
+void IoContext::RunReady() {
+    if(ready_.empty()) return;
+    std::vector<std::coroutine_handle<>> ready;
+    ready.swap(ready_);
+    metrics_.resumes.add(ready.size());
+    for(auto h : ready) {
+        h.resume();
+    }
+}
+
+int IoContext::NextTimeout() const {
+    if(timers_.empty()) {
+        return -1;
+    }
+    auto left = timers_.front().expires_ - std::chrono::steady_clock::now();
+    if(left <= std::chrono::steady_clock::duration::zero()) {
+        return 0;
     }
+    auto ms = std::chrono::ceil<std::chrono::milliseconds>(left).count();
+    return ms > INT_MAX ? INT_MAX : static_cast<int>(ms);
+}
+
+std::chrono::steady_clock::time_point IoContext::Coalesce(std::chrono::steady_clock::time_point expires,
+    std::optional<std::chrono::steady_clock::duration> slack) {
+    auto window = slack.value_or(timer_slack_);
+    ++timer_stats_.scheduled;
+    if(window <= std::chrono::steady_clock::duration::zero()) {
+        return expires;
+    }
+    auto rest = expires.time_since_epoch() % window;
+    if(rest == std::chrono::steady_clock::duration::zero()) {
+        return expires;
+    }
+    ++timer_stats_.coalesced;
+    return expires + (window - rest);   // 只往后推，不会提前到期
+}
+
+void IoContext::RunTimers() {
+    auto now = std::chrono::steady_clock::now();
+    if(timers_.empty() || now < timers_.front().expires_) {
+        return;
+    }
+    ++timer_stats_.wakeups;
+    while(!timers_.empty() && timers_.front().expires_ <= now) {
+        auto& timer = timers_.front();
+        timers_.erase(timer);
+        ++timer_stats_.fired;
+        metrics_.resumes.add();
+#if CORO_TRACE
+        coro_trace::instant("timer", "timer", coro_profile::now(), timer.handle_.address());
+#endif
+        timer.handle_.resume();
+    }
+}
+
+thread_pool& IoContext::file_pool() {
+    std::call_once(file_pool_once_, [this] {
+        file_pool_ = std::make_unique<thread_pool>(file_pool_threads, file_pool_queue);
+    });
+    return *file_pool_;
 }
 
 void IoContext::Attach(Socket* socket) {
@@ -41,6 +197,8 @@ void IoContext::Attach(Socket* socket) {
         throw std::runtime_error{"kevnet: ADD"};
     }
     socket->io_state_ = io_state;
+    metrics_.ctl_add.add();
+    metrics_.sockets_opened.add();
 }
 
 // 定义一个宏，消除重复的代码
@@ -52,6 +210,7 @@ void IoContext::Attach(Socket* socket) {
             throw std::runtime_error{"kevent"}; \
         } \
         socket->io_state_ = new_state; \
+        ((flags) == EV_ADD ? metrics_.ctl_add : metrics_.ctl_del).add(); \
     }
     
 void IoContext::WatchRead(Socket* socket) {
@@ -76,4 +235,5 @@ void IoContext::UnwatchWrite(Socket* socket) {
 
 void IoContext::Detach(Socket* socket) {
     ::close(socket->fd_);
+    metrics_.sockets_closed.add();
 }
@@ -0,0 +1,91 @@
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include "io_context.h"
+#include "awaiters.h"
+#include "async_generator.h"
+#include "async_scope.h"
+
+/*
+* 按行处理的服务器：收到的每一行加上行号发回去
+*
+* socket.chunks()  ---->  lines()  ---->  handle()
+*  每次recv的数据        拆成一行一行       逐行处理
+*
+* 两级都是async_generator，数据一边到达一边处理，不需要先把整个消息收完；
+* 一行完整地落在同一块数据里时，yield出来的string_view直接指向recv的缓冲区，不拷贝；
+* 跨块的行才拼到pending里，行的长度有上限，所以每个连接的内存占用是有界的
+*
+* 用法：coro_lines，然后 nc 127.0.0.1 10010
+*
+*/
+
+constexpr std::size_t max_line = 4096;
+
+async_generator<std::string_view> lines(async_generator<std::span<const std::byte>>& chunks) {
+    std::string pending;
+    for(auto it = co_await chunks.begin(); it != chunks.end(); co_await ++it) {
+        std::string_view data{reinterpret_cast<const char*>(it->data()), it->size()};
+        for(;;) {
+            auto pos = data.find('\n');
+            if(pos == std::string_view::npos) break;
+            if(pending.empty()) {
+                co_yield data.substr(0, pos);
+            } else {
+                pending.append(data.substr(0, pos));
+                co_yield std::string_view{pending};
+                pending.clear();
+            }
+            data.remove_prefix(pos + 1);
+        }
+        if(pending.size() + data.size() > max_line) {
+            throw std::runtime_error{"line too long"};
+        }
+        pending.append(data);
+    }
+    if(!pending.empty()) {
+        co_yield std::string_view{pending};   // 最后一行没有换行符
+    }
+}
+
+task<> handle(std::shared_ptr<Socket> socket) {
+    try {
+        auto chunks = socket->chunks();
+        auto decoder = lines(chunks);
+        std::size_t no = 0;
+        for(auto it = co_await decoder.begin(); it != decoder.end(); co_await ++it) {
+            std::string reply = std::to_string(++no) + ": ";
+            reply.append(*it);
+            reply.push_back('\n');
+            std::size_t sent = 0;
+            while(sent < reply.size()) {
+                ssize_t res = co_await socket->send(reply.data() + sent, reply.size() - sent);
+                if(res <= 0) co_return;
+                sent += res;
+            }
+        }
+    } catch(const std::exception& e) {
+        std::cout<<"connection error: "<<e.what()<<"\n";
+    }
+}
+
+task<> accept(Socket& listen) {
+    async_scope connections;
+    for(;;) {
+        auto socket = co_await listen.accept();
+        connections.spawn(handle(socket));
+    }
+}
+
+int main() {
+    IoContext io_context;
+
+    Socket listen{"10010", io_context};
+
+    auto t = accept(listen);
+    t.resume();
+
+    io_context.run();
+}
@@ -0,0 +1,160 @@
+/*
+* metrics.h中函数的实现
+*
+*/
+
+#include <cstdint>
+#include <ostream>
+#include <sstream>
+#include <string_view>
+#include "metrics.h"
+#include "async_scope.h"
+#include "awaiters.h"
+
+namespace {
+
+// 标签值里的反斜杠、双引号和换行要转义
+std::string LabelValue(const std::string& value) {
+    std::string escaped;
+    for(char c : value) {
+        if(c == '\\' || c == '"') {
+            escaped += '\\';
+            escaped += c;
+        } else if(c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+void Header(std::ostream& out, const char* name, const char* type, const char* help) {
+    out<<"# HELP "<<name<<" "<<help<<"\n# TYPE "<<name<<" "<<type<<"\n";
+}
+
+} // namespace
+
+void MetricsExporter::add(IoContext& context, std::string name) {
+    contexts_.emplace_back(&context, LabelValue(name));
+}
+
+void MetricsExporter::write(std::ostream& out) const {
+    // 对每个IoContext输出一行，label是{context="..."}里面的内容
+    auto each = [&](auto&& line) {
+        for(const auto& [context, name] : contexts_) {
+            line(context->metrics(), "context=\"" + name + "\"", *context);
+        }
+    };
+    auto counter = [&](const char* name, const char* help, io_counter IoContext::Metrics::* field) {
+        Header(out, name, "counter", help);
+        each([&](const IoContext::Metrics& m, const std::string& label, IoContext&) {
+            out<<name<<"{"<<label<<"} "<<(m.*field).load()<<"\n";
+        });
+    };
+
+    counter("coro_epoll_wait_total", "Calls to epoll_wait/kevent.", &IoContext::Metrics::waits);
+
+    // 每个桶是累计的，+Inf桶和_count用同一组读数，保证一致
+    Header(out, "coro_epoll_wait_events", "histogram", "Events returned per epoll_wait/kevent call.");
+    each([&](const IoContext::Metrics& m, const std::string& label, IoContext&) {
+        std::uint64_t cumulative = 0;
+        for(std::size_t i = 0; i <= IoContext::max_events; ++i) {
+            cumulative += m.events_per_wait[i].load();
+            out<<"coro_epoll_wait_events_bucket{"<<label<<",le=\""<<i<<"\"} "<<cumulative<<"\n";
+        }
+        out<<"coro_epoll_wait_events_bucket{"<<label<<",le=\"+Inf\"} "<<cumulative<<"\n";
+        out<<"coro_epoll_wait_events_sum{"<<label<<"} "<<m.events.load()<<"\n";
+        out<<"coro_epoll_wait_events_count{"<<label<<"} "<<cumulative<<"\n";
+    });
+
+    Header(out, "coro_epoll_ctl_total", "counter", "epoll_ctl/kevent registrations by operation.");
+    each([&](const IoContext::Metrics& m, const std::string& label, IoContext&) {
+        out<<"coro_epoll_ctl_total{"<<label<<",op=\"add\"} "<<m.ctl_add.load()<<"\n";
+        out<<"coro_epoll_ctl_total{"<<label<<",op=\"mod\"} "<<m.ctl_mod.load()<<"\n";
+        out<<"coro_epoll_ctl_total{"<<label<<",op=\"del\"} "<<m.ctl_del.load()<<"\n";
+    });
+
+    counter("coro_resumes_total", "Coroutines resumed by the event loop.", &IoContext::Metrics::resumes);
+    counter("coro_spurious_wakeups_total", "Socket events with no coroutine waiting for them.",
+        &IoContext::Metrics::spurious_wakeups);
+
+    // 先读关闭的再读打开的，两次读之间有新的socket时结果只会偏大，不会是负数
+    Header(out, "coro_sockets", "gauge", "Sockets currently registered with the event loop.");
+    each([&](const IoContext::Metrics& m, const std::string& label, IoContext&) {
+        auto closed = m.sockets_closed.load();
+        out<<"coro_sockets{"<<label<<"} "<<m.sockets_opened.load() - closed<<"\n";
+    });
+
+    counter("coro_received_bytes_total", "Bytes received by Socket::recv.", &IoContext::Metrics::bytes_received);
+    counter("coro_sent_bytes_total", "Bytes sent by Socket::send.", &IoContext::Metrics::bytes_sent);
+    counter("coro_accepts_total", "Connections accepted.", &IoContext::Metrics::accepts);
+
+    Header(out, "coro_loop_busy_seconds", "histogram",
+        "Time from epoll_wait returning to the next epoll_wait, per loop iteration.");
+    each([&](const IoContext::Metrics&, const std::string& label, IoContext& context) {
+        auto stats = context.loop_stats();
+        std::uint64_t cumulative = 0;
+        for(std::size_t i = 0; i + 1 < IoContext::LoopStats::buckets; ++i) {
+            cumulative += stats.histogram[i];
+            out<<"coro_loop_busy_seconds_bucket{"<<label<<",le=\""<<double(std::uint64_t(1) << i) / 1e6<<"\"} "
+                <<cumulative<<"\n";
+        }
+        cumulative += stats.histogram[IoContext::LoopStats::buckets - 1];
+        out<<"coro_loop_busy_seconds_bucket{"<<label<<",le=\"+Inf\"} "<<cumulative<<"\n";
+        out<<"coro_loop_busy_seconds_sum{"<<label<<"} "<<std::chrono::duration<double>(stats.total).count()<<"\n";
+        out<<"coro_loop_busy_seconds_count{"<<label<<"} "<<cumulative<<"\n";
+    });
+
+    Header(out, "coro_loop_stalls_total", "counter", "Loop iterations reported by LoopWatchdog.");
+    each([&](const IoContext::Metrics&, const std::string& label, IoContext& context) {
+        out<<"coro_loop_stalls_total{"<<label<<"} "<<context.loop_stats().stalls<<"\n";
+    });
+}
+
+task<> MetricsExporter::serve(IoContext& io_context, std::string port, const char* host) {
+    Socket listen{port, io_context, host};
+    async_scope connections;
+    for(;;) {
+        auto socket = co_await listen.accept();
+        connections.spawn(Respond(socket));
+    }
+}
+
+task<> MetricsExporter::Respond(std::shared_ptr<Socket> socket) const {
+    std::string request;
+    char buffer[1024];
+    while(request.find("\r\n\r\n") == std::string::npos) {
+        if(request.size() > 8192) {
+            co_return;   // 请求头太大，不是给我们的
+        }
+        ssize_t n = co_await socket->recv(buffer, sizeof(buffer));
+        if(n <= 0) {
+            co_return;
+        }
+        request.append(buffer, n);
+    }
+
+    std::string_view line{request.data(), request.find("\r\n")};
+    std::string status = "404 Not Found";
+    std::string body = "not found\n";
+    if(line.starts_with("GET /metrics ") || line.starts_with("GET / ")) {
+        std::ostringstream text;
+        write(text);
+        status = "200 OK";
+        body = text.str();
+    }
+    std::string response = "HTTP/1.1 " + status + "\r\n"
+        "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n"
+        "Connection: close\r\n\r\n" + body;
+
+    std::size_t sent = 0;
+    while(sent < response.size()) {
+        ssize_t n = co_await socket->send(response.data() + sent, response.size() - sent);
+        if(n <= 0) {
+            co_return;
+        }
+        sent += n;
+    }
+}
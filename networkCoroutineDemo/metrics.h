@@ -0,0 +1,40 @@
+#pragma once
+
+/*
+* 把IoContext的运行时指标（IoContext::metrics()、loop_stats()）按Prometheus的文本格式导出
+*
+*   MetricsExporter exporter;
+*   exporter.add(io_context, "main");
+*   scope.spawn(exporter.serve(io_context, "9100"));   // 默认只监听127.0.0.1
+*   // curl http://127.0.0.1:9100/metrics
+*
+* （1）计数器由各个IoContext在自己的事件循环线程上更新，导出时只读，不加锁，也不需要事件循环配合；
+* （2）一个exporter可以导出多个IoContext，用context标签区分；serve()可以跑在任意一个IoContext上，包括被导出的那个；
+* （3）HTTP只实现了够用的部分：读到请求头结束，GET /metrics（或者/）返回指标，其他请求返回404，然后关闭连接
+*
+*/
+
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "io_context.h"
+#include "socket.h"
+#include "task.h"
+
+class MetricsExporter {
+public:
+    // add()要在serve()之前调用完；exporter存在期间context不能析构
+    void add(IoContext& context, std::string name);
+
+    void write(std::ostream& out) const;
+
+    // 在host:port上提供指标，一直运行到IoContext停止
+    task<> serve(IoContext& io_context, std::string port, const char* host = "127.0.0.1");
+private:
+    task<> Respond(std::shared_ptr<Socket> socket) const;
+
+    std::vector<std::pair<IoContext*, std::string>> contexts_;
+};
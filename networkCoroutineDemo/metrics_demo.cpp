@@ -0,0 +1,60 @@
+#include <memory>
+#include <string>
+#include "io_context.h"
+#include "awaiters.h"
+#include "async_scope.h"
+#include "metrics.h"
+
+/*
+* 运行时指标的demo：一个不打印日志的回显服务器，同一个IoContext上再跑一个指标端点
+*
+* 用法：coro_metrics [port] [metrics_port]，默认10011和9100
+*   nc 127.0.0.1 10011                      // 随便发点东西
+*   curl http://127.0.0.1:9100/metrics      // 看epoll_wait的次数、每次返回的事件数、收发字节数……
+*
+* 指标端点只监听127.0.0.1，不要把它暴露到外网
+*
+*/
+
+task<> echo(std::shared_ptr<Socket> socket) {
+    char buffer[4096];
+    for(;;) {
+        ssize_t recv_len = co_await socket->recv(buffer, sizeof(buffer));
+        if(recv_len <= 0) {
+            co_return;
+        }
+        ssize_t send_len = 0;
+        while(send_len < recv_len) {
+            ssize_t res = co_await socket->send(buffer + send_len, recv_len - send_len);
+            if(res <= 0) {
+                co_return;
+            }
+            send_len += res;
+        }
+    }
+}
+
+task<> accept(Socket& listen) {
+    async_scope connections;
+    for(;;) {
+        auto socket = co_await listen.accept();
+        connections.spawn(echo(socket));
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string port = argc > 1 ? argv[1] : "10011";
+    std::string metrics_port = argc > 2 ? argv[2] : "9100";
+
+    IoContext io_context;
+    MetricsExporter exporter;
+    exporter.add(io_context, "main");
+
+    Socket listen{port, io_context};
+    auto server = accept(listen);
+    server.resume();
+    auto metrics = exporter.serve(io_context, metrics_port);
+    metrics.resume();
+
+    io_context.run();
+}
@@ -0,0 +1,56 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include "io_context.h"
+#include "async_file.h"
+#include "stream_reader.h"
+#include "task.h"
+
+/*
+* 流式扫描大文件的demo：处理第n块的同时，后面的块已经在读了
+*
+* 用法：coro_scan 文件路径 [块大小KB] [预读深度]
+*
+*/
+
+task<> scan(IoContext& io_context, const char* path, std::size_t chunk_size, std::size_t depth) {
+    AsyncFile file{io_context, path, O_RDONLY};
+    StreamReader reader{file, chunk_size, depth};
+
+    auto start = std::chrono::steady_clock::now();
+    std::uint64_t total = 0;
+    std::uint64_t checksum = 0;
+    for(;;) {
+        auto chunk = co_await reader.next();
+        if(chunk.empty()) break;
+        for(std::byte b : chunk) {
+            checksum = checksum * 31 + static_cast<std::uint8_t>(b);
+        }
+        total += chunk.size();
+    }
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if(reader.error() != 0) {
+        std::cout<<"read error, errno="<<reader.error()<<"\n";
+    }
+    std::cout<<"bytes="<<total<<" checksum="<<checksum
+        <<" MB/s="<<(seconds > 0 ? total / seconds / (1 << 20) : 0)<<"\n";
+    io_context.stop();
+}
+
+int main(int argc, char* argv[]) {
+    if(argc < 2) {
+        std::cout<<"usage: coro_scan <file> [chunk_kb] [depth]\n";
+        return 1;
+    }
+    std::size_t chunk_size = (argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1024) * 1024;
+    std::size_t depth = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 4;
+
+    IoContext io_context;
+
+    auto t = scan(io_context, argv[1], chunk_size, depth);
+    t.resume();
+
+    io_context.run();
+}
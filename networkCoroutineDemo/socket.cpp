@@ -1,8 +1,8 @@
 #include <memory>
 #include <cstring>
 #include <stdexcept>
-#include <iostream>
 #include <string_view>
+#include <vector>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
@@ -10,8 +10,9 @@
 #include "socket.h"
 #include "io_context.h"
 #include "awaiters.h"
+#include "debug.hpp"
 
-Socket::Socket(std::string_view port, IoContext& io_context) :
+Socket::Socket(std::string_view port, IoContext& io_context, const char* host) :
     io_context_(io_context) {
     struct addrinfo hints, *res;
 
@@ -21,14 +22,14 @@ Socket::Socket(std::string_view port, IoContext& io_context) :
     hints.ai_socktype = SOCK_STREAM;
     hints.ai_flags = AI_PASSIVE; // fill in my IP for me 
 
-    getaddrinfo(NULL, port.data(), &hints, &res);
+    getaddrinfo(host, port.data(), &hints, &res);
     fd_ = ::socket(res->ai_family, res->ai_socktype, res->ai_protocol);
     int opt;
     ::setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
     if(::bind(fd_, res->ai_addr, res->ai_addrlen) == -1) {
         throw std::runtime_error{"bind error"};
     }
-    ::listen(fd_, 8);
+    ::listen(fd_, SOMAXCONN);   // 压测时一下子连进来几百个连接，队列太短会丢SYN，重传要等1秒
     fcntl(fd_, F_SETFL, O_NONBLOCK);
     io_context_.Attach(this);
     io_context_.WatchRead(this);
@@ -37,7 +38,7 @@ Socket::Socket(std::string_view port, IoContext& io_context) :
 Socket::~Socket() {
     if(fd_ == -1) return;
     io_context_.Detach(this);  //从epoll中移除
-    std::cout<<"close fd="<<fd_<<"\n";
+    debug(), "close", fd_;
     ::close(fd_);
 }
 
@@ -50,6 +51,10 @@ task<std::shared_ptr<Socket>> Socket::accept() {
     co_return std::shared_ptr<Socket>(new Socket{fd, io_context_});
 }
 
+void Socket::shutdown_write() {
+    ::shutdown(fd_, SHUT_WR);
+}
+
 Recv Socket::recv(void* buffer, std::size_t len) {
     return Recv{this, buffer, len};
 }
@@ -58,14 +63,40 @@ Send Socket::send(void* buffer, std::size_t len) {
     return Send{this, buffer, len};
 }
 
+Writev Socket::writev(const struct iovec* iov, int count) {
+    return Writev{this, iov, count};
+}
+
+async_generator<std::span<const std::byte>> Socket::chunks(std::size_t chunk_size) {
+    std::vector<std::byte> buffer(chunk_size);
+    for(;;) {
+        ssize_t n = co_await recv(buffer.data(), buffer.size());
+        if(n == 0) {
+            co_return;
+        }
+        if(n < 0) {
+            throw std::runtime_error{"recv error"};
+        }
+        co_yield std::span<const std::byte>{buffer.data(), static_cast<std::size_t>(n)};
+    }
+}
+
 bool Socket::ResumeRecv() {
-    if(!coro_recv_) { std::cout<<"no handle for recv\n"; return false; }
+    if(!coro_recv_) {
+        io_context_.metrics_.spurious_wakeups.add();
+        return false;
+    }
+    io_context_.metrics_.resumes.add();
     coro_recv_.resume();
     return true;
 }
 
 bool Socket::ResumeSend() {
-    if(!coro_send_) { std::cout<<"no handle for send\n"; return false; }
+    if(!coro_send_) {
+        io_context_.metrics_.spurious_wakeups.add();
+        return false;
+    }
+    io_context_.metrics_.resumes.add();
     coro_send_.resume();
     return true;
 }
@@ -2,19 +2,25 @@
 
 #include <memory>
 #include <coroutine>
+#include <cstddef>
+#include <span>
 
 #include "task.h"
+#include "async_generator.h"
 
 class Send;
+class Writev;
 class Recv;
 class Accept;
 
 class Socket;
 class IoContext;
+struct iovec;
 
 class Socket {
 public:
-    Socket(std::string_view port, IoContext& io_context);
+    // 监听端口；host为空时监听所有地址，例如只给本机访问时传"127.0.0.1"
+    Socket(std::string_view port, IoContext& io_context, const char* host = nullptr);
     
     Socket(const Socket&) = delete;
     Socket(Socket&& socket) :
@@ -32,6 +38,16 @@ public:
 
     Send send(void* buffer, std::size_t len);
 
+    // 一次系统调用发出多块数据，和send()一样可能只发出一部分，返回发出的字节数
+    Writev writev(const struct iovec* iov, int count);
+
+    // 连续接收数据，每次yield这一次recv收到的数据，对端关闭时结束，出错时抛出异常
+    // yield出来的数据在下一次co_await ++it之前有效，整个过程只用一个chunk_size大小的缓冲区
+    async_generator<std::span<const std::byte>> chunks(std::size_t chunk_size = 4096);
+
+    // 关闭发送方向（shutdown(SHUT_WR)），对端recv到0；还可以继续recv
+    void shutdown_write();
+
     bool ResumeRecv();
 
     bool ResumeSend();
@@ -39,6 +55,7 @@ private:
     friend Accept;
     friend Recv;
     friend Send;
+    friend Writev;
     friend IoContext;
     
     explicit Socket(int fd, IoContext& io_context);
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <fcntl.h>
+#include "stream_reader.h"
+
+StreamReader::StreamReader(AsyncFile& file, std::size_t chunk_size, std::size_t depth, off_t offset) :
+    file_(file), chunk_size_(chunk_size) {
+    // depth为0时没有slot，next()会访问不存在的slots_[0]；chunk_size为0时每次都读0个字节，看起来就像文件结束了
+    if(depth == 0 || chunk_size == 0) {
+        throw std::invalid_argument{"StreamReader: chunk_size and depth must be positive"};
+    }
+    if(chunk_size % file_.alignment() != 0) {
+        throw std::invalid_argument{"StreamReader: chunk_size must be a multiple of file.alignment()"};
+    }
+
+    // 告诉内核这是顺序读，内核会加大自己的预读窗口
+#if defined(POSIX_FADV_SEQUENTIAL)
+    ::posix_fadvise(file_.fd(), offset, 0, POSIX_FADV_SEQUENTIAL);
+#elif defined(F_RDAHEAD)
+    ::fcntl(file_.fd(), F_RDAHEAD, 1);
+#endif
+
+    // pump协程里保存的是Slot的引用，slots_之后不能再扩容
+    slots_.reserve(depth);
+    for(std::size_t i = 0; i < depth; ++i) {
+        slots_.emplace_back(chunk_size_, std::max<std::size_t>(file_.alignment(), alignof(std::max_align_t)));
+        slots_.back().offset = offset + static_cast<off_t>(i * chunk_size_);
+    }
+
+    // 一开始就把K个读请求都发出去
+    for(auto& slot : slots_) {
+        slot.pump_task = Pump(slot);
+        slot.pump_task.resume();
+    }
+}
+
+StreamReader::~StreamReader() {
+    for(auto& slot : slots_) {
+        slot.pump_task.handle_.destroy();
+    }
+}
+
+StreamReader::NextAwaiter StreamReader::next() {
+    // 调用方已经处理完上一块了，归还它的缓冲区
+    if(in_use_) {
+        Release(*std::exchange(in_use_, nullptr));
+    }
+    return NextAwaiter{*this, slots_[next_]};
+}
+
+bool StreamReader::Ready(const Slot& slot) const {
+    // 到了末尾或者出错时，要等所有读请求都结束才能返回，否则调用方可能在请求还没完成时就销毁StreamReader
+    return slot.filled && (slot.result > 0 || in_flight_ == 0);
+}
+
+void StreamReader::Release(Slot& slot) {
+    slot.filled = false;
+    if(slot.pump) {
+        std::exchange(slot.pump, nullptr).resume();   // pump开始读第n+K块，提交请求后马上挂起回到这里
+    }
+}
+
+task<bool> StreamReader::Pump(Slot& slot) {
+    bool end = false;
+    for(;;) {
+        ssize_t n = 0;
+        if(!end) {
+            ++in_flight_;
+            n = co_await file_.read_at(slot.offset, slot.buffer.span());
+            --in_flight_;
+        }
+        slot.result = n;
+        slot.error = n < 0 ? errno : 0;
+        co_await FilledAwaiter{*this, slot};
+
+        // 普通文件只有到了末尾才会读不满，之后这个slot不用再读，直接交出一个空块表示结束
+        end = end || n <= 0 || static_cast<std::size_t>(n) < chunk_size_;
+        slot.offset += static_cast<off_t>(chunk_size_ * slots_.size());
+    }
+}
+
+std::coroutine_handle<> StreamReader::FilledAwaiter::await_suspend(std::coroutine_handle<> h) noexcept {
+    slot.filled = true;
+    slot.pump = h;
+    if(reader.consumer_ && reader.Ready(reader.slots_[reader.next_])) {
+        return std::exchange(reader.consumer_, nullptr);   // 调用方正等着的那一块好了，直接切换过去
+    }
+    return std::noop_coroutine();
+}
+
+std::span<const std::byte> StreamReader::NextAwaiter::await_resume() noexcept {
+    reader.consumer_ = nullptr;
+    if(reader.eof_) {
+        return {};
+    }
+    if(slot.result <= 0) {
+        reader.eof_ = true;
+        reader.error_ = slot.error;
+        return {};
+    }
+    reader.in_use_ = &slot;
+    reader.next_ = (reader.next_ + 1) % reader.slots_.size();
+    return {slot.buffer.data(), static_cast<std::size_t>(slot.result)};
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+/*
+* 流式读文件，带预读
+*
+*   StreamReader reader{file, 1 << 20, 4};
+*   for(;;) {
+*       auto chunk = co_await reader.next();
+*       if(chunk.empty()) break;
+*       ... 处理chunk ...
+*   }
+*
+* （1）K个固定大小的缓冲区（slot）循环使用，第n块数据放在第n % K个slot里，内存占用和文件大小无关；
+* （2）每个slot有一个pump协程，负责把数据读进自己的缓冲区，调用方处理第n块的时候，后面K-1块的读请求已经在路上了；
+* （3）next()会先归还上一块数据所在的slot，这个slot的pump马上开始读第n+K块；
+* （4）next()返回的数据在下一次调用next()之前有效，读到文件末尾或出错时返回空的span，出错时error()返回errno；
+* （5）返回空span之前会等所有在路上的读请求都结束，之后就可以安全地销毁StreamReader；
+*
+*/
+
+#include <coroutine>
+#include <cstddef>
+#include <span>
+#include <vector>
+#include <sys/types.h>
+
+#include "async_file.h"
+#include "task.h"
+
+class StreamReader {
+public:
+    // chunk_size：每块的大小，O_DIRECT文件需要是file.alignment()的整数倍；depth：同时在路上的读请求个数（K）
+    // 两者为0或者chunk_size没有对齐时抛出std::invalid_argument
+    StreamReader(AsyncFile& file, std::size_t chunk_size, std::size_t depth, off_t offset = 0);
+
+    StreamReader(const StreamReader&) = delete;
+
+    ~StreamReader();
+
+    struct NextAwaiter;
+
+    NextAwaiter next();
+
+    int error() const { return error_; }
+private:
+    struct Slot {
+        Slot(std::size_t size, std::size_t alignment) : buffer(size, alignment) {}
+
+        AlignedBuffer buffer;
+        off_t offset = 0;
+        ssize_t result = 0;                     // 这一块读到的字节数，-1表示出错
+        int error = 0;
+        bool filled = false;                    // 数据已经读好，等着调用方来取
+        std::coroutine_handle<> pump;           // 数据被取走之前，pump协程挂起在这里
+        task<bool> pump_task;
+    };
+
+    // 数据读好之后，pump挂起等待调用方取走，如果调用方正等着这一块，直接切换过去
+    struct FilledAwaiter {
+        bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) noexcept;
+        void await_resume() const noexcept {}
+
+        StreamReader& reader;
+        Slot& slot;
+    };
+
+    task<bool> Pump(Slot& slot);
+    bool Ready(const Slot& slot) const;
+    void Release(Slot& slot);
+
+    AsyncFile& file_;
+    std::size_t chunk_size_;
+    std::vector<Slot> slots_;
+    std::size_t next_ = 0;                      // 下一块数据所在的slot
+    std::size_t in_flight_ = 0;                 // 还没有完成的读请求个数
+    Slot* in_use_ = nullptr;                    // 调用方手里那一块数据所在的slot
+    std::coroutine_handle<> consumer_;          // 调用方正在等待的协程
+    bool eof_ = false;
+    int error_ = 0;
+};
+
+struct StreamReader::NextAwaiter {
+    bool await_ready() const noexcept { return reader.eof_ || reader.Ready(slot); }
+
+    void await_suspend(std::coroutine_handle<> h) noexcept { reader.consumer_ = h; }
+
+    std::span<const std::byte> await_resume() noexcept;
+
+    StreamReader& reader;
+    Slot& slot;
+};
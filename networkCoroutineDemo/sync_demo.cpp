@@ -0,0 +1,109 @@
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "io_context.h"
+#include "async_mutex.h"
+#include "async_semaphore.h"
+#include "async_event.h"
+#include "task.h"
+
+/*
+* async_mutex、async_semaphore、async_manual_reset_event的demo
+* 临界区里会主动让出一次（回到事件循环），如果互斥/限流不正确，计数就会对不上
+*
+* 用法：coro_sync [线程数] [每个线程的循环次数]
+*
+*/
+
+// 让出执行权：把自己post回当前的executor，下一轮事件循环再继续
+struct yield {
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) { executor::current()->post(h); }
+    void await_resume() const noexcept {}
+};
+
+struct Shared {
+    async_mutex mutex;
+    async_semaphore limit{3};
+    async_manual_reset_event start;
+    long counter = 0;          // 只在持有mutex时修改
+    bool inside = false;       // 临界区里是否已经有协程了
+    bool overlap = false;
+    std::atomic<int> concurrent{0};
+    std::atomic<int> max_concurrent{0};
+    std::atomic<int> running{0};
+};
+
+task<bool> worker(Shared& shared, int loops, IoContext& io_context) {
+    co_await shared.start;
+    for(int i = 0; i < loops; ++i) {
+        {
+            auto guard = co_await shared.mutex.scoped_lock();
+            if(shared.inside) shared.overlap = true;
+            shared.inside = true;
+            long value = shared.counter;
+            if(i % 64 == 0) co_await yield{};
+            shared.counter = value + 1;
+            shared.inside = false;
+        }
+
+        co_await shared.limit.acquire();
+        int now = shared.concurrent.fetch_add(1) + 1;
+        int max = shared.max_concurrent.load();
+        while(now > max && !shared.max_concurrent.compare_exchange_weak(max, now)) {}
+        co_await yield{};
+        shared.concurrent.fetch_sub(1);
+        shared.limit.release();
+    }
+    if(shared.running.fetch_sub(1) == 1) {
+        io_context.stop();   // 最后一个结束的协程可能在其他线程上，stop()可以在任意线程调用
+    }
+    co_return true;
+}
+
+int main(int argc, char* argv[]) {
+    int threads = argc > 1 ? std::atoi(argv[1]) : 4;
+    int loops = argc > 2 ? std::atoi(argv[2]) : 20000;
+    constexpr int coroutines = 8;   // IoContext上的协程个数
+
+    IoContext io_context;
+    Shared shared;
+    shared.running = coroutines + threads;
+
+    std::vector<task<bool>> local;
+    for(int i = 0; i < coroutines; ++i) {
+        local.push_back(worker(shared, loops, io_context));
+        io_context.post(local.back().handle_);
+    }
+
+    // 其他线程上的协程，由各自线程的resume_queue恢复
+    std::vector<std::thread> workers;
+    for(int i = 0; i < threads; ++i) {
+        workers.emplace_back([&] {
+            resume_queue queue;
+            auto t = worker(shared, loops, io_context);
+            t.resume();
+            while(!t.handle_.done()) {
+                queue.run_one();
+            }
+            t.handle_.destroy();
+        });
+    }
+
+    shared.start.set();   // 所有协程都在等这个事件，set之后一起开始
+    io_context.run();
+    for(auto& t : workers) {
+        t.join();
+    }
+    for(auto& t : local) {
+        t.handle_.destroy();
+    }
+
+    long expected = static_cast<long>(coroutines + threads) * loops;
+    bool ok = shared.counter == expected && !shared.overlap && shared.max_concurrent <= 3;
+    std::cout<<"counter="<<shared.counter<<" expected="<<expected
+        <<" overlap="<<shared.overlap<<" max_concurrent="<<shared.max_concurrent
+        <<(ok ? " OK" : " FAILED")<<"\n";
+    return ok ? 0 : 1;
+}
@@ -7,7 +7,11 @@
 * （3）task协程也是一个waiter，这说明支持嵌套协程，即一个协程A支持等待另一个协程B去执行别的，协程B执行完之后再恢复A的执行；
 * （4）task协程作为waiter的行为：
 *      - 在即将要执行的协程B的promise中记录下正在等待的协程A，然后去执行协程B；
-*      - 协程B执行完之后，waiter返回协程B的执行结果给协程A；
+*      - 协程B执行完之后，waiter返回协程B的执行结果给协程A，同时销毁协程B的协程帧；
+* （5）协程B抛出的异常会在协程A的co_await处重新抛出；
+* （6）协程B从协程A继承stop_token，when_any/async_scope通过它取消还没有完成的sleep、recv等操作；
+* （7）定义CORO_PROFILE时，每次挂起和恢复都会打点，按协程函数统计运行时间、挂起时长和协程帧大小，见coro_profile.hpp；
+*      再定义CORO_TRACE时同样的打点还会记录成时间线，见coro_trace.hpp；
 *
 *
 *    |  task A  |
@@ -25,7 +29,15 @@
 */
 
 #include <coroutine>
+#include <exception>
 #include <iostream>
+#include <stop_token>
+#include <type_traits>
+#include <utility>
+#if CORO_PROFILE
+#include <source_location>
+#include "coro_profile.hpp"
+#endif
 
 using std::coroutine_handle;
 using std::suspend_always;
@@ -37,13 +49,35 @@ namespace detail {
 
 template<typename T>
 struct promise_type_base {
-    coroutine_handle<> continuation_ = std::noop_coroutine(); // who waits on this coroutine
+    coroutine_handle<> continuation_; // who waits on this coroutine，为空表示没有协程在co_await它
+    std::exception_ptr exception_;
+    std::stop_token stop_token_;      // co_await的时候从父协程继承过来
+
+#if CORO_PROFILE
+    coro_profile::FrameProfile profile_;
+
+    explicit promise_type_base(std::source_location const& loc) : profile_(loc, &continuation_) {}
+
+    static void* operator new(std::size_t size) {
+        coro_profile::noteFrameSize(size);
+        return ::operator new(size);
+    }
+
+    template<typename Expr>
+    auto await_transform(Expr&& expr) {
+        return coro_profile::profileAwait(std::forward<Expr>(expr), profile_);
+    }
+#endif
     
     //返回协成的返回值
     task<T> get_return_object();
 
     //初始化协程后一定挂起
+#if CORO_PROFILE
+    coro_profile::ProfiledAwaiter<suspend_always> initial_suspend() { return {{}, profile_}; }
+#else
     suspend_always initial_suspend() { return {}; }
+#endif
 
     // 当前协程运行完毕，在这里回到父协程，即continuation_
     struct final_awaiter {
@@ -52,22 +86,36 @@ struct promise_type_base {
 
         template<typename promise_type>
         coroutine_handle<> await_suspend(coroutine_handle<promise_type> coro) noexcept {
-            return coro.promise().continuation_;
+            if(coro.promise().continuation_) {
+                return coro.promise().continuation_;
+            }
+            return std::noop_coroutine();
         }
     };
 
     //本协程结束之前，先把前面记录下的协程恢复起来
     auto final_suspend() noexcept {
+#if CORO_PROFILE
+        profile_.onFinal();
+#endif
         return final_awaiter{};
     }
 
-    void unhandled_exception() { //TODO: 
-        std::exit(-1);
+    // 有协程在co_await的时候，异常保存下来在它的co_await处重新抛出；直接resume()启动的顶层协程没有人能接住异常，直接退出
+    void unhandled_exception() {
+        if(!continuation_) {
+            std::exit(-1);
+        }
+        exception_ = std::current_exception();
     }
 }; // struct promise_type_base
 
 template<typename T>
 struct promise_type final: promise_type_base<T> {
+#if CORO_PROFILE
+    // 默认参数在协程函数里求值，得到的是协程函数的位置
+    promise_type(std::source_location const& loc = std::source_location::current()) : promise_type_base<T>(loc) {}
+#endif
     T result;
     void return_value(T value) { result = value; }
     T await_resule() { return result; }
@@ -76,6 +124,9 @@ struct promise_type final: promise_type_base<T> {
 
 template<>
 struct promise_type<void> final: promise_type_base<void> {
+#if CORO_PROFILE
+    promise_type(std::source_location const& loc = std::source_location::current()) : promise_type_base<void>(loc) {}
+#endif
     void return_void() {}
     void await_resume() {}
     task<void> get_return_object();
@@ -98,15 +149,31 @@ struct task {
     bool await_ready() { return false; }
 
     //本协程作为waiter恢复的时候，把本协成的结果返回
+    //子协程已经结束，取出结果之后马上销毁它的协程帧，所以一个task只能被co_await一次
     T await_resume() {
-        return handle_.promise().result;
+        auto handle = std::exchange(handle_, nullptr);
+        if(auto exception = handle.promise().exception_) {
+            handle.destroy();
+            std::rethrow_exception(exception);
+        }
+        if constexpr (std::is_void_v<T>) {
+            handle.destroy();
+        } else {
+            T result = std::move(handle.promise().result);
+            handle.destroy();
+            return result;
+        }
     }
 
     // 这里是对当前task对象本身调用co_await，说明一定是嵌套的协程，
     // 当前所在的协程是父协程，即await_suspend参数所代表的协程，
     // 被co_await的task对象所在的协程为子协程，即当前task.handle_，为子协程。
-    coroutine_handle<> await_suspend(coroutine_handle<> waiter) {  //waiter是调用co_await的协程
+    template<typename Promise>
+    coroutine_handle<> await_suspend(coroutine_handle<Promise> waiter) {  //waiter是调用co_await的协程
         handle_.promise().continuation_ = waiter;   //当前协程记录下之前调用co_await的这个协程waiter,以便后面唤醒
+        if constexpr (requires { waiter.promise().stop_token_; }) {
+            handle_.promise().stop_token_ = waiter.promise().stop_token_;
+        }
 
         // waiter所在的协程，即当前协程挂起了，让子协程，即handle_所表示的协程恢复。子协程结束完以后又回到waiter。
         return handle_;
@@ -129,3 +196,33 @@ inline task<void> promise_type<void>::get_return_object() {
     return task<void>{ coroutine_handle<promise_type<void>>::from_promise(*this)};
 }
 }
+
+namespace detail {
+// 挂起的协程的stop_token，promise里没有stop_token_的协程（例如async_generator）返回一个不会被取消的token
+template<typename Promise>
+std::stop_token stop_token_of(coroutine_handle<Promise> h) noexcept {
+    if constexpr (requires { h.promise().stop_token_; }) {
+        return h.promise().stop_token_;
+    } else {
+        return {};
+    }
+}
+} // namespace detail
+
+/*
+* 取得当前协程的stop_token，不会挂起
+*   std::stop_token token = co_await current_stop_token();
+*/
+struct current_stop_token {
+    bool await_ready() const noexcept { return false; }
+
+    template<typename Promise>
+    bool await_suspend(coroutine_handle<Promise> h) noexcept {
+        token_ = detail::stop_token_of(h);
+        return false;
+    }
+
+    std::stop_token await_resume() const noexcept { return token_; }
+
+    std::stop_token token_;
+};
@@ -0,0 +1,97 @@
+#include <chrono>
+#include <memory>
+#include <tuple>
+#include <variant>
+#include "io_context.h"
+#include "awaiters.h"
+#include "async_scope.h"
+#include "timer.h"
+#include "when.h"
+
+/*
+* 定时器、when_all/when_any和socket在同一个IoContext上：带空闲超时的echo服务器
+*
+* （1）启动时先用when_all/when_any演示一下定时器：两个sleep并发，when_all的耗时是较长的那个，when_any是较短的那个；
+* （2）每个连接：co_await when_any(socket.recv(...), sleep_for(idle))，超过idle秒没有收到数据就关闭连接，
+*      recv先完成时sleep被取消，超时先到时recv被取消，when_any返回之前两个分支都已经结束；
+*      空闲超时不需要很精确，给1秒的slack，同一秒内到期的连接在同一轮循环里一起关闭；
+* （3）另外有一个协程每秒打印一次当前的连接数，这些定时器和socket的事件都由同一个epoll_wait等待；
+*
+* 用法：coro_timeout，然后 nc 127.0.0.1 10011，10秒不输入连接会被关闭
+*
+*/
+
+using namespace std::chrono_literals;
+
+constexpr auto idle_timeout = 10s;
+constexpr auto idle_slack = 1s;
+
+task<int> delayed(int value, std::chrono::milliseconds delay) {
+    co_await sleep_for(delay);
+    co_return value;
+}
+
+task<> warm_up() {
+    auto start = std::chrono::steady_clock::now();
+    auto [a, b] = co_await when_all(delayed(1, 100ms), delayed(2, 200ms));
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::cout<<"when_all: "<<a<<" "<<b<<" after "<<elapsed.count()<<"ms\n";
+
+    start = std::chrono::steady_clock::now();
+    auto r = co_await when_any(delayed(1, 100ms), delayed(2, 200ms));
+    elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::cout<<"when_any: index "<<r.index()<<" value "<<std::get<0>(r)<<" after "<<elapsed.count()<<"ms\n";
+}
+
+task<> echo(std::shared_ptr<Socket> socket) {
+    char buffer[1024];
+    for(;;) {
+        auto r = co_await when_any(socket->recv(buffer, sizeof(buffer)), sleep_for(idle_timeout, idle_slack));
+        if(r.index() == 1) {
+            std::cout<<"idle for "<<idle_timeout.count()<<"s, closing\n";
+            co_return;
+        }
+        ssize_t recv_len = std::get<0>(r);
+        if(recv_len <= 0) {
+            co_return;
+        }
+        ssize_t send_len = 0;
+        while(send_len < recv_len) {
+            ssize_t res = co_await socket->send(buffer + send_len, recv_len - send_len);
+            if(res <= 0) {
+                co_return;
+            }
+            send_len += res;
+        }
+    }
+}
+
+task<> report(async_scope& connections) {
+    for(;;) {
+        co_await sleep_for(1s);
+        std::cout<<"active connections "<<connections.active()<<"\n";
+    }
+}
+
+task<> accept(Socket& listen) {
+    co_await warm_up();
+
+    async_scope connections;
+    auto reporter = report(connections);
+    reporter.resume();
+    for(;;) {
+        auto socket = co_await listen.accept();
+        connections.spawn(echo(socket));
+    }
+}
+
+int main() {
+    IoContext io_context;
+
+    Socket listen{"10011", io_context};
+
+    auto t = accept(listen);
+    t.resume();
+
+    io_context.run();
+}
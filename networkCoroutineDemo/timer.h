@@ -0,0 +1,103 @@
+#pragma once
+
+/*
+* 定时器：在IoContext的事件循环上睡眠
+*
+*   co_await sleep_for(std::chrono::seconds(5));
+*   co_await sleep_until(std::chrono::steady_clock::now() + 5s);
+*   co_await sleep_for(30s, 1s);   // 允许晚1秒触发，和同一秒内到期的其他定时器一起恢复
+*   auto r = co_await when_any(socket.recv(buf, len), sleep_for(5s));   // 5秒没有收到数据就放弃
+*
+* （1）使用steady_clock，系统时间被调整时定时器不受影响；
+* （2）挂起的协程按到期时间放进IoContext的定时器堆，最早的到期时间作为epoll_wait的超时，线程不会阻塞在sleep上；
+* （3）定时器节点就在协程帧里，堆里只保存节点指针；
+* （4）slack：到期时间向上取整到slack的整数倍，不指定时使用IoContext::set_timer_slack()设置的值；
+* （5）协程的stop_token收到取消请求时定时器立即到期，co_await抛出operation_cancelled；
+*      和其他IoContext的操作一样，sleep和取消请求都要在事件循环线程上进行
+*
+*/
+
+#include <chrono>
+#include <coroutine>
+#include <optional>
+#include <stdexcept>
+#include <stop_token>
+
+#include "io_context.h"
+#include "task.h"
+
+/*
+* 等待被取消时，co_await抛出这个异常，协程沿着正常的异常路径退出
+*/
+struct operation_cancelled : std::runtime_error {
+    operation_cancelled() : std::runtime_error{"operation cancelled"} {}
+};
+
+class SleepAwaiter : public TimerNode {
+public:
+    explicit SleepAwaiter(std::chrono::steady_clock::time_point expires,
+        std::optional<std::chrono::steady_clock::duration> slack = std::nullopt) : slack_(slack) {
+        expires_ = expires;
+    }
+
+    SleepAwaiter(const SleepAwaiter&) = delete;
+
+    bool await_ready() const noexcept { return false; }
+
+    template<typename Promise>
+    void await_suspend(coroutine_handle<Promise> h) {
+        io_context_ = IoContext::current();
+        if(!io_context_) {
+            throw std::logic_error{"sleep without IoContext"};
+        }
+        handle_ = h;
+        expires_ = io_context_->Coalesce(expires_, slack_);
+        io_context_->AddTimer(this);
+
+        // 已经请求过取消时，stop_callback的构造函数里就会直接调用Cancel
+        auto token = detail::stop_token_of(h);
+        if(token.stop_possible()) {
+            cancel_.emplace(token, Cancel{this});
+        }
+    }
+
+    void await_resume() {
+        cancel_.reset();
+        if(cancelled_) {
+            throw operation_cancelled{};
+        }
+    }
+private:
+    // 取消时把定时器改成立即到期，由事件循环恢复，不在request_stop()的调用栈里直接恢复
+    struct Cancel {
+        SleepAwaiter* self_;
+
+        void operator()() const noexcept {
+            self_->io_context_->CancelTimer(self_);
+            self_->cancelled_ = true;
+            self_->expires_ = std::chrono::steady_clock::time_point::min();
+            self_->io_context_->AddTimer(self_);   // 刚刚摘下了一个节点，堆的数组不需要扩容，不会抛出异常
+        }
+    };
+
+    IoContext* io_context_ = nullptr;
+    std::optional<std::chrono::steady_clock::duration> slack_;
+    bool cancelled_ = false;
+    std::optional<std::stop_callback<Cancel>> cancel_;
+};
+
+inline task<> sleep_until(std::chrono::steady_clock::time_point expires) {
+    co_await SleepAwaiter{expires};
+}
+
+inline task<> sleep_until(std::chrono::steady_clock::time_point expires, std::chrono::steady_clock::duration slack) {
+    co_await SleepAwaiter{expires, slack};
+}
+
+inline task<> sleep_for(std::chrono::steady_clock::duration duration) {
+    co_await SleepAwaiter{std::chrono::steady_clock::now() + duration};
+}
+
+inline task<> sleep_for(std::chrono::steady_clock::duration duration, std::chrono::steady_clock::duration slack) {
+    co_await SleepAwaiter{std::chrono::steady_clock::now() + duration, slack};
+}
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include "io_context.h"
+#include "async_scope.h"
+#include "timer.h"
+
+/*
+* 定时器合并（slack）的demo
+*
+* count个协程各自sleep一个随机的时长（在[500ms, 1500ms)之间均匀分布），相当于很多连接的空闲定时器；
+* slack为0时几乎每个定时器都要单独唤醒一次事件循环，
+* 有slack时同一个窗口里到期的定时器在同一轮循环里一起恢复，代价是最多晚slack触发
+*
+* 用法：coro_timers [count] [slack_ms]
+*
+*/
+
+using namespace std::chrono_literals;
+using std::chrono::steady_clock;
+
+struct Lateness {
+    steady_clock::duration max{0};
+    steady_clock::duration total{0};
+};
+
+task<> sleeper(steady_clock::duration delay, Lateness& lateness) {
+    auto expires = steady_clock::now() + delay;
+    co_await sleep_until(expires);
+    auto late = steady_clock::now() - expires;
+    lateness.max = std::max(lateness.max, late);
+    lateness.total += late;
+}
+
+task<> run_all(IoContext& io_context, int count, Lateness& lateness) {
+    std::mt19937 rng{42};
+    std::uniform_int_distribution<int> delay_us{500000, 1499999};
+    async_scope scope;
+    for(int i = 0; i < count; ++i) {
+        scope.spawn(sleeper(std::chrono::microseconds(delay_us(rng)), lateness));
+    }
+    co_await scope.join();
+    io_context.stop();
+}
+
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? std::atoi(argv[1]) : 100000;
+    int slack_ms = argc > 2 ? std::atoi(argv[2]) : 10;
+
+    IoContext io_context;
+    io_context.set_timer_slack(std::chrono::milliseconds(slack_ms));
+
+    Lateness lateness;
+    auto t = run_all(io_context, count, lateness);
+    t.resume();
+    io_context.run();
+
+    const auto& stats = io_context.timer_stats();
+    auto us = [](steady_clock::duration d) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    };
+    std::cout<<"timers="<<count<<" slack="<<slack_ms<<"ms"
+        <<" fired="<<stats.fired
+        <<" coalesced="<<stats.coalesced
+        <<" wakeups="<<stats.wakeups
+        <<" saved="<<stats.saved()
+        <<" max_late="<<us(lateness.max)<<"us"
+        <<" avg_late="<<us(lateness.total / std::max(count, 1))<<"us\n";
+#if CORO_PROFILE
+    coro_profile::print(std::cout);
+#endif
+#if CORO_TRACE
+    std::ofstream trace("coro_trace.json");
+    coro_trace::writeJson(trace);
+#endif
+}
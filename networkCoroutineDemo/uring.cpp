@@ -0,0 +1,168 @@
+/*
+* uring.h的实现，直接使用io_uring_setup/io_uring_enter/io_uring_register系统调用
+*
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "uring.h"
+
+namespace {
+
+int SysSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int SysEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int SysRegister(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+// 共享内存里的head/tail会被内核并发修改，需要用原子操作访问
+unsigned LoadAcquire(unsigned* p) {
+    return std::atomic_ref<unsigned>(*p).load(std::memory_order_acquire);
+}
+
+void StoreRelease(unsigned* p, unsigned v) {
+    std::atomic_ref<unsigned>(*p).store(v, std::memory_order_release);
+}
+
+} // namespace
+
+std::unique_ptr<Uring> Uring::TryCreate(unsigned entries) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int fd = SysSetup(entries, &params);
+    if(fd == -1) {
+        return nullptr;
+    }
+
+    std::unique_ptr<Uring> ring{new Uring};
+    ring->fd_ = fd;
+
+    ring->sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if(single_mmap) {
+        ring->sq_size_ = ring->cq_size_ = std::max(ring->sq_size_, ring->cq_size_);
+    }
+
+    ring->sq_ptr_ = ::mmap(nullptr, ring->sq_size_, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(ring->sq_ptr_ == MAP_FAILED) {
+        ring->sq_ptr_ = nullptr;
+        return nullptr;
+    }
+    if(single_mmap) {
+        ring->cq_ptr_ = ring->sq_ptr_;
+    } else {
+        ring->cq_ptr_ = ::mmap(nullptr, ring->cq_size_, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if(ring->cq_ptr_ == MAP_FAILED) {
+            ring->cq_ptr_ = nullptr;
+            return nullptr;
+        }
+    }
+
+    ring->sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, ring->sqes_size_, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(sqes == MAP_FAILED) {
+        return nullptr;
+    }
+    ring->sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    auto sq = static_cast<char*>(ring->sq_ptr_);
+    ring->sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    ring->sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    ring->sq_mask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    ring->sq_entries_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+    ring->sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+    auto cq = static_cast<char*>(ring->cq_ptr_);
+    ring->cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    ring->cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    ring->cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    ring->cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // sq的索引数组固定成一一对应，之后只需要移动tail
+    for(unsigned i = 0; i < *ring->sq_entries_; ++i) {
+        ring->sq_array_[i] = i;
+    }
+    return ring;
+}
+
+Uring::~Uring() {
+    if(sqes_) ::munmap(sqes_, sqes_size_);
+    if(cq_ptr_ && cq_ptr_ != sq_ptr_) ::munmap(cq_ptr_, cq_size_);
+    if(sq_ptr_) ::munmap(sq_ptr_, sq_size_);
+    if(fd_ != -1) ::close(fd_);
+}
+
+io_uring_sqe* Uring::GetSqe() {
+    unsigned tail = *sq_tail_ + pending_;
+    if(tail - LoadAcquire(sq_head_) >= *sq_entries_) {
+        Submit();   // 提交队列满了，先把攒下的提交掉
+        tail = *sq_tail_ + pending_;
+        if(tail - LoadAcquire(sq_head_) >= *sq_entries_) {
+            return nullptr;
+        }
+    }
+    io_uring_sqe* sqe = &sqes_[tail & *sq_mask_];
+    std::memset(sqe, 0, sizeof(*sqe));
+    ++pending_;
+    return sqe;
+}
+
+int Uring::Submit() {
+    if(pending_ == 0) {
+        return 0;
+    }
+    StoreRelease(sq_tail_, *sq_tail_ + pending_);
+    unsigned to_submit = pending_;
+    pending_ = 0;
+    int ret;
+    do {
+        ret = SysEnter(fd_, to_submit, 0, 0);
+    } while(ret == -1 && errno == EINTR);
+    if(ret == -1) {
+        throw std::runtime_error{"io_uring_enter"};
+    }
+    return ret;
+}
+
+void Uring::RegisterEventfd(int fd) {
+    if(SysRegister(fd_, IORING_REGISTER_EVENTFD, &fd, 1) == -1) {
+        throw std::runtime_error{"io_uring_register: eventfd"};
+    }
+}
+
+unsigned Uring::Reap() {
+    unsigned count = 0;
+    for(;;) {
+        unsigned head = *cq_head_;
+        if(head == LoadAcquire(cq_tail_)) {
+            break;
+        }
+        io_uring_cqe* cqe = &cqes_[head & *cq_mask_];
+        auto request = reinterpret_cast<UringRequest*>(cqe->user_data);
+        int res = cqe->res;
+        // 先归还cqe，再恢复协程，协程里可能会继续提交新的请求
+        StoreRelease(cq_head_, head + 1);
+        ++count;
+        if(request) {
+            request->result_ = res;
+            request->handle_.resume();
+        }
+    }
+    return count;
+}
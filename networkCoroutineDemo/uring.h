@@ -0,0 +1,73 @@
+#pragma once
+
+/*
+* io_uring的最小封装，只用到了原始系统调用，不依赖liburing
+*
+* （1）提交队列（SQ）里的sqe先攒着，IoContext在每一轮epoll_wait之前统一Submit()，一次io_uring_enter提交一批；
+* （2）完成队列（CQ）有新的cqe时，内核会写注册进来的eventfd，eventfd挂在epoll上，所以不会阻塞事件循环；
+* （3）cqe的user_data是UringRequest指针，里面记录了要恢复的协程；
+*
+*/
+
+#include <coroutine>
+#include <cstdint>
+#include <memory>
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#endif
+
+/*
+* 一个提交到io_uring上的请求，完成后把结果写到result_里，再恢复handle_
+*/
+struct UringRequest {
+    std::coroutine_handle<> handle_;
+    int result_ = 0;    // 成功时是字节数，失败时是 -errno
+};
+
+#if defined(__linux__)
+class Uring {
+public:
+    // io_uring不可用（内核太老、被禁用等）时返回nullptr，调用方需要走线程池的回退路径
+    static std::unique_ptr<Uring> TryCreate(unsigned entries);
+
+    Uring(const Uring&) = delete;
+    ~Uring();
+
+    // 获取一个空闲的sqe，提交队列满了的时候会先把已有的sqe提交掉
+    io_uring_sqe* GetSqe();
+
+    // 把攒下来的sqe一次性提交给内核，返回提交的个数
+    int Submit();
+
+    // 有完成事件时内核会写这个eventfd
+    void RegisterEventfd(int fd);
+
+    // 取出所有完成事件，恢复对应的协程，返回处理的个数
+    unsigned Reap();
+
+    bool HasPending() const { return pending_ != 0; }
+private:
+    Uring() = default;
+
+    int fd_ = -1;
+    unsigned pending_ = 0;   // 已经填好但还没有提交的sqe个数
+
+    void* sq_ptr_ = nullptr;
+    void* cq_ptr_ = nullptr;
+    std::size_t sq_size_ = 0;
+    std::size_t cq_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    std::size_t sqes_size_ = 0;
+
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_mask_ = nullptr;
+    unsigned* sq_entries_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned* cq_mask_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+};
+#endif
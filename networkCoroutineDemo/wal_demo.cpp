@@ -0,0 +1,57 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include "io_context.h"
+#include "async_file.h"
+#include "write_ahead_log.h"
+#include "task.h"
+
+/*
+* 组提交日志的demo：很多协程同时append，一次fdatasync带走一整批record
+*
+* 用法：coro_wal [文件路径] [协程个数] [每个协程的record个数]
+*
+*/
+
+struct Counter {
+    std::size_t running;
+    IoContext& io_context;
+};
+
+task<bool> writer(WriteAheadLog& log, Counter& counter, int id, int records) {
+    for(int i = 0; i < records; ++i) {
+        std::string record = "writer " + std::to_string(id) + " record " + std::to_string(i) + "\n";
+        off_t pos = co_await log.append(std::as_bytes(std::span{record}));
+        if(pos == -1) {
+            std::perror("append");
+            break;
+        }
+    }
+    if(--counter.running == 0) {
+        counter.io_context.stop();
+    }
+    co_return true;
+}
+
+int main(int argc, char* argv[]) {
+    const char* path = argc > 1 ? argv[1] : "wal_demo.log";
+    int writers = argc > 2 ? std::atoi(argv[2]) : 64;
+    int records = argc > 3 ? std::atoi(argv[3]) : 100;
+
+    IoContext io_context;
+    AsyncFile file{io_context, path, O_WRONLY | O_CREAT | O_TRUNC};
+    WriteAheadLog log{file};
+
+    Counter counter{static_cast<std::size_t>(writers), io_context};
+    for(int i = 0; i < writers; ++i) {
+        auto t = writer(log, counter, i, records);
+        t.resume();
+    }
+
+    io_context.run();
+
+    auto& stats = log.stats();
+    std::cout<<"records="<<stats.records<<" bytes="<<stats.bytes<<" flushes="<<stats.flushes
+        <<" records/flush="<<(stats.flushes ? double(stats.records) / stats.flushes : 0)<<"\n";
+}
@@ -0,0 +1,271 @@
+/*
+* watchdog.h中函数的实现
+*
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include "watchdog.h"
+#include "coro_sampler.hpp"
+
+// 看门狗线程发出请求，事件循环线程在信号处理函数里填写；一个看门狗同一时刻只抓一个线程
+struct LoopWatchdog::CaptureSlot {
+    enum : int { Idle, Requested, Capturing, Done };
+    std::atomic<int> state{Idle};
+    std::atomic<pthread_t> thread{};   // 要抓的线程，撤回的请求留下的信号落到别的线程上时不算数
+    IoContext* context = nullptr;
+    std::int64_t since = 0;        // 抓的时候那一轮的busy_since_，和发现卡顿时不一样说明循环已经恢复过了
+    coro_sampler::Sample sample;
+};
+
+namespace {
+
+#if !defined(__linux__)
+// 没有pthread_sigqueue的平台上信号带不了参数，几个看门狗轮流通过这个指针告诉信号处理函数用哪个结果槽
+std::mutex g_signal_mutex;
+std::atomic<void*> g_signal_slot{nullptr};
+#endif
+
+int CaptureSignal() {
+#if defined(SIGRTMIN)
+    return SIGRTMIN + 1;
+#else
+    return SIGUSR2;
+#endif
+}
+
+} // namespace
+
+std::mutex LoopWatchdog::slots_mutex_;
+std::vector<LoopWatchdog::CaptureSlot*> LoopWatchdog::free_slots_;
+
+// 在被卡住的事件循环线程上执行，只做原子操作和栈回溯
+void LoopWatchdog::OnSignal(int, siginfo_t* info, void*) {
+#if defined(__linux__)
+    void* target = info->si_code == SI_QUEUE ? info->si_value.sival_ptr : nullptr;
+#else
+    (void)info;
+    void* target = g_signal_slot.load(std::memory_order_acquire);
+#endif
+    if(target == nullptr) {
+        return;   // 不是看门狗发的
+    }
+    int saved_errno = errno;
+    auto* slot = static_cast<CaptureSlot*>(target);
+    int expected = CaptureSlot::Requested;
+    if(slot->state.compare_exchange_strong(expected, CaptureSlot::Capturing, std::memory_order_acquire)) {
+        if(pthread_equal(slot->thread.load(std::memory_order_relaxed), pthread_self())) {
+            coro_sampler::capture(slot->sample);
+            slot->since = BusySince(slot->context);
+            slot->state.store(CaptureSlot::Done, std::memory_order_release);
+        } else {
+            slot->state.store(CaptureSlot::Requested, std::memory_order_relaxed);
+        }
+    }
+    errno = saved_errno;
+}
+
+LoopWatchdog::LoopWatchdog(std::chrono::steady_clock::duration threshold, Handler handler)
+    : threshold_(threshold), handler_(handler ? std::move(handler) : Handler{&LoopWatchdog::print}),
+      slot_(AcquireSlot()) {
+    static std::once_flag install;
+    std::call_once(install, [] {
+        coro_sampler::warmUp();   // 第一次栈回溯会加载libgcc_s，不能发生在信号处理函数里
+        struct sigaction action = {};
+        action.sa_sigaction = &LoopWatchdog::OnSignal;
+        action.sa_flags = SA_RESTART | SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        sigaction(CaptureSignal(), &action, nullptr);
+    });
+    thread_ = std::thread([this] { Run(); });
+}
+
+LoopWatchdog::~LoopWatchdog() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+    ReleaseSlot(slot_);
+}
+
+LoopWatchdog::CaptureSlot* LoopWatchdog::AcquireSlot() {
+    std::lock_guard<std::mutex> lock(slots_mutex_);
+    if(free_slots_.empty()) {
+        return new CaptureSlot;
+    }
+    auto* slot = free_slots_.back();
+    free_slots_.pop_back();
+    return slot;
+}
+
+void LoopWatchdog::ReleaseSlot(CaptureSlot* slot) {
+    std::lock_guard<std::mutex> lock(slots_mutex_);
+    free_slots_.push_back(slot);
+}
+
+void LoopWatchdog::watch(IoContext& context) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    watched_.push_back({&context, 0});
+}
+
+void LoopWatchdog::unwatch(IoContext& context) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::erase_if(watched_, [&](const Watched& w) { return w.context == &context; });
+    captured_.wait(lock, [&] { return capturing_ != &context; });
+}
+
+std::int64_t LoopWatchdog::BusySince(IoContext* context) noexcept {
+    return context->busy_since_.load(std::memory_order_acquire);
+}
+
+/*
+* 检查的间隔是threshold的四分之一，发现卡顿最多晚这么久
+* 抓调用栈最多要等100ms，这段时间不持锁，watch()/unwatch()不用跟着等
+*
+*/
+void LoopWatchdog::Run() {
+    auto period = std::max<std::chrono::steady_clock::duration>(threshold_ / 4, std::chrono::milliseconds(1));
+    std::vector<Watched> stalled;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(!cv_.wait_for(lock, period, [this] { return stopping_; })) {
+        auto now = IoContext::LoopClock();
+        stalled.clear();
+        for(auto& watched : watched_) {
+            if(Check(watched, now)) {
+                stalled.push_back(watched);
+            }
+        }
+        for(auto& watched : stalled) {
+            // 前一个解锁报告的时候，这个可能已经unwatch()了
+            if(std::none_of(watched_.begin(), watched_.end(), [&](const Watched& w) { return w.context == watched.context; })) {
+                continue;
+            }
+            capturing_ = watched.context;
+            lock.unlock();
+            Report(watched.context, watched.reported, now);
+            lock.lock();
+            capturing_ = nullptr;
+            captured_.notify_all();
+        }
+    }
+}
+
+// 持锁调用，这一轮卡顿还没有报告过时返回true
+bool LoopWatchdog::Check(Watched& watched, std::int64_t now) {
+    auto since = BusySince(watched.context);
+    auto threshold = std::chrono::duration_cast<std::chrono::nanoseconds>(threshold_).count();
+    if(since == 0 || since == watched.reported || now - since < threshold) {
+        return false;
+    }
+    watched.reported = since;
+    watched.context->loop_stalls_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void LoopWatchdog::Report(IoContext* context, std::int64_t since, std::int64_t now) {
+    Stall stall;
+    stall.context = context;
+    stall.blocked = std::chrono::nanoseconds(now - since);
+    Capture(context, since, stall);
+    handler_(stall);
+}
+
+/*
+* 给事件循环线程发信号，最多等100ms让它抓好调用栈
+* 线程可能正好阻塞在屏蔽了信号的地方，等不到时只报告卡顿，不带调用栈
+*
+*/
+void LoopWatchdog::Capture(IoContext* context, std::int64_t since, Stall& stall) {
+    auto& slot = *slot_;
+    slot.context = context;
+    slot.thread.store(context->loop_thread_, std::memory_order_relaxed);
+    slot.state.store(CaptureSlot::Requested, std::memory_order_release);
+#if defined(__linux__)
+    sigval value;
+    value.sival_ptr = &slot;
+    int error = pthread_sigqueue(context->loop_thread_, CaptureSignal(), value);
+#else
+    std::lock_guard<std::mutex> turn(g_signal_mutex);
+    g_signal_slot.store(&slot, std::memory_order_release);
+    int error = pthread_kill(context->loop_thread_, CaptureSignal());
+#endif
+    if(error != 0) {
+        slot.state.store(CaptureSlot::Idle, std::memory_order_relaxed);
+        return;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+    while(slot.state.load(std::memory_order_acquire) != CaptureSlot::Done) {
+        if(std::chrono::steady_clock::now() > deadline) {
+            int expected = CaptureSlot::Requested;
+            if(slot.state.compare_exchange_strong(expected, CaptureSlot::Idle)) {
+                return;   // 信号还没有被处理，撤回请求
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    if(slot.since == since) {
+        coro_sampler::Symbols symbols;
+        stall.stack = coro_sampler::fold(slot.sample, symbols);
+#if CORO_PROFILE
+        if(slot.sample.asyncDepth > 0) {
+            stall.coroutine = slot.sample.async[0]->name;
+        }
+#endif
+    }
+    slot.state.store(CaptureSlot::Idle, std::memory_order_release);
+}
+
+void LoopWatchdog::print(const Stall& stall) {
+    auto ms = std::chrono::duration<double, std::milli>(stall.blocked).count();
+    std::ostringstream out;
+    out<<"[watchdog] IoContext "<<stall.context<<" has not returned to epoll_wait for "
+        <<std::fixed<<std::setprecision(1)<<ms<<"ms";
+    if(!stall.coroutine.empty()) {
+        out<<", running "<<stall.coroutine;
+    }
+    out<<"\n";
+    if(stall.stack.empty()) {
+        out<<"    (no stack: the loop recovered or did not answer the signal)\n";
+    }
+    //调用栈是从外到内的，打印成从内到外，和调试器里看到的顺序一样
+    std::size_t end = stall.stack.size();
+    while(end != 0 && end != std::string::npos) {
+        auto begin = stall.stack.rfind(';', end - 1);
+        auto frame_begin = begin == std::string::npos ? 0 : begin + 1;
+        out<<"    at "<<stall.stack.substr(frame_begin, end - frame_begin)<<"\n";
+        end = begin;
+    }
+    std::cerr<<out.str();
+}
+
+void LoopWatchdog::print_loop_stats(std::ostream& out, const IoContext::LoopStats& stats) {
+    auto us = [](std::chrono::nanoseconds d) {
+        return std::chrono::duration<double, std::micro>(d).count();
+    };
+    auto flags = out.flags();
+    out<<std::fixed<<std::setprecision(1)
+        <<"loop iterations="<<stats.iterations<<" stalls="<<stats.stalls
+        <<" max="<<us(stats.max)<<"us"
+        <<" avg="<<(stats.iterations ? us(stats.total) / double(stats.iterations) : 0.0)<<"us\n";
+    for(std::size_t i = 0; i < IoContext::LoopStats::buckets; ++i) {
+        if(stats.histogram[i] == 0) {
+            continue;
+        }
+        if(i + 1 == IoContext::LoopStats::buckets) {
+            out<<"  >="<<(std::uint64_t(1) << (i - 1))<<"us: "<<stats.histogram[i]<<"\n";
+        } else {
+            out<<"  <"<<(std::uint64_t(1) << i)<<"us: "<<stats.histogram[i]<<"\n";
+        }
+    }
+    out.flags(flags);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+/*
+* 事件循环看门狗
+*
+* 一个协程里做了阻塞的事情（同步写日志、sleep、大块的计算），同一个IoContext上的所有连接都跟着卡住。
+* 看门狗在自己的线程上定期检查被监视的IoContext：
+* （1）某一轮循环从epoll_wait返回以后超过threshold还没有回去，就算一次卡顿，每次卡顿只报告一次；
+* （2）报告之前给事件循环线程发一个信号，在信号处理函数里抓它此刻的调用栈（moreDemo/coro_sampler.hpp）：
+*      原生调用栈总是有的，定义CORO_PROFILE时能看到正在运行的是哪个协程函数，定义CORO_SAMPLE时还有完整的异步调用链；
+*      可执行文件要用-rdynamic链接（CMake里的ENABLE_EXPORTS），否则程序自己的函数只能显示成"模块名+偏移"；
+* （3）报告交给handler，在看门狗线程上不持锁调用，默认打印到stderr；
+* （4）每一轮循环忙了多久的直方图在IoContext::loop_stats()里，print_loop_stats()按桶打印出来
+*
+*   LoopWatchdog watchdog{std::chrono::milliseconds(50)};
+*   watchdog.watch(io_context);
+*   io_context.run();
+*   LoopWatchdog::print_loop_stats(std::cout, io_context.loop_stats());
+*
+* 抓调用栈用的是实时信号SIGRTMIN+1（没有实时信号的平台用SIGUSR2），程序里不要再用它；
+* 每个看门狗有自己的一份结果槽，随信号一起发过去（pthread_sigqueue），几个看门狗同时抓也不会串
+*
+*/
+
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "io_context.h"
+
+class LoopWatchdog {
+public:
+    struct Stall {
+        IoContext* context = nullptr;
+        std::chrono::steady_clock::duration blocked{0};   // 发现的时候已经卡了多久
+        std::string coroutine;   // 正在运行的协程函数，不知道时为空
+        std::string stack;       // 从外到内用';'连起来的调用栈，抓之前循环已经恢复时为空
+    };
+    using Handler = std::function<void(const Stall&)>;
+
+    explicit LoopWatchdog(std::chrono::steady_clock::duration threshold, Handler handler = {});
+    LoopWatchdog(const LoopWatchdog&) = delete;
+    ~LoopWatchdog();
+
+    // 可以在run()之前调用；IoContext析构之前要unwatch()，或者先析构看门狗；handler里不能调用这两个函数
+    // unwatch()会等看门狗线程抓完这个IoContext的调用栈再返回
+    void watch(IoContext& context);
+    void unwatch(IoContext& context);
+
+    static void print(const Stall& stall);
+    static void print_loop_stats(std::ostream& out, const IoContext::LoopStats& stats);
+private:
+    struct Watched {
+        IoContext* context;
+        std::int64_t reported;   // 已经报告过的那一轮的busy_since_
+    };
+    struct CaptureSlot;
+
+    static void OnSignal(int, siginfo_t* info, void*);
+    static std::int64_t BusySince(IoContext* context) noexcept;
+    static CaptureSlot* AcquireSlot();
+    static void ReleaseSlot(CaptureSlot* slot);
+    void Run();
+    bool Check(Watched& watched, std::int64_t now);
+    void Report(IoContext* context, std::int64_t since, std::int64_t now);
+    void Capture(IoContext* context, std::int64_t since, Stall& stall);
+
+    const std::chrono::steady_clock::duration threshold_;
+    Handler handler_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable captured_;   // capturing_清空时通知unwatch()
+    bool stopping_ = false;
+    std::vector<Watched> watched_;
+    IoContext* capturing_ = nullptr;     // 正在不持锁地抓调用栈的IoContext
+    CaptureSlot* slot_;
+    std::thread thread_;
+
+    // 结果槽用完放回这里，不释放：撤回的请求留下的信号可能还在路上，信号处理函数随时会来读它
+    static std::mutex slots_mutex_;
+    static std::vector<CaptureSlot*> free_slots_;
+};
@@ -0,0 +1,75 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include "io_context.h"
+#include "async_scope.h"
+#include "timer.h"
+#include "watchdog.h"
+
+/*
+* 事件循环看门狗的demo
+*
+* count个协程每隔10ms醒来一次，相当于很多连接上的心跳；
+* 其中一个协程每隔一段时间"不小心"同步地睡了block_ms毫秒（换成同步写日志、fsync、大块计算也一样），
+* 这段时间里所有的心跳都被推迟了。看门狗超过threshold_ms就报告卡住的协程和调用栈，
+* 最后打印每一轮循环忙碌时间的直方图，心跳最晚迟到了多久
+*
+* 用CORO_PROFILE编译能看到卡住的协程函数，用CORO_SAMPLE编译能看到完整的异步调用链
+*
+* 用法：coro_watchdog [threshold_ms] [block_ms]
+*
+*/
+
+using namespace std::chrono_literals;
+using std::chrono::steady_clock;
+
+static int g_block_ms = 100;
+
+void write_report() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(g_block_ms));   // 阻塞了整个事件循环
+}
+
+task<> flush_stats(int rounds) {
+    for(int i = 0; i < rounds; ++i) {
+        co_await sleep_for(300ms);
+        write_report();
+    }
+}
+
+task<> heartbeat(int beats, steady_clock::duration& max_late) {
+    for(int i = 0; i < beats; ++i) {
+        auto expires = steady_clock::now() + 10ms;
+        co_await sleep_until(expires);
+        max_late = std::max(max_late, steady_clock::now() - expires);
+    }
+}
+
+task<> run_all(IoContext& io_context, int count, steady_clock::duration& max_late) {
+    async_scope scope;
+    for(int i = 0; i < count; ++i) {
+        scope.spawn(heartbeat(100, max_late));
+    }
+    scope.spawn(flush_stats(3));
+    co_await scope.join();
+    io_context.stop();
+}
+
+int main(int argc, char* argv[]) {
+    int threshold_ms = argc > 1 ? std::atoi(argv[1]) : 50;
+    g_block_ms = argc > 2 ? std::atoi(argv[2]) : 100;
+
+    IoContext io_context;
+    LoopWatchdog watchdog{std::chrono::milliseconds(threshold_ms)};
+    watchdog.watch(io_context);
+
+    steady_clock::duration max_late{0};
+    auto t = run_all(io_context, 100, max_late);
+    t.resume();
+    io_context.run();
+
+    LoopWatchdog::print_loop_stats(std::cout, io_context.loop_stats());
+    std::cout<<"heartbeat max_late="
+        <<std::chrono::duration_cast<std::chrono::milliseconds>(max_late).count()<<"ms\n";
+}
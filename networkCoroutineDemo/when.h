@@ -0,0 +1,239 @@
+#pragma once
+
+/*
+* 同时等待多个操作：when_all / when_any
+*
+*   auto [a, b] = co_await when_all(fetch(1), fetch(2));              // 两个task并发执行，都完成之后返回tuple
+*   auto r = co_await when_any(socket.recv(buf, len), sleep_for(5s)); // 返回variant，index()是最先完成的那个
+*
+* 参数可以是task，也可以是Recv、Send这样的awaiter，还可以是任何支持co_await的对象；
+* 返回void的操作在结果里用std::monostate代替
+*
+* 实现和moreDemo里step7的whenAll/whenAny一样：
+* （1）每个参数对应一个helper协程，helper协程co_await这个参数，把结果写到when_all/when_any协程帧里的tuple中；
+* （2）控制块里记录还没结束的helper个数，最后一个结束的helper恢复when_all/when_any协程；
+* （3）when_any：最先完成的helper记下自己的下标，然后通过stop_source取消其他helper，
+*      被取消的sleep抛出operation_cancelled，被取消的recv/send返回ECANCELED，这些结果都被丢弃；
+* （4）when_all：第一个抛出异常的helper同样取消其他helper，异常在co_await when_all处重新抛出；
+* （5）when_all/when_any都等所有helper结束之后才返回，返回之后不会还有定时器、I/O挂在已经释放的协程帧上；
+* （6）when_all/when_any自己被取消时（例如外层还有一个when_any），取消请求转发给所有helper；
+*
+* 参数按引用保存，所以when_all/when_any返回的task要在同一个表达式里co_await
+*
+*/
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include "task.h"
+
+namespace detail {
+
+template<typename A>
+decltype(auto) get_awaiter(A&& a) {
+    if constexpr (requires { std::forward<A>(a).operator co_await(); }) {
+        return std::forward<A>(a).operator co_await();
+    } else {
+        return std::forward<A>(a);
+    }
+}
+
+// co_await一个A&得到的类型
+template<typename A>
+using await_result_t = decltype(get_awaiter(std::declval<A&>()).await_resume());
+
+template<typename T>
+using non_void_t = std::conditional_t<std::is_void_v<T>, std::monostate, std::remove_cvref_t<T>>;
+
+/*
+* when_all/when_any共用的控制块
+* count_比helper个数多1，多出来的一个属于发起方，发起方启动完所有helper之后才释放，
+* 这样helper在启动过程中就同步完成时，不会提前恢复还没有挂起的发起方
+*/
+struct when_control {
+    constexpr static std::size_t no_index = std::size_t(-1);
+
+    // 第一个到达的helper记下自己的下标，并取消其他helper
+    bool try_win(std::size_t index) noexcept {
+        std::size_t expected = no_index;
+        if(!index_.compare_exchange_strong(expected, index, std::memory_order_acq_rel)) {
+            return false;
+        }
+        stop_.request_stop();
+        return true;
+    }
+
+    // helper结束，最后一个结束的返回发起方的协程
+    coroutine_handle<> finish() noexcept {
+        if(count_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            return previous_;
+        }
+        return nullptr;
+    }
+
+    std::atomic<std::size_t> index_{no_index};
+    std::atomic<std::size_t> count_{0};
+    std::stop_source stop_;
+    coroutine_handle<> previous_;
+    std::exception_ptr exception_;
+};
+
+/*
+* helper协程：结束时恢复co_return返回的协程（最后一个结束的helper返回发起方，其他的返回空）
+* 协程帧由when_all/when_any协程里的helper数组持有
+*/
+struct when_helper {
+    struct promise_type {
+        coroutine_handle<> next_;
+        std::stop_token stop_token_;   // 由when_awaiter在启动helper之前设置，co_await的操作通过它被取消
+
+        when_helper get_return_object() noexcept {
+            return when_helper{coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        suspend_always initial_suspend() noexcept { return {}; }
+
+        struct final_awaiter {
+            bool await_ready() noexcept { return false; }
+            coroutine_handle<> await_suspend(coroutine_handle<promise_type> h) noexcept {
+                if(h.promise().next_) {
+                    return h.promise().next_;
+                }
+                return std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+
+        final_awaiter final_suspend() noexcept { return {}; }
+
+        void return_value(coroutine_handle<> next) noexcept { next_ = next; }
+
+        // helper里catch住了所有异常，这里不会走到
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+
+    explicit when_helper(coroutine_handle<promise_type> handle) noexcept : handle_(handle) {}
+    when_helper(when_helper&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    ~when_helper() {
+        if(handle_) handle_.destroy();
+    }
+
+    coroutine_handle<promise_type> handle_;
+};
+
+// 启动所有helper，等它们全部结束
+struct when_awaiter {
+    bool await_ready() const noexcept { return false; }
+
+    coroutine_handle<> await_suspend(coroutine_handle<> h) noexcept {
+        control_.previous_ = h;
+        control_.count_.store(helpers_.size() + 1, std::memory_order_relaxed);
+        for(auto& helper : helpers_) {
+            helper.handle_.promise().stop_token_ = control_.stop_.get_token();
+        }
+        for(auto& helper : helpers_) {
+            helper.handle_.resume();
+        }
+        if(control_.count_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            return h;   // 所有helper在启动的过程中就都结束了
+        }
+        return std::noop_coroutine();
+    }
+
+    void await_resume() const {
+        if(control_.exception_) {
+            std::rethrow_exception(control_.exception_);
+        }
+    }
+
+    when_control& control_;
+    std::span<when_helper> helpers_;
+};
+
+template<typename A, typename T>
+when_helper when_all_helper(A& a, when_control& control, std::optional<T>& result, std::size_t index) {
+    try {
+        if constexpr (std::is_void_v<await_result_t<A>>) {
+            co_await a;
+            result.emplace();
+        } else {
+            result.emplace(co_await a);
+        }
+    } catch(...) {
+        if(control.try_win(index)) {
+            control.exception_ = std::current_exception();
+        }
+    }
+    co_return control.finish();
+}
+
+template<typename A, typename T>
+when_helper when_any_helper(A& a, when_control& control, std::optional<T>& result, std::size_t index) {
+    try {
+        if constexpr (std::is_void_v<await_result_t<A>>) {
+            co_await a;
+            if(control.try_win(index)) {
+                result.emplace();
+            }
+        } else {
+            auto&& value = co_await a;
+            if(control.try_win(index)) {   // 只有最先完成的helper保存结果
+                result.emplace(std::forward<decltype(value)>(value));
+            }
+        }
+    } catch(...) {
+        // 输掉的helper（通常是被取消的）的异常都忽略
+        if(control.try_win(index)) {
+            control.exception_ = std::current_exception();
+        }
+    }
+    co_return control.finish();
+}
+
+template<std::size_t... Is, typename... As>
+task<std::tuple<non_void_t<await_result_t<As>>...>>
+when_all_impl(std::index_sequence<Is...>, As&&... as) {
+    when_control control;
+    std::tuple<std::optional<non_void_t<await_result_t<As>>>...> results;
+    when_helper helpers[]{ when_all_helper(as, control, std::get<Is>(results), Is)... };
+    std::stop_callback forward(co_await current_stop_token(), [&control] { control.stop_.request_stop(); });
+    co_await when_awaiter{control, helpers};
+    co_return std::tuple<non_void_t<await_result_t<As>>...>(std::move(*std::get<Is>(results))...);
+}
+
+template<std::size_t... Is, typename... As>
+task<std::variant<non_void_t<await_result_t<As>>...>>
+when_any_impl(std::index_sequence<Is...>, As&&... as) {
+    when_control control;
+    std::tuple<std::optional<non_void_t<await_result_t<As>>>...> results;
+    when_helper helpers[]{ when_any_helper(as, control, std::get<Is>(results), Is)... };
+    std::stop_callback forward(co_await current_stop_token(), [&control] { control.stop_.request_stop(); });
+    co_await when_awaiter{control, helpers};
+    std::size_t winner = control.index_.load(std::memory_order_acquire);
+    std::optional<std::variant<non_void_t<await_result_t<As>>...>> result;
+    ((winner == Is && (result.emplace(std::in_place_index<Is>, std::move(*std::get<Is>(results))), true)), ...);
+    co_return std::move(*result);
+}
+
+} // namespace detail
+
+template<typename... As>
+    requires(sizeof...(As) != 0)
+auto when_all(As&&... as) {
+    return detail::when_all_impl(std::index_sequence_for<As...>{}, std::forward<As>(as)...);
+}
+
+template<typename... As>
+    requires(sizeof...(As) != 0)
+auto when_any(As&&... as) {
+    return detail::when_any_impl(std::index_sequence_for<As...>{}, std::forward<As>(as)...);
+}
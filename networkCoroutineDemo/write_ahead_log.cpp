@@ -0,0 +1,135 @@
+#include <cerrno>
+#include <stdexcept>
+#include <utility>
+#include <unistd.h>
+#include "write_ahead_log.h"
+#include "io_context.h"
+
+namespace {
+
+// 刷盘协程空闲时挂起在这里，有新的record时由append()把它post到事件循环
+struct ParkAwaiter {
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) noexcept { slot = h; }
+    void await_resume() const noexcept {}
+
+    std::coroutine_handle<>& slot;
+};
+
+} // namespace
+
+WriteAheadLog::WriteAheadLog(AsyncFile& file) : file_(file) {
+    offset_ = ::lseek(file_.fd(), 0, SEEK_END);
+    if(offset_ == -1) {
+        throw std::runtime_error{"lseek"};
+    }
+    iovs_.reserve(max_batch);
+    flusher_task_ = Flusher();
+    flusher_task_.resume();   // 运行到第一次ParkAwaiter挂起
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    flusher_task_.handle_.destroy();
+}
+
+void WriteAheadLog::AppendAwaiter::await_suspend(std::coroutine_handle<> h) {
+    handle = h;
+    if(log.tail_) {
+        log.tail_->next = this;
+    } else {
+        log.head_ = this;
+    }
+    log.tail_ = this;
+
+    // 不马上刷盘，而是等到下一轮事件循环，这一轮里其他协程的append也能赶上同一批
+    if(!log.scheduled_) {
+        log.scheduled_ = true;
+        log.file_.io_context().post(log.flusher_);
+    }
+}
+
+off_t WriteAheadLog::AppendAwaiter::await_resume() const noexcept {
+    int err = handle ? error : log.error_;   // handle为空说明没有挂起，日志已经处于错误状态
+    if(err != 0) {
+        errno = err;
+        return -1;
+    }
+    return position;
+}
+
+task<bool> WriteAheadLog::Flusher() {
+    for(;;) {
+        co_await ParkAwaiter{flusher_};
+
+        while(head_) {
+            // 从等待队列头部取出一批
+            AppendAwaiter* batch = head_;
+            AppendAwaiter* last = head_;
+            std::size_t count = 1;
+            while(last->next && count < max_batch) {
+                last = last->next;
+                ++count;
+            }
+            head_ = last->next;
+            if(head_ == nullptr) {
+                tail_ = nullptr;
+            }
+            last->next = nullptr;
+
+            int err = error_;
+            std::size_t total = 0;
+            if(err == 0) {
+                iovs_.clear();
+                for(AppendAwaiter* p = batch; p; p = p->next) {
+                    p->position = offset_ + static_cast<off_t>(total);
+                    iovs_.push_back({const_cast<std::byte*>(p->record.data()), p->record.size()});
+                    total += p->record.size();
+                }
+
+                // 一次pwritev写入整批，写不完（磁盘满、信号等）就接着写剩下的部分
+                std::size_t written = 0;
+                std::size_t first = 0;
+                while(written < total) {
+                    ssize_t n = co_await file_.writev_at(offset_ + static_cast<off_t>(written),
+                        std::span{iovs_}.subspan(first));
+                    if(n <= 0) {
+                        err = n < 0 ? errno : EIO;
+                        break;
+                    }
+                    written += n;
+                    auto left = static_cast<std::size_t>(n);
+                    while(first < iovs_.size() && left >= iovs_[first].iov_len) {
+                        left -= iovs_[first].iov_len;
+                        ++first;
+                    }
+                    if(first < iovs_.size()) {
+                        iovs_[first].iov_base = static_cast<char*>(iovs_[first].iov_base) + left;
+                        iovs_[first].iov_len -= left;
+                    }
+                }
+
+                if(err == 0 && co_await file_.fdatasync() == -1) {
+                    err = errno;
+                }
+
+                if(err == 0) {
+                    offset_ += static_cast<off_t>(total);
+                    stats_.records += count;
+                    stats_.bytes += total;
+                    ++stats_.flushes;
+                } else {
+                    error_ = err;   // 落盘失败之后无法确定文件里的内容，不再接受新的record
+                }
+            }
+
+            // 这一批一起恢复，恢复的协程里可以继续append，会进入下一批
+            for(AppendAwaiter* p = batch; p;) {
+                AppendAwaiter* next = p->next;
+                p->error = err;
+                p->handle.resume();
+                p = next;
+            }
+        }
+        scheduled_ = false;
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+/*
+* 组提交（group commit）的预写日志
+*
+*   off_t pos = co_await log.append(record);   // 返回时record已经落盘，pos是record在文件中的位置，失败返回-1
+*
+* （1）append()的awaiter本身就是侵入式链表的节点，挂在协程帧上，不需要额外分配内存；
+* （2）一批record用一次pwritev写入，再用一次fdatasync落盘，然后这一批的所有协程一起恢复；
+* （3）刷盘窗口：第一个append把刷盘协程post到下一轮事件循环，这一轮里所有的append都会进入同一批；
+*      刷盘进行中到来的append进入下一批，当前这批落盘后马上开始刷下一批；
+* （4）写入或者落盘失败之后日志进入错误状态，之后的append都直接返回-1；
+*
+*/
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "async_file.h"
+#include "task.h"
+
+class WriteAheadLog {
+public:
+    struct Stats {
+        std::uint64_t records = 0;   // 落盘的record个数
+        std::uint64_t bytes = 0;     // 落盘的字节数
+        std::uint64_t flushes = 0;   // fdatasync的次数
+    };
+
+    // 从文件末尾开始追加
+    explicit WriteAheadLog(AsyncFile& file);
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+
+    ~WriteAheadLog();
+
+    struct AppendAwaiter {
+        bool await_ready() const noexcept { return log.error_ != 0; }
+
+        void await_suspend(std::coroutine_handle<> h);
+
+        off_t await_resume() const noexcept;
+
+        WriteAheadLog& log;
+        std::span<const std::byte> record;
+        AppendAwaiter* next = nullptr;
+        std::coroutine_handle<> handle{};
+        off_t position = -1;
+        int error = 0;
+    };
+
+    // record的内存在co_await结束之前必须有效
+    AppendAwaiter append(std::span<const std::byte> record) { return AppendAwaiter{*this, record}; }
+
+    const Stats& stats() const { return stats_; }
+private:
+    // 一次pwritev最多能带的缓冲区个数（IOV_MAX）
+    constexpr static std::size_t max_batch = 1024;
+
+    task<bool> Flusher();
+
+    AsyncFile& file_;
+    off_t offset_ = 0;                  // 下一个record写入的位置
+    AppendAwaiter* head_ = nullptr;     // 等待下一批刷盘的record
+    AppendAwaiter* tail_ = nullptr;
+    std::coroutine_handle<> flusher_;   // 空闲时刷盘协程挂起在这里
+    bool scheduled_ = false;            // 刷盘协程已经post或者正在运行
+    int error_ = 0;
+    std::vector<struct iovec> iovs_;    // 复用的iovec数组
+    task<bool> flusher_task_;
+    Stats stats_;
+};